@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <byteswap.h>
+#include <cpu.h>
+#include <ipxe/aes.h>
+
+/** @file
+ *
+ * AES-NI accelerated AES engine
+ *
+ * The round keys are expanded by the generic code and then converted
+ * to byte order, which is exactly the layout expected by the AESENC
+ * and AESDEC instructions (since the generic decryption key schedule
+ * is already that of the equivalent inverse cipher).
+ *
+ * We build with -march=i386, so gcc will never allocate an SSE
+ * register for its own use; the inline assembly therefore does not
+ * need to (and cannot) declare the %xmm registers as clobbered.
+ * Round keys are loaded using MOVDQU, so no alignment is required.
+ */
+
+/**
+ * Apply all AES rounds to %xmm0
+ *
+ * @v insn		Round instruction ("aesenc" or "aesdec")
+ *
+ * Expects the round key pointer in operand %[rk] and the number of
+ * rounds in operand %[rounds]; both are modified.  Uses %xmm1.
+ */
+#define AESNI_ROUNDS_1( insn )						\
+	"movdqu (%[rk]), %%xmm1\n\t"					\
+	"pxor %%xmm1, %%xmm0\n\t"					\
+	"\n1:\n\t"							\
+	"add $16, %[rk]\n\t"						\
+	"movdqu (%[rk]), %%xmm1\n\t"					\
+	"dec %[rounds]\n\t"						\
+	"jz 2f\n\t"							\
+	insn " %%xmm1, %%xmm0\n\t"					\
+	"jmp 1b\n\t"							\
+	"\n2:\n\t"							\
+	insn "last %%xmm1, %%xmm0\n\t"
+
+/**
+ * Apply all AES rounds to %xmm0-%xmm3 in parallel
+ *
+ * @v insn		Round instruction ("aesenc" or "aesdec")
+ *
+ * Expects the round key pointer in operand %[rk] and the number of
+ * rounds in operand %[rounds]; both are modified.  Uses %xmm4.
+ *
+ * The AES instructions have a latency of several cycles but a
+ * throughput of one per cycle, so interleaving four independent
+ * blocks keeps the pipeline full.
+ */
+#define AESNI_ROUNDS_4( insn )						\
+	"movdqu (%[rk]), %%xmm4\n\t"					\
+	"pxor %%xmm4, %%xmm0\n\t"					\
+	"pxor %%xmm4, %%xmm1\n\t"					\
+	"pxor %%xmm4, %%xmm2\n\t"					\
+	"pxor %%xmm4, %%xmm3\n\t"					\
+	"\n1:\n\t"							\
+	"add $16, %[rk]\n\t"						\
+	"movdqu (%[rk]), %%xmm4\n\t"					\
+	"dec %[rounds]\n\t"						\
+	"jz 2f\n\t"							\
+	insn " %%xmm4, %%xmm0\n\t"					\
+	insn " %%xmm4, %%xmm1\n\t"					\
+	insn " %%xmm4, %%xmm2\n\t"					\
+	insn " %%xmm4, %%xmm3\n\t"					\
+	"jmp 1b\n\t"							\
+	"\n2:\n\t"							\
+	insn "last %%xmm4, %%xmm0\n\t"					\
+	insn "last %%xmm4, %%xmm1\n\t"					\
+	insn "last %%xmm4, %%xmm2\n\t"					\
+	insn "last %%xmm4, %%xmm3\n\t"
+
+/** Number of blocks processed in parallel */
+#define AESNI_PARALLEL 4
+
+/**
+ * Check if AES-NI engine is supported
+ *
+ * @ret supported	Engine is supported
+ */
+static int aesni_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	get_cpuinfo ( &cpu );
+	if ( ! ( cpu.ext_features & ( 1 << X86_FEATURE_AES ) ) )
+		return 0;
+	return enable_sse();
+}
+
+/**
+ * Convert round keys to byte order
+ *
+ * @v aes		AES context
+ */
+static void aesni_prepare ( struct aes_context *aes ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( ( aes->rounds + 1 ) * 4 ) ; i++ ) {
+		aes->encrypt.key[i] = cpu_to_be32 ( aes->encrypt.key[i] );
+		aes->decrypt.key[i] = cpu_to_be32 ( aes->decrypt.key[i] );
+	}
+}
+
+/**
+ * Encrypt data in ECB mode
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aesni_encrypt ( struct aes_context *aes, const void *src,
+			    void *dst, size_t len ) {
+	const void *rk;
+	unsigned int rounds;
+
+	for ( ; len >= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ;
+	      src += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      dst += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      len -= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ) {
+		rk = aes->encrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu 0(%[src]), %%xmm0\n\t"
+				       "movdqu 16(%[src]), %%xmm1\n\t"
+				       "movdqu 32(%[src]), %%xmm2\n\t"
+				       "movdqu 48(%[src]), %%xmm3\n\t"
+				       AESNI_ROUNDS_4 ( "aesenc" )
+				       "movdqu %%xmm0, 0(%[dst])\n\t"
+				       "movdqu %%xmm1, 16(%[dst])\n\t"
+				       "movdqu %%xmm2, 32(%[dst])\n\t"
+				       "movdqu %%xmm3, 48(%[dst])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst )
+				       : "memory" );
+	}
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		rk = aes->encrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu (%[src]), %%xmm0\n\t"
+				       AESNI_ROUNDS_1 ( "aesenc" )
+				       "movdqu %%xmm0, (%[dst])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst )
+				       : "memory" );
+	}
+}
+
+/**
+ * Decrypt data in ECB mode
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aesni_decrypt ( struct aes_context *aes, const void *src,
+			    void *dst, size_t len ) {
+	const void *rk;
+	unsigned int rounds;
+
+	for ( ; len >= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ;
+	      src += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      dst += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      len -= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ) {
+		rk = aes->decrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu 0(%[src]), %%xmm0\n\t"
+				       "movdqu 16(%[src]), %%xmm1\n\t"
+				       "movdqu 32(%[src]), %%xmm2\n\t"
+				       "movdqu 48(%[src]), %%xmm3\n\t"
+				       AESNI_ROUNDS_4 ( "aesdec" )
+				       "movdqu %%xmm0, 0(%[dst])\n\t"
+				       "movdqu %%xmm1, 16(%[dst])\n\t"
+				       "movdqu %%xmm2, 32(%[dst])\n\t"
+				       "movdqu %%xmm3, 48(%[dst])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst )
+				       : "memory" );
+	}
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		rk = aes->decrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu (%[src]), %%xmm0\n\t"
+				       AESNI_ROUNDS_1 ( "aesdec" )
+				       "movdqu %%xmm0, (%[dst])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst )
+				       : "memory" );
+	}
+}
+
+/**
+ * Encrypt data in CBC mode
+ *
+ * @v aes		AES context
+ * @v iv		Chaining value
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ *
+ * CBC encryption is inherently serial, so there is no scope for
+ * interleaving blocks.
+ */
+static void aesni_cbc_encrypt ( struct aes_context *aes, void *iv,
+				const void *src, void *dst, size_t len ) {
+	const void *rk;
+	unsigned int rounds;
+
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		rk = aes->encrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu (%[iv]), %%xmm0\n\t"
+				       "movdqu (%[src]), %%xmm2\n\t"
+				       "pxor %%xmm2, %%xmm0\n\t"
+				       AESNI_ROUNDS_1 ( "aesenc" )
+				       "movdqu %%xmm0, (%[dst])\n\t"
+				       "movdqu %%xmm0, (%[iv])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst ),
+					 [iv] "r" ( iv )
+				       : "memory" );
+	}
+}
+
+/**
+ * Decrypt data in CBC mode
+ *
+ * @v aes		AES context
+ * @v iv		Chaining value
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ *
+ * Unlike encryption, CBC decryption can be performed on several
+ * blocks in parallel.  The plaintext blocks are written out in
+ * reverse order so that in-place decryption works.
+ */
+static void aesni_cbc_decrypt ( struct aes_context *aes, void *iv,
+				const void *src, void *dst, size_t len ) {
+	const void *rk;
+	unsigned int rounds;
+
+	for ( ; len >= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ;
+	      src += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      dst += ( AESNI_PARALLEL * AES_BLOCKSIZE ),
+	      len -= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ) {
+		rk = aes->decrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu 0(%[src]), %%xmm0\n\t"
+				       "movdqu 16(%[src]), %%xmm1\n\t"
+				       "movdqu 32(%[src]), %%xmm2\n\t"
+				       "movdqu 48(%[src]), %%xmm3\n\t"
+				       "movdqa %%xmm3, %%xmm6\n\t"
+				       AESNI_ROUNDS_4 ( "aesdec" )
+				       "movdqu 32(%[src]), %%xmm4\n\t"
+				       "pxor %%xmm4, %%xmm3\n\t"
+				       "movdqu %%xmm3, 48(%[dst])\n\t"
+				       "movdqu 16(%[src]), %%xmm4\n\t"
+				       "pxor %%xmm4, %%xmm2\n\t"
+				       "movdqu %%xmm2, 32(%[dst])\n\t"
+				       "movdqu 0(%[src]), %%xmm4\n\t"
+				       "pxor %%xmm4, %%xmm1\n\t"
+				       "movdqu %%xmm1, 16(%[dst])\n\t"
+				       "movdqu (%[iv]), %%xmm5\n\t"
+				       "pxor %%xmm5, %%xmm0\n\t"
+				       "movdqu %%xmm0, 0(%[dst])\n\t"
+				       "movdqu %%xmm6, (%[iv])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst ),
+					 [iv] "r" ( iv )
+				       : "memory" );
+	}
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		rk = aes->decrypt.key;
+		rounds = aes->rounds;
+		__asm__ __volatile__ ( "movdqu (%[src]), %%xmm0\n\t"
+				       "movdqa %%xmm0, %%xmm6\n\t"
+				       AESNI_ROUNDS_1 ( "aesdec" )
+				       "movdqu (%[iv]), %%xmm5\n\t"
+				       "pxor %%xmm5, %%xmm0\n\t"
+				       "movdqu %%xmm0, (%[dst])\n\t"
+				       "movdqu %%xmm6, (%[iv])\n\t"
+				       : [rk] "+r" ( rk ),
+					 [rounds] "+r" ( rounds )
+				       : [src] "r" ( src ), [dst] "r" ( dst ),
+					 [iv] "r" ( iv )
+				       : "memory" );
+	}
+}
+
+/** AES-NI engine */
+struct aes_engine aesni_engine __aes_engine ( AES_ENGINE_ACCELERATED ) = {
+	.name = "aesni",
+	.supported = aesni_supported,
+	.prepare = aesni_prepare,
+	.encrypt = aesni_encrypt,
+	.decrypt = aesni_decrypt,
+	.cbc_encrypt = aesni_cbc_encrypt,
+	.cbc_decrypt = aesni_cbc_decrypt,
+};
@@ -56,10 +56,14 @@ void get_cpuinfo ( struct cpuinfo_x86 *cpu ) {
 		&discard_2, &discard_3 );
 	if ( cpuid_level >= 0x00000001 ) {
 		cpuid ( 0x00000001, &discard_1, &discard_2,
-			&discard_3, &cpu->features );
+			&cpu->ext_features, &cpu->features );
 	} else {
 		DBG ( "CPUID cannot return capabilities\n" );
 	}
+	if ( cpuid_level >= 0x00000007 ) {
+		cpuid_count ( 0x00000007, 0, &discard_1, &cpu->struct_features,
+			      &discard_2, &discard_3 );
+	}
 
 	/* Get 64-bit features, if present */
 	cpuid ( 0x80000000, &cpuid_extlevel, &discard_1,
@@ -71,3 +75,50 @@ void get_cpuinfo ( struct cpuinfo_x86 *cpu ) {
 		}
 	}
 }
+
+/**
+ * Enable use of SSE instructions
+ *
+ * @ret enabled		SSE instructions may be used
+ *
+ * The BIOS will generally leave CR4.OSFXSR clear, which causes all
+ * SSE instructions to raise #UD.  Since we run at CPL 0 and never
+ * context-switch the SSE register state, we can simply set the bit.
+ * The operating system that we eventually boot will reinitialise CR4
+ * for itself.
+ */
+int enable_sse ( void ) {
+	struct cpuinfo_x86 cpu;
+	unsigned long cr0;
+	unsigned long cr4;
+
+	/* Check for SSE2 and FXSAVE/FXRSTOR support */
+	get_cpuinfo ( &cpu );
+	if ( ! ( ( cpu.features & ( 1 << X86_FEATURE_FXSR ) ) &&
+		 ( cpu.features & ( 1 << X86_FEATURE_XMM ) ) &&
+		 ( cpu.features & ( 1 << X86_FEATURE_XMM2 ) ) ) )
+		return 0;
+
+	/* Refuse to use SSE if x87 emulation is enabled, since SSE
+	 * instructions would then raise #UD.
+	 */
+	__asm__ ( "movl %%cr0, %0" : "=r" ( cr0 ) );
+	if ( cr0 & X86_CR0_EM )
+		return 0;
+
+	/* Enable SSE, if not already enabled */
+	__asm__ ( "movl %%cr4, %0" : "=r" ( cr4 ) );
+	if ( ! ( cr4 & X86_CR4_OSFXSR ) ) {
+		DBG ( "Enabling SSE instructions\n" );
+		cr4 |= X86_CR4_OSFXSR;
+		__asm__ __volatile__ ( "movl %0, %%cr4" : : "r" ( cr4 ) );
+	}
+
+	/* Clear any stale task-switched flag, which would otherwise
+	 * cause SSE instructions to raise #NM.
+	 */
+	if ( cr0 & X86_CR0_TS )
+		__asm__ __volatile__ ( "clts" );
+
+	return 1;
+}
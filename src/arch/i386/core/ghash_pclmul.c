@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdint.h>
+#include <cpu.h>
+#include <ipxe/gcm.h>
+
+/** @file
+ *
+ * PCLMULQDQ accelerated GHASH engine
+ *
+ * Uses the carry-less multiplication instruction to compute the
+ * 256-bit product, followed by the shift-and-reduce method described
+ * in Intel's "Carry-Less Multiplication Instruction and its Usage
+ * for Computing the GCM Mode" white paper.  Operands are
+ * byte-reflected using PSHUFB on entry and exit, so the hash state
+ * remains in the byte order used by the generic engine.
+ *
+ * As with the AES-NI engine, the inline assembly does not (and
+ * cannot) declare the %xmm registers as clobbered.
+ */
+
+/** Byte reversal mask for PSHUFB */
+static const uint8_t ghash_pclmul_bswap[16] = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+/**
+ * Check if PCLMULQDQ engine is supported
+ *
+ * @ret supported	Engine is supported
+ */
+static int ghash_pclmul_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	get_cpuinfo ( &cpu );
+	if ( ! ( cpu.ext_features & ( 1 << X86_FEATURE_PCLMULQDQ ) ) )
+		return 0;
+	if ( ! ( cpu.ext_features & ( 1 << X86_FEATURE_SSSE3 ) ) )
+		return 0;
+	return enable_sse();
+}
+
+/**
+ * Accumulate data into hash using PCLMULQDQ
+ *
+ * @v gcm		GCM context
+ * @v data		Data
+ * @v len		Length of data
+ *
+ * Register usage: %xmm0 holds the accumulated hash, %xmm1 holds H,
+ * %xmm7 holds the byte reversal mask, and %xmm2-%xmm6 are temporary.
+ */
+static void ghash_pclmul_update ( struct gcm_context *gcm, const void *data,
+				  size_t len ) {
+	unsigned int blocks = ( len / GCM_BLOCKSIZE );
+
+	if ( ! blocks )
+		return;
+
+	__asm__ __volatile__ ( "movdqu (%[bswap]), %%xmm7\n\t"
+			       "movdqu (%[key]), %%xmm1\n\t"
+			       "pshufb %%xmm7, %%xmm1\n\t"
+			       "movdqu (%[hash]), %%xmm0\n\t"
+			       "pshufb %%xmm7, %%xmm0\n\t"
+			       "\n1:\n\t"
+			       /* X ^= block */
+			       "movdqu (%[data]), %%xmm2\n\t"
+			       "pshufb %%xmm7, %%xmm2\n\t"
+			       "pxor %%xmm2, %%xmm0\n\t"
+			       /* <%xmm3:%xmm2> = X * H (unreduced) */
+			       "movdqa %%xmm0, %%xmm2\n\t"
+			       "pclmulqdq $0x00, %%xmm1, %%xmm2\n\t"
+			       "movdqa %%xmm0, %%xmm3\n\t"
+			       "pclmulqdq $0x11, %%xmm1, %%xmm3\n\t"
+			       "movdqa %%xmm0, %%xmm4\n\t"
+			       "pclmulqdq $0x10, %%xmm1, %%xmm4\n\t"
+			       "pclmulqdq $0x01, %%xmm1, %%xmm0\n\t"
+			       "pxor %%xmm0, %%xmm4\n\t"
+			       "movdqa %%xmm4, %%xmm0\n\t"
+			       "psrldq $8, %%xmm4\n\t"
+			       "pslldq $8, %%xmm0\n\t"
+			       "pxor %%xmm0, %%xmm2\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       /* Shift product left by one bit, to
+				* account for the bit reflection
+				*/
+			       "movdqa %%xmm2, %%xmm4\n\t"
+			       "movdqa %%xmm3, %%xmm5\n\t"
+			       "pslld $1, %%xmm2\n\t"
+			       "pslld $1, %%xmm3\n\t"
+			       "psrld $31, %%xmm4\n\t"
+			       "psrld $31, %%xmm5\n\t"
+			       "movdqa %%xmm4, %%xmm6\n\t"
+			       "pslldq $4, %%xmm5\n\t"
+			       "pslldq $4, %%xmm4\n\t"
+			       "psrldq $12, %%xmm6\n\t"
+			       "por %%xmm4, %%xmm2\n\t"
+			       "por %%xmm5, %%xmm3\n\t"
+			       "por %%xmm6, %%xmm3\n\t"
+			       /* Reduce modulo x^128 + x^7 + x^2 + x + 1 */
+			       "movdqa %%xmm2, %%xmm4\n\t"
+			       "movdqa %%xmm2, %%xmm5\n\t"
+			       "movdqa %%xmm2, %%xmm6\n\t"
+			       "pslld $31, %%xmm4\n\t"
+			       "pslld $30, %%xmm5\n\t"
+			       "pslld $25, %%xmm6\n\t"
+			       "pxor %%xmm5, %%xmm4\n\t"
+			       "pxor %%xmm6, %%xmm4\n\t"
+			       "movdqa %%xmm4, %%xmm5\n\t"
+			       "pslldq $12, %%xmm4\n\t"
+			       "psrldq $4, %%xmm5\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "movdqa %%xmm2, %%xmm0\n\t"
+			       "movdqa %%xmm2, %%xmm4\n\t"
+			       "movdqa %%xmm2, %%xmm6\n\t"
+			       "psrld $1, %%xmm0\n\t"
+			       "psrld $2, %%xmm4\n\t"
+			       "psrld $7, %%xmm6\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       "pxor %%xmm6, %%xmm0\n\t"
+			       "pxor %%xmm5, %%xmm0\n\t"
+			       "pxor %%xmm0, %%xmm2\n\t"
+			       "pxor %%xmm2, %%xmm3\n\t"
+			       "movdqa %%xmm3, %%xmm0\n\t"
+			       /* Next block */
+			       "add $16, %[data]\n\t"
+			       "dec %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       "pshufb %%xmm7, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%[hash])\n\t"
+			       : [data] "+r" ( data ),
+				 [blocks] "+r" ( blocks )
+			       : [bswap] "r" ( ghash_pclmul_bswap ),
+				 [key] "r" ( &gcm->key ),
+				 [hash] "r" ( &gcm->hash )
+			       : "memory" );
+}
+
+/** PCLMULQDQ GHASH engine */
+struct ghash_engine ghash_pclmul_engine __ghash_engine ( GHASH_ENGINE_ACCELERATED ) = {
+	.name = "pclmul",
+	.supported = ghash_pclmul_supported,
+	.update = ghash_pclmul_update,
+};
@@ -0,0 +1,256 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdint.h>
+#include <cpu.h>
+#include <ipxe/sha1.h>
+
+/** @file
+ *
+ * SHA-NI accelerated SHA-1 engine
+ *
+ * Uses the SHA1RNDS4, SHA1NEXTE, SHA1MSG1 and SHA1MSG2 instructions,
+ * following the instruction sequence given in Intel's "Intel SHA
+ * Extensions" white paper.  Message words are byte-swapped using
+ * PSHUFB, so SSSE3 is also required.
+ *
+ * As with the AES-NI engine, the inline assembly does not (and
+ * cannot) declare the %xmm registers as clobbered.
+ */
+
+/** Byte reversal mask for PSHUFB */
+static const uint8_t sha1_ni_bswap[16] __attribute__ (( aligned ( 16 ) )) = {
+	15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0
+};
+
+/* Register allocation */
+#define ABCD "%%xmm0"
+#define E0 "%%xmm1"
+#define E1 "%%xmm2"
+#define MSG0 "%%xmm3"
+#define MSG1 "%%xmm4"
+#define MSG2 "%%xmm5"
+#define MSG3 "%%xmm6"
+#define MASK "%%xmm7"
+
+/**
+ * Check if SHA-NI engine is supported
+ *
+ * @ret supported	Engine is supported
+ */
+static int sha1_ni_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	get_cpuinfo ( &cpu );
+	if ( ! ( cpu.struct_features & ( 1 << X86_FEATURE_SHA ) ) )
+		return 0;
+	if ( ! ( cpu.ext_features & ( 1 << X86_FEATURE_SSSE3 ) ) )
+		return 0;
+	return enable_sse();
+}
+
+/**
+ * Digest data blocks using SHA-NI
+ *
+ * @v h			Hash state
+ * @v data		Data blocks
+ * @v blocks		Number of blocks
+ *
+ * The state is held with A in the most significant dword of ABCD,
+ * and E in the most significant dword of E0/E1.
+ */
+static void sha1_ni_digest ( uint32_t *h, const void *data, size_t blocks ) {
+	uint32_t save[8];
+
+	if ( ! blocks )
+		return;
+
+	__asm__ __volatile__ ( "movdqa (%[bswap]), " MASK "\n\t"
+			       "movdqu (%[h]), " ABCD "\n\t"
+			       "pshufd $0x1b, " ABCD ", " ABCD "\n\t"
+			       "movd 16(%[h]), " E0 "\n\t"
+			       "pslldq $12, " E0 "\n\t"
+			       "\n1:\n\t"
+			       "movdqu " ABCD ", (%[save])\n\t"
+			       "movdqu " E0 ", 16(%[save])\n\t"
+			       /* Rounds 0-3 */
+			       "movdqu (%[data]), " MSG0 "\n\t"
+			       "pshufb " MASK ", " MSG0 "\n\t"
+			       "paddd " MSG0 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1rnds4 $0, " E0 ", " ABCD "\n\t"
+			       /* Rounds 4-7 */
+			       "movdqu 16(%[data]), " MSG1 "\n\t"
+			       "pshufb " MASK ", " MSG1 "\n\t"
+			       "sha1nexte " MSG1 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1rnds4 $0, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG1 ", " MSG0 "\n\t"
+			       /* Rounds 8-11 */
+			       "movdqu 32(%[data]), " MSG2 "\n\t"
+			       "pshufb " MASK ", " MSG2 "\n\t"
+			       "sha1nexte " MSG2 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1rnds4 $0, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG2 ", " MSG1 "\n\t"
+			       "pxor " MSG2 ", " MSG0 "\n\t"
+			       /* Rounds 12-15 */
+			       "movdqu 48(%[data]), " MSG3 "\n\t"
+			       "pshufb " MASK ", " MSG3 "\n\t"
+			       "sha1nexte " MSG3 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG3 ", " MSG0 "\n\t"
+			       "sha1rnds4 $0, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG3 ", " MSG2 "\n\t"
+			       "pxor " MSG3 ", " MSG1 "\n\t"
+			       /* Rounds 16-19 */
+			       "sha1nexte " MSG0 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG0 ", " MSG1 "\n\t"
+			       "sha1rnds4 $0, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG0 ", " MSG3 "\n\t"
+			       "pxor " MSG0 ", " MSG2 "\n\t"
+			       /* Rounds 20-23 */
+			       "sha1nexte " MSG1 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG1 ", " MSG2 "\n\t"
+			       "sha1rnds4 $1, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG1 ", " MSG0 "\n\t"
+			       "pxor " MSG1 ", " MSG3 "\n\t"
+			       /* Rounds 24-27 */
+			       "sha1nexte " MSG2 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG2 ", " MSG3 "\n\t"
+			       "sha1rnds4 $1, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG2 ", " MSG1 "\n\t"
+			       "pxor " MSG2 ", " MSG0 "\n\t"
+			       /* Rounds 28-31 */
+			       "sha1nexte " MSG3 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG3 ", " MSG0 "\n\t"
+			       "sha1rnds4 $1, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG3 ", " MSG2 "\n\t"
+			       "pxor " MSG3 ", " MSG1 "\n\t"
+			       /* Rounds 32-35 */
+			       "sha1nexte " MSG0 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG0 ", " MSG1 "\n\t"
+			       "sha1rnds4 $1, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG0 ", " MSG3 "\n\t"
+			       "pxor " MSG0 ", " MSG2 "\n\t"
+			       /* Rounds 36-39 */
+			       "sha1nexte " MSG1 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG1 ", " MSG2 "\n\t"
+			       "sha1rnds4 $1, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG1 ", " MSG0 "\n\t"
+			       "pxor " MSG1 ", " MSG3 "\n\t"
+			       /* Rounds 40-43 */
+			       "sha1nexte " MSG2 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG2 ", " MSG3 "\n\t"
+			       "sha1rnds4 $2, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG2 ", " MSG1 "\n\t"
+			       "pxor " MSG2 ", " MSG0 "\n\t"
+			       /* Rounds 44-47 */
+			       "sha1nexte " MSG3 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG3 ", " MSG0 "\n\t"
+			       "sha1rnds4 $2, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG3 ", " MSG2 "\n\t"
+			       "pxor " MSG3 ", " MSG1 "\n\t"
+			       /* Rounds 48-51 */
+			       "sha1nexte " MSG0 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG0 ", " MSG1 "\n\t"
+			       "sha1rnds4 $2, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG0 ", " MSG3 "\n\t"
+			       "pxor " MSG0 ", " MSG2 "\n\t"
+			       /* Rounds 52-55 */
+			       "sha1nexte " MSG1 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG1 ", " MSG2 "\n\t"
+			       "sha1rnds4 $2, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG1 ", " MSG0 "\n\t"
+			       "pxor " MSG1 ", " MSG3 "\n\t"
+			       /* Rounds 56-59 */
+			       "sha1nexte " MSG2 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG2 ", " MSG3 "\n\t"
+			       "sha1rnds4 $2, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG2 ", " MSG1 "\n\t"
+			       "pxor " MSG2 ", " MSG0 "\n\t"
+			       /* Rounds 60-63 */
+			       "sha1nexte " MSG3 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG3 ", " MSG0 "\n\t"
+			       "sha1rnds4 $3, " E1 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG3 ", " MSG2 "\n\t"
+			       "pxor " MSG3 ", " MSG1 "\n\t"
+			       /* Rounds 64-67 */
+			       "sha1nexte " MSG0 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG0 ", " MSG1 "\n\t"
+			       "sha1rnds4 $3, " E0 ", " ABCD "\n\t"
+			       "sha1msg1 " MSG0 ", " MSG3 "\n\t"
+			       "pxor " MSG0 ", " MSG2 "\n\t"
+			       /* Rounds 68-71 */
+			       "sha1nexte " MSG1 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1msg2 " MSG1 ", " MSG2 "\n\t"
+			       "sha1rnds4 $3, " E1 ", " ABCD "\n\t"
+			       "pxor " MSG1 ", " MSG3 "\n\t"
+			       /* Rounds 72-75 */
+			       "sha1nexte " MSG2 ", " E0 "\n\t"
+			       "movdqa " ABCD ", " E1 "\n\t"
+			       "sha1msg2 " MSG2 ", " MSG3 "\n\t"
+			       "sha1rnds4 $3, " E0 ", " ABCD "\n\t"
+			       /* Rounds 76-79 */
+			       "sha1nexte " MSG3 ", " E1 "\n\t"
+			       "movdqa " ABCD ", " E0 "\n\t"
+			       "sha1rnds4 $3, " E1 ", " ABCD "\n\t"
+			       /* Add in previous state */
+			       "movdqu 16(%[save]), " E1 "\n\t"
+			       "sha1nexte " E1 ", " E0 "\n\t"
+			       "movdqu (%[save]), " E1 "\n\t"
+			       "paddd " E1 ", " ABCD "\n\t"
+			       /* Next block */
+			       "add $64, %[data]\n\t"
+			       "dec %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       "pshufd $0x1b, " ABCD ", " ABCD "\n\t"
+			       "movdqu " ABCD ", (%[h])\n\t"
+			       "psrldq $12, " E0 "\n\t"
+			       "movd " E0 ", 16(%[h])\n\t"
+			       : [data] "+r" ( data ),
+				 [blocks] "+r" ( blocks )
+			       : [bswap] "r" ( sha1_ni_bswap ),
+				 [h] "r" ( h ),
+				 [save] "r" ( save )
+			       : "memory" );
+}
+
+/** SHA-NI SHA-1 engine */
+struct sha1_engine sha1_ni_engine __sha1_engine ( SHA1_ENGINE_ACCELERATED ) = {
+	.name = "sha-ni",
+	.supported = sha1_ni_supported,
+	.digest = sha1_ni_digest,
+};
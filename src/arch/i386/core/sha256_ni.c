@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdint.h>
+#include <cpu.h>
+#include <ipxe/sha256.h>
+
+/** @file
+ *
+ * SHA-NI accelerated SHA-256 engine
+ *
+ * Uses the SHA256RNDS2, SHA256MSG1 and SHA256MSG2 instructions,
+ * following the instruction sequence given in Intel's "Intel SHA
+ * Extensions" white paper.  Message words are byte-swapped using
+ * PSHUFB, so SSSE3 is also required.
+ *
+ * As with the AES-NI engine, the inline assembly does not (and
+ * cannot) declare the %xmm registers as clobbered.
+ */
+
+/** Byte reversal mask for PSHUFB */
+static const uint8_t sha256_ni_bswap[16] __attribute__ (( aligned ( 16 ) )) = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+};
+
+/* Register allocation (SHA256RNDS2 implicitly uses %xmm0) */
+#define MSG "%%xmm0"
+#define STATE0 "%%xmm1"
+#define STATE1 "%%xmm2"
+#define MSGTMP0 "%%xmm3"
+#define MSGTMP1 "%%xmm4"
+#define MSGTMP2 "%%xmm5"
+#define MSGTMP3 "%%xmm6"
+#define TMP "%%xmm7"
+#define MASK "(%[bswap])"
+
+/**
+ * Check if SHA-NI engine is supported
+ *
+ * @ret supported	Engine is supported
+ */
+static int sha256_ni_supported ( void ) {
+	struct cpuinfo_x86 cpu;
+
+	get_cpuinfo ( &cpu );
+	if ( ! ( cpu.struct_features & ( 1 << X86_FEATURE_SHA ) ) )
+		return 0;
+	if ( ! ( cpu.ext_features & ( 1 << X86_FEATURE_SSSE3 ) ) )
+		return 0;
+	return enable_sse();
+}
+
+/**
+ * Digest data blocks using SHA-NI
+ *
+ * @v h			Hash state
+ * @v data		Data blocks
+ * @v blocks		Number of blocks
+ *
+ * The state is held as ABEF in STATE0 and CDGH in STATE1, which is
+ * the layout expected by SHA256RNDS2.
+ */
+static void sha256_ni_digest ( uint32_t *h, const void *data,
+			       size_t blocks ) {
+	uint32_t save[8];
+
+	if ( ! blocks )
+		return;
+
+	__asm__ __volatile__ ( /* Convert DCBA/HGFE to ABEF/CDGH */
+			       "movdqu (%[h]), " STATE0 "\n\t"
+			       "movdqu 16(%[h]), " STATE1 "\n\t"
+			       "movdqa " STATE0 ", " TMP "\n\t"
+			       "punpcklqdq " STATE1 ", " STATE0 "\n\t"
+			       "punpckhqdq " TMP ", " STATE1 "\n\t"
+			       "pshufd $0x1b, " STATE0 ", " STATE0 "\n\t"
+			       "pshufd $0xb1, " STATE1 ", " STATE1 "\n\t"
+			       "\n1:\n\t"
+			       "movdqu " STATE0 ", (%[save])\n\t"
+			       "movdqu " STATE1 ", 16(%[save])\n\t"
+			       /* Rounds 0-3 */
+			       "movdqu (%[data]), " MSGTMP0 "\n\t"
+			       "pshufb " MASK ", " MSGTMP0 "\n\t"
+			       "movdqa (%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP0 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       /* Rounds 4-7 */
+			       "movdqu 16(%[data]), " MSGTMP1 "\n\t"
+			       "pshufb " MASK ", " MSGTMP1 "\n\t"
+			       "movdqa 16(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP1 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP1 ", " MSGTMP0 "\n\t"
+			       /* Rounds 8-11 */
+			       "movdqu 32(%[data]), " MSGTMP2 "\n\t"
+			       "pshufb " MASK ", " MSGTMP2 "\n\t"
+			       "movdqa 32(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP2 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP2 ", " MSGTMP1 "\n\t"
+			       /* Rounds 12-15 */
+			       "movdqu 48(%[data]), " MSGTMP3 "\n\t"
+			       "pshufb " MASK ", " MSGTMP3 "\n\t"
+			       "movdqa 48(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP3 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP3 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP2 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP0 "\n\t"
+			       "sha256msg2 " MSGTMP3 ", " MSGTMP0 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP3 ", " MSGTMP2 "\n\t"
+			       /* Rounds 16-19 */
+			       "movdqa 64(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP0 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP0 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP3 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP1 "\n\t"
+			       "sha256msg2 " MSGTMP0 ", " MSGTMP1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP0 ", " MSGTMP3 "\n\t"
+			       /* Rounds 20-23 */
+			       "movdqa 80(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP1 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP1 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP0 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP2 "\n\t"
+			       "sha256msg2 " MSGTMP1 ", " MSGTMP2 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP1 ", " MSGTMP0 "\n\t"
+			       /* Rounds 24-27 */
+			       "movdqa 96(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP2 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP2 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP1 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP3 "\n\t"
+			       "sha256msg2 " MSGTMP2 ", " MSGTMP3 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP2 ", " MSGTMP1 "\n\t"
+			       /* Rounds 28-31 */
+			       "movdqa 112(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP3 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP3 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP2 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP0 "\n\t"
+			       "sha256msg2 " MSGTMP3 ", " MSGTMP0 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP3 ", " MSGTMP2 "\n\t"
+			       /* Rounds 32-35 */
+			       "movdqa 128(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP0 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP0 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP3 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP1 "\n\t"
+			       "sha256msg2 " MSGTMP0 ", " MSGTMP1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP0 ", " MSGTMP3 "\n\t"
+			       /* Rounds 36-39 */
+			       "movdqa 144(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP1 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP1 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP0 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP2 "\n\t"
+			       "sha256msg2 " MSGTMP1 ", " MSGTMP2 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP1 ", " MSGTMP0 "\n\t"
+			       /* Rounds 40-43 */
+			       "movdqa 160(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP2 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP2 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP1 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP3 "\n\t"
+			       "sha256msg2 " MSGTMP2 ", " MSGTMP3 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP2 ", " MSGTMP1 "\n\t"
+			       /* Rounds 44-47 */
+			       "movdqa 176(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP3 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP3 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP2 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP0 "\n\t"
+			       "sha256msg2 " MSGTMP3 ", " MSGTMP0 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP3 ", " MSGTMP2 "\n\t"
+			       /* Rounds 48-51 */
+			       "movdqa 192(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP0 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP0 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP3 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP1 "\n\t"
+			       "sha256msg2 " MSGTMP0 ", " MSGTMP1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       "sha256msg1 " MSGTMP0 ", " MSGTMP3 "\n\t"
+			       /* Rounds 52-55 */
+			       "movdqa 208(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP1 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP1 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP0 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP2 "\n\t"
+			       "sha256msg2 " MSGTMP1 ", " MSGTMP2 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       /* Rounds 56-59 */
+			       "movdqa 224(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP2 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "movdqa " MSGTMP2 ", " TMP "\n\t"
+			       "palignr $4, " MSGTMP1 ", " TMP "\n\t"
+			       "paddd " TMP ", " MSGTMP3 "\n\t"
+			       "sha256msg2 " MSGTMP2 ", " MSGTMP3 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       /* Rounds 60-63 */
+			       "movdqa 240(%[k]), " MSG "\n\t"
+			       "paddd " MSGTMP3 ", " MSG "\n\t"
+			       "sha256rnds2 " STATE0 ", " STATE1 "\n\t"
+			       "punpckhqdq " MSG ", " MSG "\n\t"
+			       "sha256rnds2 " STATE1 ", " STATE0 "\n\t"
+			       /* Add in previous state */
+			       "movdqu (%[save]), " TMP "\n\t"
+			       "paddd " TMP ", " STATE0 "\n\t"
+			       "movdqu 16(%[save]), " TMP "\n\t"
+			       "paddd " TMP ", " STATE1 "\n\t"
+			       /* Next block */
+			       "add $64, %[data]\n\t"
+			       "dec %[blocks]\n\t"
+			       "jnz 1b\n\t"
+			       /* Convert ABEF/CDGH back to DCBA/HGFE */
+			       "movdqa " STATE0 ", " TMP "\n\t"
+			       "punpcklqdq " STATE1 ", " STATE0 "\n\t"
+			       "punpckhqdq " TMP ", " STATE1 "\n\t"
+			       "pshufd $0xb1, " STATE0 ", " STATE0 "\n\t"
+			       "pshufd $0x1b, " STATE1 ", " STATE1 "\n\t"
+			       "movdqu " STATE1 ", (%[h])\n\t"
+			       "movdqu " STATE0 ", 16(%[h])\n\t"
+			       : [data] "+r" ( data ),
+				 [blocks] "+r" ( blocks )
+			       : [bswap] "r" ( sha256_ni_bswap ),
+				 [k] "r" ( sha256_k ),
+				 [h] "r" ( h ),
+				 [save] "r" ( save )
+			       : "memory" );
+}
+
+/** SHA-NI SHA-256 engine */
+struct sha256_engine sha256_ni_engine
+	__sha256_engine ( SHA256_ENGINE_ACCELERATED ) = {
+	.name = "sha-ni",
+	.supported = sha256_ni_supported,
+	.digest = sha256_ni_digest,
+};
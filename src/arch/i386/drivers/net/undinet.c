@@ -298,6 +298,7 @@ static void undinet_poll ( struct net_device *netdev ) {
 				       "allocate %zd bytes for RX buffer\n",
 				       undinic, len );
 				/* Fragment will be dropped */
+				netdev_rx_alloc_fail ( netdev );
 				netdev_rx_err ( netdev, NULL, -ENOMEM );
 				goto done;
 			}
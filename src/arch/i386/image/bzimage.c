@@ -27,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
@@ -37,7 +38,11 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/segment.h>
 #include <ipxe/init.h>
 #include <ipxe/cpio.h>
+#include <ipxe/settings.h>
+#include <ipxe/dhcp.h>
+#include <ipxe/trace.h>
 #include <ipxe/features.h>
+#include <config/general.h>
 
 FEATURE ( FEATURE_IMAGE, "bzImage", DHCP_EB_FEATURE_BZIMAGE, 1 );
 
@@ -67,6 +72,11 @@ struct bzimage_context {
 	userptr_t pm_kernel;
 	/** Non-real-mode kernel portion file and memory size */
 	size_t pm_sz;
+	/** End of memory used by the kernel while it initialises
+	 *
+	 * This is zero if the kernel does not tell us.
+	 */
+	uint64_t pm_init_end;
 	/** Video mode */
 	unsigned int vid_mode;
 	/** Memory limit */
@@ -179,6 +189,21 @@ static int bzimage_parse_header ( struct image *image,
 	bzimg->cmdline_size = ( ( bzimg->version >= 0x0206 ) ?
 				bzimg->bzhdr.cmdline_size : BZI_CMDLINE_SIZE );
 
+	/* Extract memory used during initialisation.  The kernel
+	 * decompresses itself starting at the load address (or its
+	 * preferred address, if higher), and may need many times the
+	 * size of the protected-mode portion of the file to do so.
+	 */
+	if ( bzimg->version >= 0x020a ) {
+		bzimg->pm_init_end = bzimg->bzhdr.pref_address;
+		if ( bzimg->pm_init_end < BZI_LOAD_HIGH_ADDR )
+			bzimg->pm_init_end = BZI_LOAD_HIGH_ADDR;
+		bzimg->pm_init_end += ( ( bzimg->bzhdr.init_size >
+					  bzimg->pm_sz ) ?
+					bzimg->bzhdr.init_size :
+					bzimg->pm_sz );
+	}
+
 	DBGC ( image, "bzImage %p version %04x RM %#lx+%#zx PM %#lx+%#zx "
 	       "cmdlen %zd\n", image, bzimg->version,
 	       user_to_phys ( bzimg->rm_kernel, 0 ), bzimg->rm_filesz,
@@ -298,6 +323,16 @@ static int bzimage_parse_cmdline ( struct image *image,
 	return 0;
 }
 
+#ifdef TRACE_CMD
+/** Append boot timeline trace to kernel command line setting */
+struct setting trace_cmdline_setting __setting = {
+	.name = "trace-cmdline",
+	.description = "Append boot timeline trace to kernel command line",
+	.tag = DHCP_EB_TRACE_CMDLINE,
+	.type = &setting_type_uint8,
+};
+#endif
+
 /**
  * Set command line
  *
@@ -310,6 +345,25 @@ static int bzimage_set_cmdline ( struct image *image,
 				 struct bzimage_context *bzimg,
 				 const char *cmdline ) {
 	size_t cmdline_len;
+	char *buf = NULL;
+#ifdef TRACE_CMD
+	size_t len;
+
+
+	/* Append boot timeline trace, if requested and if at least
+	 * one trace entry fits.
+	 */
+	if ( fetch_uintz_setting ( NULL, &trace_cmdline_setting ) &&
+	     ( buf = malloc ( bzimg->cmdline_size ) ) ) {
+		len = snprintf ( buf, bzimg->cmdline_size, "%s%sipxe.trace=",
+				 cmdline, ( cmdline[0] ? " " : "" ) );
+		if ( ( len < bzimg->cmdline_size ) &&
+		     trace_summary ( ( buf + len ),
+				     ( bzimg->cmdline_size - len ) ) ) {
+			cmdline = buf;
+		}
+	}
+#endif
 
 	/* Copy command line down to real-mode portion */
 	cmdline_len = ( strlen ( cmdline ) + 1 );
@@ -319,6 +373,7 @@ static int bzimage_set_cmdline ( struct image *image,
 		       cmdline, cmdline_len );
 	DBGC ( image, "bzImage %p command line \"%s\"\n", image, cmdline );
 
+	free ( buf );
 	return 0;
 }
 
@@ -334,7 +389,7 @@ static size_t bzimage_load_initrd ( struct image *image,
 				    struct image *initrd,
 				    userptr_t address ) {
 	char *filename = initrd->cmdline;
-	struct cpio_header cpio;
+	size_t hdr_len;
         size_t offset = 0;
 
 	/* Do not include kernel image itself as an initrd */
@@ -342,28 +397,17 @@ static size_t bzimage_load_initrd ( struct image *image,
 		return 0;
 
 	/* Create cpio header before non-prebuilt images */
-	if ( filename && filename[0] ) {
-		size_t name_len = ( strlen ( filename ) + 1 );
+	hdr_len = cpio_header_len ( filename );
+	if ( hdr_len ) {
+		char hdr[hdr_len];
 
 		DBGC ( image, "bzImage %p inserting initrd %p as %s\n",
 		       image, initrd, filename );
-		memset ( &cpio, '0', sizeof ( cpio ) );
-		memcpy ( cpio.c_magic, CPIO_MAGIC, sizeof ( cpio.c_magic ) );
-		cpio_set_field ( cpio.c_mode, 0100644 );
-		cpio_set_field ( cpio.c_nlink, 1 );
-		cpio_set_field ( cpio.c_filesize, initrd->len );
-		cpio_set_field ( cpio.c_namesize, name_len );
 		if ( address ) {
-			copy_to_user ( address, offset, &cpio,
-				       sizeof ( cpio ) );
+			cpio_header ( filename, initrd->len, hdr );
+			copy_to_user ( address, offset, hdr, hdr_len );
 		}
-		offset += sizeof ( cpio );
-		if ( address ) {
-			copy_to_user ( address, offset, filename,
-				       name_len );
-		}
-		offset += name_len;
-		offset = ( ( offset + 0x03 ) & ~0x03 );
+		offset += hdr_len;
 	}
 
 	/* Copy in initrd image body */
@@ -381,6 +425,63 @@ static size_t bzimage_load_initrd ( struct image *image,
 	return offset;
 }
 
+/**
+ * Use initrd in place, if possible
+ *
+ * @v image		bzImage image
+ * @v bzimg		bzImage context
+ * @v initrd		Sole initrd image
+ * @ret rc		Return status code
+ *
+ * Copying a large initrd at boot time is slow, and temporarily
+ * requires twice as much memory.  If the downloader reserved enough
+ * space before the initrd for its cpio header (if any), and the
+ * initrd is somewhere the kernel can reach, then construct the
+ * header in situ and pass the initrd to the kernel where it lies.
+ */
+static int bzimage_place_initrd ( struct image *image,
+				  struct bzimage_context *bzimg,
+				  struct image *initrd ) {
+	size_t hdr_len = cpio_header_len ( initrd->cmdline );
+	physaddr_t start;
+	physaddr_t end;
+
+	/* Check that there is space for the cpio header */
+	if ( hdr_len > initrd->headroom )
+		return -ENOSPC;
+
+	/* Check that we are within the kernel's range, and are not
+	 * going to be overwritten by the kernel itself as it
+	 * decompresses.  Kernels too old to tell us how much memory
+	 * that requires must have the initrd copied.
+	 */
+	if ( ! bzimg->pm_init_end )
+		return -ERANGE;
+	start = user_to_phys ( initrd->data, -hdr_len );
+	end = user_to_phys ( initrd->data, initrd->len );
+	if ( ( ( end - 1 ) > bzimg->mem_limit ) ||
+	     ( start < bzimg->pm_init_end ) )
+		return -ERANGE;
+
+	/* Construct cpio header in situ */
+	if ( hdr_len ) {
+		char hdr[hdr_len];
+
+		DBGC ( image, "bzImage %p inserting initrd %p as %s\n",
+		       image, initrd, initrd->cmdline );
+		cpio_header ( initrd->cmdline, initrd->len, hdr );
+		copy_to_user ( initrd->data, -hdr_len, hdr, hdr_len );
+	}
+
+	/* Record initrd location */
+	bzimg->ramdisk_image = start;
+	bzimg->ramdisk_size = ( end - start );
+	DBGC ( image, "bzImage %p using initrd %p in place at [%lx,%lx)\n",
+	       image, initrd, start, end );
+
+	return 0;
+}
+
 /**
  * Load initrds, if any
  *
@@ -391,18 +492,32 @@ static size_t bzimage_load_initrd ( struct image *image,
 static int bzimage_load_initrds ( struct image *image,
 				  struct bzimage_context *bzimg ) {
 	struct image *initrd;
+	struct image *sole = NULL;
+	unsigned int count = 0;
 	size_t total_len = 0;
+	size_t len;
 	physaddr_t address;
 	int rc;
 
 	/* Add up length of all initrd images */
-	for_each_image ( initrd )
-		total_len += bzimage_load_initrd ( image, initrd, UNULL );
+	for_each_image ( initrd ) {
+		len = bzimage_load_initrd ( image, initrd, UNULL );
+		if ( len ) {
+			sole = initrd;
+			count++;
+		}
+		total_len += len;
+	}
 
 	/* Give up if no initrd images found */
 	if ( ! total_len )
 		return 0;
 
+	/* Use a single initrd in place, if possible */
+	if ( ( count == 1 ) &&
+	     ( bzimage_place_initrd ( image, bzimg, sole ) == 0 ) )
+		return 0;
+
 	/* Find a suitable start address.  Try 1MB boundaries,
 	 * starting from the downloaded kernel image itself and
 	 * working downwards until we hit an available region.
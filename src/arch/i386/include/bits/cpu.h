@@ -33,6 +33,16 @@
 #define X86_FEATURE_ACC		29 /* Automatic clock control */
 #define X86_FEATURE_IA64	30 /* IA-64 processor */
 
+/* Intel-defined CPU features, CPUID level 0x00000001 (%ecx), word 2 */
+#define X86_FEATURE_XMM3	0 /* Streaming SIMD Extensions-3 */
+#define X86_FEATURE_PCLMULQDQ	1 /* Carry-less multiplication */
+#define X86_FEATURE_SSSE3	9 /* Supplemental SSE-3 */
+#define X86_FEATURE_XMM4_1	19 /* Streaming SIMD Extensions-4.1 */
+#define X86_FEATURE_AES		25 /* AES instructions */
+
+/* Intel-defined CPU features, CPUID level 0x00000007 (%ebx), word 3 */
+#define X86_FEATURE_SHA		29 /* SHA extensions */
+
 /* AMD-defined CPU features, CPUID level 0x80000001, word 1 */
 /* Don't duplicate feature flags which are redundant with Intel! */
 #define X86_FEATURE_SYSCALL	11 /* SYSCALL/SYSRET */
@@ -47,6 +57,10 @@ struct cpuinfo_x86 {
 	unsigned int features;
 	/** 64-bit CPU features */
 	unsigned int amd_features;
+	/** Extended CPU features */
+	unsigned int ext_features;
+	/** Structured extended CPU features */
+	unsigned int struct_features;
 };
 
 /*
@@ -70,6 +84,13 @@ struct cpuinfo_x86 {
 #define X86_EFLAGS_VIP	0x00100000 /* Virtual Interrupt Pending */
 #define X86_EFLAGS_ID	0x00200000 /* CPUID detection flag */
 
+/*
+ * Control register bits
+ */
+#define X86_CR0_EM	0x00000004 /* Emulation */
+#define X86_CR0_TS	0x00000008 /* Task Switched */
+#define X86_CR4_OSFXSR	0x00000200 /* OS supports FXSAVE/FXRSTOR and SSE */
+
 /*
  * Generic CPUID function
  */
@@ -81,6 +102,18 @@ cpuid ( int op, unsigned int *eax, unsigned int *ebx,
 		: "0" ( op ) );
 }
 
+/*
+ * Generic CPUID function, with a subleaf index
+ */
+static inline __attribute__ (( always_inline )) void
+cpuid_count ( int op, int count, unsigned int *eax, unsigned int *ebx,
+	      unsigned int *ecx, unsigned int *edx ) {
+	__asm__ ( "cpuid" :
+		  "=a" ( *eax ), "=b" ( *ebx ), "=c" ( *ecx ), "=d" ( *edx )
+		: "0" ( op ), "2" ( count ) );
+}
+
 extern void get_cpuinfo ( struct cpuinfo_x86 *cpu );
+extern int enable_sse ( void );
 
 #endif /* I386_BITS_CPU_H */
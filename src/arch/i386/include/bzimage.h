@@ -72,6 +72,20 @@ struct bzimage_header {
 	uint8_t pad2[3];
 	/** Maximum size of the kernel command line */
 	uint32_t cmdline_size;
+	/** Hardware subarchitecture */
+	uint32_t hardware_subarch;
+	/** Subarchitecture-specific data */
+	uint64_t hardware_subarch_data;
+	/** Offset of kernel payload */
+	uint32_t payload_offset;
+	/** Length of kernel payload */
+	uint32_t payload_length;
+	/** 64-bit physical pointer to linked list of setup data */
+	uint64_t setup_data;
+	/** Preferred load address */
+	uint64_t pref_address;
+	/** Linear memory required during initialisation */
+	uint32_t init_size;
 } __attribute__ (( packed ));
 
 /** Offset of bzImage header within kernel image */
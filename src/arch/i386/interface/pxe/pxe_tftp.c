@@ -168,17 +168,21 @@ static int pxe_tftp_open ( uint32_t ipaddress, unsigned int port,
 	intf_init ( &pxe_tftp.xfer, &pxe_tftp_xfer_desc, NULL );
 	pxe_tftp.rc = -EINPROGRESS;
 
-	/* Construct URI string */
+	/* Construct URI string.  The PXE TFTP API delivers one packet
+	 * per TFTP_READ call, and so cannot accept a window of several
+	 * blocks at once.
+	 */
 	address.s_addr = ipaddress;
 	if ( ! port )
 		port = htons ( TFTP_PORT );
 	if ( blksize < TFTP_DEFAULT_BLKSIZE )
 		blksize = TFTP_DEFAULT_BLKSIZE;
 	snprintf ( uri_string, sizeof ( uri_string ),
-		   "tftp%s://%s:%d%s%s?blksize=%zd",
+		   "tftp%s://%s:%d%s%s?blksize=%zd&windowsize=%d",
 		   sizeonly ? "size" : "",
 		   inet_ntoa ( address ), ntohs ( port ),
-		   ( ( filename[0] == '/' ) ? "" : "/" ), filename, blksize );
+		   ( ( filename[0] == '/' ) ? "" : "/" ), filename, blksize,
+		   TFTP_DEFAULT_WINDOWSIZE );
 	DBG ( " %s", uri_string );
 
 	/* Open PXE TFTP connection */
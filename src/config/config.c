@@ -192,6 +192,9 @@ REQUIRE_OBJECT ( comboot_resolv );
 #ifdef IMAGE_EFI
 REQUIRE_OBJECT ( efi_image );
 #endif
+#ifdef IMAGE_DIGEST
+REQUIRE_OBJECT ( image_digest );
+#endif
 
 /*
  * Drag in all requested commands
@@ -231,6 +234,15 @@ REQUIRE_OBJECT ( time_cmd );
 #ifdef DIGEST_CMD
 REQUIRE_OBJECT ( digest_cmd );
 #endif
+#ifdef TRACE_CMD
+REQUIRE_OBJECT ( trace_cmd );
+#endif
+#ifdef TCPSTAT_CMD
+REQUIRE_OBJECT ( tcpstat_cmd );
+#endif
+#ifdef BENCH_CMD
+REQUIRE_OBJECT ( bench_cmd );
+#endif
 #ifdef PXE_CMD
 REQUIRE_OBJECT ( pxe_cmd );
 #endif
@@ -0,0 +1,24 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2, or (at
+ * your option) any later version.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <config/general.h>
+
+/** @file
+ *
+ * SHA-1 configuration options
+ *
+ */
+
+/*
+ * Drag in accelerated SHA-1 engines
+ *
+ */
+#ifdef CRYPTO_SHA_NI
+REQUIRE_OBJECT ( sha1_ni );
+#endif
@@ -32,4 +32,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	SANBOOT_PROTO_ISCSI	/* iSCSI protocol */
 #define	SANBOOT_PROTO_AOE	/* AoE protocol */
 
+#define	CRYPTO_AES_NI		/* AES-NI accelerated AES */
+#define	CRYPTO_GCM_PCLMUL	/* PCLMULQDQ accelerated GHASH */
+#define	CRYPTO_SHA_NI		/* SHA-NI accelerated SHA-1 and SHA-256 */
+
 #endif /* CONFIG_DEFAULTS_PCBIOS_H */
@@ -102,6 +102,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 //#define	IMAGE_BZIMAGE		/* Linux bzImage image support */
 //#define	IMAGE_COMBOOT		/* SYSLINUX COMBOOT image support */
 //#define	IMAGE_EFI		/* EFI image support */
+#undef	IMAGE_DIGEST		/* Image digest verification (imgfetch -d) */
 
 /*
  * Command-line commands to include
@@ -119,6 +120,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define LOGIN_CMD		/* Login command */
 #undef	TIME_CMD		/* Time commands */
 #undef	DIGEST_CMD		/* Image crypto digest commands */
+#undef	TRACE_CMD		/* Boot timeline tracing and commands */
+#undef	TCPSTAT_CMD		/* TCP statistics commands */
+#undef	BENCH_CMD		/* Crypto self-tests and micro-benchmarks */
 //#undef	PXE_CMD			/* PXE commands */
 
 /*
@@ -135,6 +139,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 
 #define	NETDEV_DISCARD_RATE 0	/* Drop every N packets (0=>no drop) */
+#define	AUTOBOOT_PARALLEL 0	/* Configure all network devices at once
+				 * when autobooting (0=>one at a time)
+				 */
 #undef	BUILD_SERIAL		/* Include an automatic build serial
 				 * number.  Add "bs" to the list of
 				 * make targets.  For example:
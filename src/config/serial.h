@@ -32,6 +32,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	COMSTOP		1		/* Stop bits */
 #endif
 
+#define	COMTXBUF	4096		/* Transmit buffer size */
+
 #include <config/local/serial.h>
 
 #endif /* CONFIG_SERIAL_H */
@@ -94,8 +94,22 @@ void bitmap_set ( struct bitmap *bitmap, unsigned int bit ) {
 	/* Update bitmap */
 	bitmap->blocks[index] |= mask;
 
-	/* Update first gap counter */
-	while ( bitmap_test ( bitmap, bitmap->first_gap ) ) {
+	/* Update first gap counter.  Filling a gap may complete a
+	 * long run of bits that were set out of order (e.g. when
+	 * joining a multicast transfer part-way through), so skip
+	 * over complete blocks a whole block at a time.
+	 */
+	while ( bitmap->first_gap < bitmap->length ) {
+		index = BITMAP_INDEX ( bitmap->first_gap );
+		if ( ( ( bitmap->first_gap % BITMAP_BLKSIZE ) == 0 ) &&
+		     ( bitmap->blocks[index] == ~( ( bitmap_block_t ) 0 ) ) ){
+			bitmap->first_gap += BITMAP_BLKSIZE;
+			continue;
+		}
+		if ( ! bitmap_test ( bitmap, bitmap->first_gap ) )
+			break;
 		bitmap->first_gap++;
 	}
+	if ( bitmap->first_gap > bitmap->length )
+		bitmap->first_gap = bitmap->length;
 }
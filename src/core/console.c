@@ -2,11 +2,16 @@
 #include "console.h"
 #include <ipxe/process.h>
 #include <ipxe/nap.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
 
 /** @file */
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+/** Minimum idle time before halting the CPU (one timer interrupt) */
+#define CONSOLE_NAP_MIN_IDLE ( TICKS_PER_SEC / 18 )
+
 /**
  * Write a single character to each console device.
  *
@@ -95,8 +100,13 @@ int getchar ( void ) {
 		 * power dissipation of a modern CPU considerably, and also
 		 * makes Etherboot waiting for user interaction waste a lot
 		 * less CPU time in a VMware session.
+		 *
+		 * Don't doze if a retry timer is due to expire before
+		 * the next timer interrupt, since it would then fire
+		 * late.
 		 */
-		cpu_nap();
+		if ( retry_idle_ticks() >= CONSOLE_NAP_MIN_IDLE )
+			cpu_nap();
 
 		/* Keep processing background tasks while we wait for
 		 * input.
@@ -40,3 +40,42 @@ void cpio_set_field ( char *field, unsigned long value ) {
 	snprintf ( buf, sizeof ( buf ), "%08lx", value );
 	memcpy ( field, buf, 8 );
 }
+
+/**
+ * Calculate length of CPIO header for a named file
+ *
+ * @v name		File name, or NULL
+ * @ret len		Length of header (including name and padding)
+ *
+ * A zero length is returned if there is no file name, since no
+ * header is required.
+ */
+size_t cpio_header_len ( const char *name ) {
+	size_t len;
+
+	if ( ! ( name && name[0] ) )
+		return 0;
+	len = ( sizeof ( struct cpio_header ) + strlen ( name ) + 1 /* NUL */);
+	return ( ( len + 0x03 ) & ~0x03 );
+}
+
+/**
+ * Construct CPIO header for a named file
+ *
+ * @v name		File name
+ * @v len		Length of file
+ * @v data		Buffer (of length given by cpio_header_len())
+ */
+void cpio_header ( const char *name, size_t len, void *data ) {
+	struct cpio_header *cpio = data;
+	size_t name_len = ( strlen ( name ) + 1 /* NUL */ );
+
+	memset ( data, 0, cpio_header_len ( name ) );
+	memset ( cpio, '0', sizeof ( *cpio ) );
+	memcpy ( cpio->c_magic, CPIO_MAGIC, sizeof ( cpio->c_magic ) );
+	cpio_set_field ( cpio->c_mode, 0100644 );
+	cpio_set_field ( cpio->c_nlink, 1 );
+	cpio_set_field ( cpio->c_filesize, len );
+	cpio_set_field ( cpio->c_namesize, name_len );
+	memcpy ( ( data + sizeof ( *cpio ) ), name, name_len );
+}
@@ -19,6 +19,7 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include <errno.h>
 #include <ipxe/iobuf.h>
@@ -28,7 +29,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/uaccess.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/image.h>
+#include <ipxe/crypto.h>
 #include <ipxe/downloader.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -36,6 +39,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/* Disambiguate the various error causes */
+#define EACCES_DIGEST_MISMATCH \
+	__einfo_error ( EINFO_EACCES_DIGEST_MISMATCH )
+#define EINFO_EACCES_DIGEST_MISMATCH \
+	__einfo_uniqify ( EINFO_EACCES, 0x01, "Image digest mismatch" )
+
+/** Size of buffer used to digest or compare data not seen in transit */
+#define DOWNLOADER_DIGEST_CHUNK 256
+
 /** A downloader */
 struct downloader {
 	/** Reference count for this object */
@@ -52,6 +64,17 @@ struct downloader {
 	size_t pos;
 	/** Image registration routine */
 	int ( * register_image ) ( struct image *image );
+
+	/** Amount of data digested so far
+	 *
+	 * If the image has an expected digest, data is digested as
+	 * it arrives whenever it extends the data digested so far.
+	 */
+	size_t digest_pos;
+	/** Data already digested was changed; digest must be recalculated */
+	int digest_restart;
+	/** Digest context (if image has an expected digest) */
+	uint8_t digest_ctx[0];
 };
 
 /**
@@ -67,6 +90,53 @@ static void downloader_free ( struct refcnt *refcnt ) {
 	free ( downloader );
 }
 
+/**
+ * Verify downloaded image against expected digest
+ *
+ * @v downloader	Downloader
+ * @ret rc		Return status code
+ *
+ * Any data that was not digested as it arrived (which will be the
+ * whole image, if data already digested was subsequently changed) is
+ * read back from the image buffer.
+ */
+static int downloader_verify ( struct downloader *downloader ) {
+	struct image *image = downloader->image;
+	struct digest_algorithm *digest = image->digest;
+	uint8_t buf[DOWNLOADER_DIGEST_CHUNK];
+	uint8_t out[digest->digestsize];
+	size_t frag_len;
+
+	/* Start again from scratch if digested data was changed */
+	if ( downloader->digest_restart ) {
+		DBGC ( downloader, "Downloader %p recalculating %s digest\n",
+		       downloader, digest->name );
+		digest_init ( digest, downloader->digest_ctx );
+		downloader->digest_pos = 0;
+	}
+
+	/* Digest any remaining data */
+	while ( downloader->digest_pos < image->len ) {
+		frag_len = ( image->len - downloader->digest_pos );
+		if ( frag_len > sizeof ( buf ) )
+			frag_len = sizeof ( buf );
+		copy_from_user ( buf, image->data, downloader->digest_pos,
+				 frag_len );
+		digest_update ( digest, downloader->digest_ctx, buf, frag_len );
+		downloader->digest_pos += frag_len;
+	}
+	digest_final ( digest, downloader->digest_ctx, out );
+
+	/* Compare against expected digest */
+	if ( memcmp ( out, image->digest_value, sizeof ( out ) ) != 0 ) {
+		DBGC ( downloader, "Downloader %p %s digest mismatch\n",
+		       downloader, digest->name );
+		return -EACCES_DIGEST_MISMATCH;
+	}
+
+	return 0;
+}
+
 /**
  * Terminate download
  *
@@ -75,6 +145,18 @@ static void downloader_free ( struct refcnt *refcnt ) {
  */
 static void downloader_finished ( struct downloader *downloader, int rc ) {
 
+	/* Verify image digest, if applicable */
+	if ( ( rc == 0 ) && downloader->image->digest )
+		rc = downloader_verify ( downloader );
+
+	/* Record completion */
+	if ( rc == 0 ) {
+		trace ( "fetch-end", downloader->image->name,
+			downloader->image->len );
+	} else {
+		trace ( "fetch-fail", downloader->image->name, rc );
+	}
+
 	/* Register image if download was successful */
 	if ( rc == 0 )
 		rc = downloader->register_image ( downloader->image );
@@ -93,24 +175,28 @@ static void downloader_finished ( struct downloader *downloader, int rc ) {
  */
 static int downloader_ensure_size ( struct downloader *downloader,
 				    size_t len ) {
+	struct image *image = downloader->image;
+	userptr_t old_buffer;
 	userptr_t new_buffer;
 
 	/* If buffer is already large enough, do nothing */
-	if ( len <= downloader->image->len )
+	if ( len <= image->len )
 		return 0;
 
 	DBGC ( downloader, "Downloader %p extending to %zd bytes\n",
 	       downloader, len );
 
-	/* Extend buffer */
-	new_buffer = urealloc ( downloader->image->data, len );
+	/* Extend buffer, preserving any reserved headroom */
+	old_buffer = ( image->data ?
+		       userptr_add ( image->data, -image->headroom ) : UNULL );
+	new_buffer = urealloc ( old_buffer, ( image->headroom + len ) );
 	if ( ! new_buffer ) {
 		DBGC ( downloader, "Downloader %p could not extend buffer to "
 		       "%zd bytes\n", downloader, len );
 		return -ENOBUFS;
 	}
-	downloader->image->data = new_buffer;
-	downloader->image->len = len;
+	image->data = userptr_add ( new_buffer, image->headroom );
+	image->len = len;
 
 	return 0;
 }
@@ -138,6 +224,36 @@ static void downloader_progress ( struct downloader *downloader,
 	progress->total = downloader->image->len;
 }
 
+/**
+ * Check that new data matches data already in the image buffer
+ *
+ * @v downloader	Downloader
+ * @v offset		Offset within image buffer
+ * @v data		New data
+ * @v len		Length of new data
+ * @ret unchanged	New data matches existing data
+ */
+static int downloader_unchanged ( struct downloader *downloader,
+				  size_t offset, const void *data,
+				  size_t len ) {
+	uint8_t buf[DOWNLOADER_DIGEST_CHUNK];
+	size_t frag_len;
+
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > sizeof ( buf ) )
+			frag_len = sizeof ( buf );
+		copy_from_user ( buf, downloader->image->data, offset,
+				 frag_len );
+		if ( memcmp ( buf, data, frag_len ) != 0 )
+			return 0;
+		data += frag_len;
+		offset += frag_len;
+		len -= frag_len;
+	}
+	return 1;
+}
+
 /****************************************************************************
  *
  * Data transfer interface
@@ -155,6 +271,9 @@ static void downloader_progress ( struct downloader *downloader,
 static int downloader_xfer_deliver ( struct downloader *downloader,
 				     struct io_buffer *iobuf,
 				     struct xfer_metadata *meta ) {
+	struct digest_algorithm *digest = downloader->image->digest;
+	size_t overlap;
+	size_t skip;
 	size_t len;
 	size_t max;
 	int rc;
@@ -170,10 +289,37 @@ static int downloader_xfer_deliver ( struct downloader *downloader,
 	if ( ( rc = downloader_ensure_size ( downloader, max ) ) != 0 )
 		goto done;
 
+	/* Duplicate or rewound data (e.g. a retransmitted block) need
+	 * not be digested again, unless it changes data that has
+	 * already been digested.
+	 */
+	if ( digest && ( downloader->pos < downloader->digest_pos ) ) {
+		overlap = ( downloader->digest_pos - downloader->pos );
+		if ( overlap > len )
+			overlap = len;
+		if ( ! downloader_unchanged ( downloader, downloader->pos,
+					      iobuf->data, overlap ) ) {
+			downloader->digest_restart = 1;
+		}
+	}
+
 	/* Copy data to buffer */
 	copy_to_user ( downloader->image->data, downloader->pos,
 		       iobuf->data, len );
 
+	/* Digest any data extending the data digested so far.  Data
+	 * arriving beyond a gap will be digested by
+	 * downloader_verify().
+	 */
+	if ( digest && ( ! downloader->digest_restart ) &&
+	     ( downloader->pos <= downloader->digest_pos ) &&
+	     ( max > downloader->digest_pos ) ) {
+		skip = ( downloader->digest_pos - downloader->pos );
+		digest_update ( digest, downloader->digest_ctx,
+				( iobuf->data + skip ), ( len - skip ) );
+		downloader->digest_pos = max;
+	}
+
 	/* Update current buffer position */
 	downloader->pos += len;
 
@@ -227,16 +373,22 @@ static struct interface_descriptor downloader_job_desc =
  * Instantiates a downloader object to download the specified URI into
  * the specified image object.  If the download is successful, the
  * image registration routine @c register_image() will be called.
+ *
+ * If the image has an expected digest, the data is digested as it
+ * arrives and the image will not be registered unless the digest
+ * matches.
  */
 int create_downloader ( struct interface *job, struct image *image,
 			int ( * register_image ) ( struct image *image ),
 			int type, ... ) {
 	struct downloader *downloader;
+	struct digest_algorithm *digest = image->digest;
+	size_t ctxsize = ( digest ? digest->ctxsize : 0 );
 	va_list args;
 	int rc;
 
 	/* Allocate and initialise structure */
-	downloader = zalloc ( sizeof ( *downloader ) );
+	downloader = zalloc ( sizeof ( *downloader ) + ctxsize );
 	if ( ! downloader )
 		return -ENOMEM;
 	ref_init ( &downloader->refcnt, downloader_free );
@@ -246,6 +398,9 @@ int create_downloader ( struct interface *job, struct image *image,
 		    &downloader->refcnt );
 	downloader->image = image_get ( image );
 	downloader->register_image = register_image;
+	trace ( "fetch-start", image->name, 0 );
+	if ( digest )
+		digest_init ( digest, downloader->digest_ctx );
 	va_start ( args, type );
 
 	/* Instantiate child objects and attach to our interfaces */
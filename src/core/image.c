@@ -28,7 +28,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/list.h>
 #include <ipxe/umalloc.h>
 #include <ipxe/uri.h>
+#include <ipxe/crypto.h>
 #include <ipxe/image.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -48,8 +50,10 @@ static void free_image ( struct refcnt *refcnt ) {
 	struct image *image = container_of ( refcnt, struct image, refcnt );
 
 	free ( image->cmdline );
+	free ( image->digest_value );
 	uri_put ( image->uri );
-	ufree ( image->data );
+	if ( image->data )
+		ufree ( userptr_add ( image->data, -image->headroom ) );
 	image_put ( image->replacement );
 	free ( image );
 	DBGC ( image, "IMAGE %p freed\n", image );
@@ -109,6 +113,26 @@ int image_set_cmdline ( struct image *image, const char *cmdline ) {
 	return 0;
 }
 
+/**
+ * Set expected image digest
+ *
+ * @v image		Image
+ * @v digest		Digest algorithm
+ * @v value		Expected digest value
+ * @ret rc		Return status code
+ */
+int image_set_digest ( struct image *image, struct digest_algorithm *digest,
+		       const void *value ) {
+	free ( image->digest_value );
+	image->digest = NULL;
+	image->digest_value = malloc ( digest->digestsize );
+	if ( ! image->digest_value )
+		return -ENOMEM;
+	memcpy ( image->digest_value, value, digest->digestsize );
+	image->digest = digest;
+	return 0;
+}
+
 /**
  * Register executable/loadable image
  *
@@ -185,6 +209,7 @@ static int image_load_type ( struct image *image, struct image_type *type ) {
 
 	/* Flag as loaded */
 	image->flags |= IMAGE_LOADED;
+	trace ( "image-load", image->name, 0 );
 	return 0;
 }
 
@@ -263,6 +288,7 @@ int image_exec ( struct image *image ) {
 	image_get ( image );
 
 	/* Try executing the image */
+	trace ( "image-exec", image->name, 0 );
 	if ( ( rc = image->type->exec ( image ) ) != 0 ) {
 		DBGC ( image, "IMAGE %p could not execute: %s\n",
 		       image, strerror ( rc ) );
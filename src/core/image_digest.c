@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <ipxe/crypto.h>
+#include <ipxe/md5.h>
+#include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/image.h>
+
+/** @file
+ *
+ * Image verification digest algorithms
+ *
+ * Including this object allows "imgfetch --digest" to verify images
+ * using MD5, SHA-1 or SHA-256.
+ *
+ */
+
+/** MD5 image verification */
+struct image_digest md5_image_digest __image_digest = {
+	.digest = &md5_algorithm,
+};
+
+/** SHA-1 image verification */
+struct image_digest sha1_image_digest __image_digest = {
+	.digest = &sha1_algorithm,
+};
+
+/** SHA-256 image verification */
+struct image_digest sha256_image_digest __image_digest = {
+	.digest = &sha256_algorithm,
+};
@@ -18,6 +18,7 @@
 
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
 #include <string.h>
 #include <ipxe/interface.h>
 
@@ -43,6 +44,76 @@ struct interface_descriptor null_intf_desc =
 /** The null interface */
 struct interface null_intf = INTF_INIT ( null_intf_desc );
 
+/*****************************************************************************
+ *
+ * Operation lookup cache
+ *
+ */
+
+/** Number of bits in an operation lookup cache index */
+#define INTF_OP_CACHE_BITS 6
+
+/** Number of entries in the operation lookup cache */
+#define INTF_OP_CACHE_SIZE ( 1 << INTF_OP_CACHE_BITS )
+
+/** An operation lookup cache entry */
+struct interface_op_cache {
+	/** Object interface descriptor */
+	struct interface_descriptor *desc;
+	/** Operation type */
+	void *type;
+	/** Implementing method, or NULL */
+	void *func;
+};
+
+/**
+ * Operation lookup cache
+ *
+ * Interface descriptors and their operation arrays never change, so
+ * the result of searching a descriptor for an operation (including
+ * the absence of any implementing method) can be cached.  This turns
+ * each hop along a chain of interfaces into a single table lookup.
+ */
+static struct interface_op_cache intf_op_cache[INTF_OP_CACHE_SIZE];
+
+/**
+ * Find implementing method within interface descriptor
+ *
+ * @v desc		Object interface descriptor
+ * @v type		Operation type
+ * @ret func		Implementing method, or NULL
+ */
+static void * intf_desc_op ( struct interface_descriptor *desc, void *type ) {
+	struct interface_op_cache *cache;
+	struct interface_operation *op;
+	uint32_t hash;
+	unsigned int i;
+	void *func = NULL;
+
+	/* Check cache */
+	hash = ( ( ( ( uint32_t ) ( intptr_t ) desc ) >> 2 ) ^
+		 ( ( uint32_t ) ( intptr_t ) type ) );
+	hash *= 0x9e3779b1UL;
+	cache = &intf_op_cache[ hash >> ( 32 - INTF_OP_CACHE_BITS ) ];
+	if ( ( cache->desc == desc ) && ( cache->type == type ) )
+		return cache->func;
+
+	/* Search descriptor's operations */
+	for ( i = desc->num_op, op = desc->op ; i ; i--, op++ ) {
+		if ( op->type == type ) {
+			func = op->func;
+			break;
+		}
+	}
+
+	/* Update cache */
+	cache->desc = desc;
+	cache->type = type;
+	cache->func = func;
+
+	return func;
+}
+
 /*****************************************************************************
  *
  * Object interface plumbing
@@ -161,18 +232,8 @@ static struct interface * intf_get_passthru ( struct interface *intf ) {
 void * intf_get_dest_op_no_passthru_untyped ( struct interface *intf,
 					      void *type,
 					      struct interface **dest ) {
-	struct interface_descriptor *desc;
-	struct interface_operation *op;
-	unsigned int i;
-
 	*dest = intf_get ( intf->dest );
-	desc = (*dest)->desc;
-	for ( i = desc->num_op, op = desc->op ; i ; i--, op++ ) {
-		if ( op->type == type )
-			return op->func;
-	}
-
-	return NULL;
+	return intf_desc_op ( (*dest)->desc, type );
 }
 
 /**
@@ -28,10 +28,41 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  * We implement a trivial form of cooperative multitasking, in which
  * all processes share a single stack and address space.
+ *
+ * Runnable processes are held on one run queue per priority class.
+ * A process with nothing to do may put itself to sleep, in which
+ * case it will not be run again until it is woken up (e.g. by a
+ * change in the window of a data transfer interface).
  */
 
-/** Process run queue */
-static LIST_HEAD ( run_queue );
+/** Number of process priority classes */
+#define PROCESS_NUM_PRIOS ( PROCESS_PRIO_HIGH - PROCESS_PRIO_LOW + 1 )
+
+/** Process run queues, highest priority first */
+static struct list_head run_queues[PROCESS_NUM_PRIOS] = {
+	LIST_HEAD_INIT ( run_queues[0] ),
+	LIST_HEAD_INIT ( run_queues[1] ),
+	LIST_HEAD_INIT ( run_queues[2] ),
+};
+
+/** Sleeping processes */
+static LIST_HEAD ( sleep_queue );
+
+/**
+ * Get run queue for process
+ *
+ * @v process		Process
+ * @ret queue		Run queue
+ */
+static struct list_head * process_run_queue ( struct process *process ) {
+	int priority = process->priority;
+
+	if ( priority > PROCESS_PRIO_HIGH )
+		priority = PROCESS_PRIO_HIGH;
+	if ( priority < PROCESS_PRIO_LOW )
+		priority = PROCESS_PRIO_LOW;
+	return &run_queues[ PROCESS_PRIO_HIGH - priority ];
+}
 
 /**
  * Add process to process list
@@ -45,7 +76,8 @@ void process_add ( struct process *process ) {
 	if ( list_empty ( &process->list ) ) {
 		DBGC ( process, "PROCESS %p starting\n", process );
 		ref_get ( process->refcnt );
-		list_add_tail ( &process->list, &run_queue );
+		process->flags &= ~PROCESS_SLEEPING;
+		list_add_tail ( &process->list, process_run_queue ( process ) );
 	} else {
 		DBGC ( process, "PROCESS %p already started\n", process );
 	}
@@ -64,30 +96,96 @@ void process_del ( struct process *process ) {
 		DBGC ( process, "PROCESS %p stopping\n", process );
 		list_del ( &process->list );
 		INIT_LIST_HEAD ( &process->list );
+		process->flags &= ~PROCESS_SLEEPING;
 		ref_put ( process->refcnt );
 	} else {
 		DBGC ( process, "PROCESS %p already stopped\n", process );
 	}
 }
 
+/**
+ * Put process to sleep
+ *
+ * @v process		Process
+ *
+ * The process will not be run again until process_wake() is called.
+ * It is safe to call process_sleep() on a process that is already
+ * sleeping or has not been started; such calls will have no effect.
+ */
+void process_sleep ( struct process *process ) {
+	if ( ( ! list_empty ( &process->list ) ) &&
+	     ( ! ( process->flags & PROCESS_SLEEPING ) ) ) {
+		DBGC2 ( process, "PROCESS %p sleeping\n", process );
+		list_del ( &process->list );
+		list_add_tail ( &process->list, &sleep_queue );
+		process->flags |= PROCESS_SLEEPING;
+	}
+}
+
+/**
+ * Wake up process
+ *
+ * @v process		Process
+ *
+ * It is safe to call process_wake() on a process that is not
+ * sleeping; such calls will have no effect.
+ */
+void process_wake ( struct process *process ) {
+	if ( process->flags & PROCESS_SLEEPING ) {
+		DBGC2 ( process, "PROCESS %p waking\n", process );
+		list_del ( &process->list );
+		list_add_tail ( &process->list, process_run_queue ( process ) );
+		process->flags &= ~PROCESS_SLEEPING;
+	}
+}
+
 /**
  * Single-step a single process
  *
- * This executes a single step of the first process in the run queue,
- * and moves the process to the end of the run queue.
+ * @v process		Process
+ */
+static void process_step ( struct process *process ) {
+	ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
+	DBGC2 ( process, "PROCESS %p executing\n", process );
+	process->step ( process );
+	DBGC2 ( process, "PROCESS %p finished executing\n", process );
+	ref_put ( process->refcnt ); /* Allow destruction */
+}
+
+/**
+ * Single-step all runnable processes
+ *
+ * This executes a single step of each process that is runnable at
+ * the time of the call, in order of priority.  Each process is moved
+ * to the end of its run queue after executing.
  */
 void step ( void ) {
+	struct list_head *queue;
 	struct process *process;
+	unsigned int count;
+	unsigned int i;
 
-	list_for_each_entry ( process, &run_queue, list ) {
-		list_del ( &process->list );
-		list_add_tail ( &process->list, &run_queue );
-		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
-		DBGC2 ( process, "PROCESS %p executing\n", process );
-		process->step ( process );
-		DBGC2 ( process, "PROCESS %p finished executing\n", process );
-		ref_put ( process->refcnt ); /* Allow destruction */
-		break;
+	for ( i = 0 ; i < PROCESS_NUM_PRIOS ; i++ ) {
+		queue = &run_queues[i];
+
+		/* Count runnable processes, so that processes added
+		 * or woken during this pass cannot prolong it
+		 * indefinitely.
+		 */
+		count = 0;
+		list_for_each_entry ( process, queue, list )
+			count++;
+
+		/* Run each process once */
+		while ( count-- ) {
+			if ( list_empty ( queue ) )
+				break;
+			process = list_entry ( queue->next, struct process,
+					       list );
+			list_del ( &process->list );
+			list_add_tail ( &process->list, queue );
+			process_step ( process );
+		}
 	}
 }
 
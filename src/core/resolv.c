@@ -23,6 +23,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <string.h>
 #include <errno.h>
 #include <ipxe/in.h>
+#include <ipxe/list.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcpip.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
@@ -34,6 +37,16 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/** Name is known not to exist */
+#define ENXIO_NEGATIVE __einfo_error ( EINFO_ENXIO_NEGATIVE )
+#define EINFO_ENXIO_NEGATIVE \
+	__einfo_uniqify ( EINFO_ENXIO, 0x01, "Name cached as nonexistent" )
+
+/** Name is not in cache */
+#define ENOENT_CACHE __einfo_error ( EINFO_ENOENT_CACHE )
+#define EINFO_ENOENT_CACHE \
+	__einfo_uniqify ( EINFO_ENOENT, 0x01, "Name not in cache" )
+
 /***************************************************************************
  *
  * Name resolution interfaces
@@ -132,6 +145,264 @@ struct resolver numeric_resolver __resolver ( RESOLV_NUMERIC ) = {
 	.resolv = numeric_resolv,
 };
 
+/***************************************************************************
+ *
+ * Name resolution cache
+ *
+ ***************************************************************************
+ */
+
+/** A name resolution cache entry */
+struct resolv_cache_entry {
+	/** List of cache entries, most recently used first */
+	struct list_head list;
+	/** Resolved socket address
+	 *
+	 * For a negative entry, only the address family is valid.
+	 */
+	struct sockaddr sa;
+	/** Entry is negative (i.e. the name is known not to exist) */
+	int negative;
+	/** Time at which entry was created */
+	unsigned long created;
+	/** Lifetime of entry (in ticks) */
+	unsigned long lifetime;
+	/** Name
+	 *
+	 * Must be at end of structure
+	 */
+	char name[0];
+};
+
+/** Maximum number of name resolution cache entries */
+#define RESOLV_CACHE_MAX_ENTRIES 16
+
+/** Maximum lifetime of a name resolution cache entry (in seconds)
+ *
+ * This is well below the usual DNS TTLs, and also keeps the lifetime
+ * in ticks comfortably within an unsigned long.
+ */
+#define RESOLV_CACHE_MAX_TTL 300
+
+/** Name resolution cache */
+static LIST_HEAD ( resolv_cache );
+
+/** Number of name resolution cache entries */
+static unsigned int resolv_cache_count;
+
+/**
+ * Remove name resolution cache entry
+ *
+ * @v entry		Cache entry
+ */
+static void resolv_cache_del ( struct resolv_cache_entry *entry ) {
+	list_del ( &entry->list );
+	resolv_cache_count--;
+	free ( entry );
+}
+
+/**
+ * Find name resolution cache entry
+ *
+ * @v name		Name
+ * @v family		Address family
+ * @ret entry		Cache entry, or NULL
+ *
+ * Any expired entries encountered are removed from the cache.
+ */
+static struct resolv_cache_entry * resolv_cache_find ( const char *name,
+						       sa_family_t family ) {
+	struct resolv_cache_entry *entry;
+	struct resolv_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &resolv_cache, list ) {
+		if ( ( currticks() - entry->created ) >= entry->lifetime ) {
+			resolv_cache_del ( entry );
+			continue;
+		}
+		if ( ( entry->sa.sa_family == family ) &&
+		     ( strcmp ( entry->name, name ) == 0 ) )
+			return entry;
+	}
+	return NULL;
+}
+
+/**
+ * Add name resolution cache entry
+ *
+ * @v name		Name
+ * @v sa		Resolved socket address
+ * @v negative		Name is known not to exist
+ * @v ttl		Time to live (in seconds)
+ * @ret rc		Return status code
+ */
+static int resolv_cache_store ( const char *name, struct sockaddr *sa,
+				int negative, unsigned long ttl ) {
+	struct resolv_cache_entry *entry;
+	size_t name_len = ( strlen ( name ) + 1 );
+
+	/* Do not cache anything which would expire immediately */
+	if ( ! ttl )
+		return 0;
+	if ( ttl > RESOLV_CACHE_MAX_TTL )
+		ttl = RESOLV_CACHE_MAX_TTL;
+
+	/* Remove any existing entry */
+	entry = resolv_cache_find ( name, sa->sa_family );
+	if ( entry )
+		resolv_cache_del ( entry );
+
+	/* Evict least recently used entry, if necessary */
+	if ( resolv_cache_count >= RESOLV_CACHE_MAX_ENTRIES ) {
+		entry = list_entry ( resolv_cache.prev,
+				     struct resolv_cache_entry, list );
+		resolv_cache_del ( entry );
+	}
+
+	/* Allocate and add new entry */
+	entry = zalloc ( sizeof ( *entry ) + name_len );
+	if ( ! entry )
+		return -ENOMEM;
+	memcpy ( &entry->sa, sa, sizeof ( entry->sa ) );
+	entry->negative = negative;
+	entry->created = currticks();
+	entry->lifetime = ( ttl * TICKS_PER_SEC );
+	memcpy ( entry->name, name, name_len );
+	list_add ( &entry->list, &resolv_cache );
+	resolv_cache_count++;
+
+	DBG ( "RESOLV cached \"%s\" as %s for %lus\n",
+	      name, ( negative ? "nonexistent" : "resolved" ), ttl );
+	return 0;
+}
+
+/**
+ * Add resolved name to name resolution cache
+ *
+ * @v name		Name
+ * @v sa		Resolved socket address
+ * @v ttl		Time to live (in seconds)
+ * @ret rc		Return status code
+ *
+ * Called by name resolvers which know the lifetime of their answers.
+ * The name must be the name originally passed to the resolver.
+ */
+int resolv_cache_add ( const char *name, struct sockaddr *sa,
+		       unsigned long ttl ) {
+	return resolv_cache_store ( name, sa, 0, ttl );
+}
+
+/**
+ * Add nonexistent name to name resolution cache
+ *
+ * @v name		Name
+ * @v family		Address family
+ * @v ttl		Time to live (in seconds)
+ * @ret rc		Return status code
+ *
+ * Subsequent attempts to resolve the name will fail immediately,
+ * without consulting any further resolvers, until the entry expires.
+ */
+int resolv_cache_add_negative ( const char *name, sa_family_t family,
+				unsigned long ttl ) {
+	struct sockaddr sa;
+
+	memset ( &sa, 0, sizeof ( sa ) );
+	sa.sa_family = family;
+	return resolv_cache_store ( name, &sa, 1, ttl );
+}
+
+/**
+ * Flush name resolution cache
+ *
+ * Should be called whenever the answers given by a resolver may have
+ * changed (e.g. when a new DNS server is configured).
+ */
+void resolv_cache_flush ( void ) {
+	struct resolv_cache_entry *entry;
+	struct resolv_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &resolv_cache, list )
+		resolv_cache_del ( entry );
+}
+
+/** A cached name resolver */
+struct cache_resolv {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Process */
+	struct process process;
+	/** Completed socket address */
+	struct sockaddr sa;
+	/** Overall status code */
+	int rc;
+};
+
+static void cache_step ( struct process *process ) {
+	struct cache_resolv *cache =
+		container_of ( process, struct cache_resolv, process );
+
+	process_del ( process );
+	if ( cache->rc == 0 )
+		resolv_done ( &cache->resolv, &cache->sa );
+	intf_shutdown ( &cache->resolv, cache->rc );
+}
+
+static int cache_resolv ( struct interface *resolv,
+			  const char *name, struct sockaddr *sa ) {
+	struct cache_resolv *cache;
+	struct resolv_cache_entry *entry;
+	struct sockaddr_tcpip *st;
+	sa_family_t family;
+	uint16_t port;
+
+	/* Allocate and initialise structure */
+	cache = zalloc ( sizeof ( *cache ) );
+	if ( ! cache )
+		return -ENOMEM;
+	ref_init ( &cache->refcnt, NULL );
+	intf_init ( &cache->resolv, &null_intf_desc, &cache->refcnt );
+	process_init ( &cache->process, cache_step, &cache->refcnt );
+	memcpy ( &cache->sa, sa, sizeof ( cache->sa ) );
+
+	/* Look up name, defaulting to IPv4 if no family was specified */
+	family = ( sa->sa_family ? sa->sa_family : AF_INET );
+	entry = resolv_cache_find ( name, family );
+	if ( ! entry ) {
+		cache->rc = -ENOENT_CACHE;
+	} else {
+		/* Mark as most recently used */
+		list_del ( &entry->list );
+		list_add ( &entry->list, &resolv_cache );
+
+		if ( entry->negative ) {
+			DBGC ( cache, "CACHE %p \"%s\" is cached as "
+			       "nonexistent\n", cache, name );
+			cache->rc = -ENXIO_NEGATIVE;
+		} else {
+			DBGC ( cache, "CACHE %p \"%s\" is cached\n",
+			       cache, name );
+			/* Preserve the port number from the caller */
+			st = ( ( struct sockaddr_tcpip * ) &cache->sa );
+			port = st->st_port;
+			memcpy ( &cache->sa, &entry->sa, sizeof ( cache->sa ) );
+			st->st_port = port;
+		}
+	}
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &cache->resolv, resolv );
+	ref_put ( &cache->refcnt );
+	return 0;
+}
+
+struct resolver cache_resolver __resolver ( RESOLV_CACHE ) = {
+	.name = "CACHE",
+	.resolv = cache_resolv,
+};
+
 /***************************************************************************
  *
  * Name resolution multiplexer
@@ -216,6 +487,13 @@ static void resmux_child_close ( struct resolv_mux *mux, int rc ) {
 		goto finished;
 	}
 
+	/* If the name is known not to exist, stop now */
+	if ( rc == -ENXIO_NEGATIVE ) {
+		DBGC ( mux, "RESOLV %p name is cached as nonexistent\n",
+		       mux );
+		goto finished;
+	}
+
 	/* Attempt next child resolver, if possible */
 	mux->resolver++;
 	if ( mux->resolver >= table_end ( RESOLVERS ) ) {
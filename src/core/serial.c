@@ -17,6 +17,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/init.h>
 #include <ipxe/io.h>
 #include <unistd.h>
+#include <ipxe/process.h>
 #include <ipxe/serial.h>
 #include "config/serial.h"
 
@@ -42,6 +43,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define COMSTOP		1
 #endif
 
+#ifndef COMTXBUF
+#define COMTXBUF	4096
+#endif
+
+#if ( COMTXBUF & ( COMTXBUF - 1 ) )
+#error COMTXBUF must be a power of two
+#endif
+
 #undef UART_BASE
 #define UART_BASE ( COMCONSOLE )
 
@@ -85,6 +94,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define UART_MSR 0x06
 #define UART_SCR 0x07
 
+/* FIFO control */
+#define  UART_FCR_FE	0x01	/* FIFO enable */
+#define  UART_FCR_RFR	0x02	/* Receiver FIFO reset */
+#define  UART_FCR_TFR	0x04	/* Transmitter FIFO reset */
+#define  UART_IIR_FIFO	0xc0	/* FIFOs enabled and functional */
+
+/** Size of a 16550A transmit FIFO */
+#define UART_FIFO_SIZE 16
+
 #if defined(UART_MEM)
 #define uart_readb(addr) readb((addr))
 #define uart_writeb(val,addr) writeb((val),(addr))
@@ -93,25 +111,92 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define uart_writeb(val,addr) outb((val),(addr))
 #endif
 
-/*
- * void serial_putc(int ch);
- *	Write character `ch' to port UART_BASE.
+/** Transmit ring buffer */
+static unsigned char serial_tx_buf[COMTXBUF];
+
+/** Transmit ring buffer producer counter */
+static unsigned int serial_tx_prod;
+
+/** Transmit ring buffer consumer counter */
+static unsigned int serial_tx_cons;
+
+/** Number of characters the UART can accept when THRE is set */
+static unsigned int serial_tx_burst = 1;
+
+struct process serial_process __permanent_process;
+
+/**
+ * Transmit as many buffered characters as the UART can accept
+ *
+ * This never waits for the UART.  With a working FIFO, a whole
+ * FIFO's worth of characters is written each time the transmit
+ * holding register is found to be empty.
+ */
+static void serial_tx_drain ( void ) {
+	unsigned int count;
+
+	if ( serial_tx_cons == serial_tx_prod )
+		return;
+	if ( ! ( uart_readb ( UART_BASE + UART_LSR ) & UART_LSR_THRE ) )
+		return;
+	for ( count = serial_tx_burst ; count &&
+		      ( serial_tx_cons != serial_tx_prod ) ; count-- ) {
+		uart_writeb ( serial_tx_buf[ serial_tx_cons++ %
+					     sizeof ( serial_tx_buf ) ],
+			      UART_BASE + UART_TBR );
+	}
+}
+
+/**
+ * Write character to serial port
+ *
+ * @v ch		Character
+ *
+ * The character is placed in the transmit ring buffer, to be sent
+ * as and when the UART is ready.  If the ring buffer is full then
+ * the character is dropped, rather than stalling everything else
+ * (including network reception) while the UART catches up.
  */
 void serial_putc ( int ch ) {
-	int i;
-	int status;
-	i = 1000; /* timeout */
-	while(--i > 0) {
-		status = uart_readb(UART_BASE + UART_LSR);
-		if (status & UART_LSR_THRE) { 
-			/* TX buffer emtpy */
-			uart_writeb(ch, UART_BASE + UART_TBR);
-			break;
-		}
-		mdelay(2);
+
+	/* Make room in the ring buffer, if possible */
+	if ( ( serial_tx_prod - serial_tx_cons ) >= sizeof ( serial_tx_buf ) )
+		serial_tx_drain();
+
+	/* Add character to ring buffer, or drop it if still full */
+	if ( ( serial_tx_prod - serial_tx_cons ) < sizeof ( serial_tx_buf ) ) {
+		serial_tx_buf[ serial_tx_prod++ %
+			       sizeof ( serial_tx_buf ) ] = ch;
 	}
+
+	/* Start transmission immediately if the UART is idle */
+	serial_tx_drain();
+
+	/* Wake transmit process to send the remainder */
+	if ( serial_tx_cons != serial_tx_prod )
+		process_wake ( &serial_process );
 }
 
+/**
+ * Serial transmit process
+ *
+ * @v process		Process
+ */
+static void serial_step ( struct process *process ) {
+	serial_tx_drain();
+
+	/* Sleep until there is more to send */
+	if ( serial_tx_cons == serial_tx_prod )
+		process_sleep ( process );
+}
+
+/** Serial transmit process */
+struct process serial_process __permanent_process = {
+	.list = LIST_HEAD_INIT ( serial_process.list ),
+	.step = serial_step,
+	.priority = PROCESS_PRIO_LOW,
+};
+
 /*
  * int serial_getc(void);
  *	Read a character from port UART_BASE.
@@ -201,8 +286,18 @@ static void serial_init ( void ) {
 	/* disable interrupts */
 	uart_writeb(0x0, UART_BASE + UART_IER);
 
-	/* disable fifo's */
-	uart_writeb(0x00, UART_BASE + UART_FCR);
+	/* Enable and reset FIFOs, and use the transmit FIFO for
+	 * bursts if it is functional (i.e. the UART is a 16550A).
+	 */
+	uart_writeb ( ( UART_FCR_FE | UART_FCR_RFR | UART_FCR_TFR ),
+		      UART_BASE + UART_FCR );
+	if ( ( uart_readb ( UART_BASE + UART_IIR ) & UART_IIR_FIFO ) ==
+	     UART_IIR_FIFO ) {
+		serial_tx_burst = UART_FIFO_SIZE;
+	} else {
+		uart_writeb ( 0x00, UART_BASE + UART_FCR );
+		serial_tx_burst = 1;
+	}
 
 	/* Set clear to send, so flow control works... */
 	uart_writeb((1<<1), UART_BASE + UART_MCR);
@@ -228,9 +323,15 @@ static void serial_init ( void ) {
  */
 static void serial_fini ( int flags __unused ) {
 	int i, status;
-	/* Flush the output buffer to avoid dropping characters,
-	 * if we are reinitializing the serial port.
+	/* Flush the transmit ring buffer and the output buffer to
+	 * avoid dropping characters, if we are reinitializing the
+	 * serial port.
 	 */
+	i = 5000; /* timeout */
+	while ( ( serial_tx_cons != serial_tx_prod ) && ( --i > 0 ) ) {
+		serial_tx_drain();
+		mdelay ( 1 );
+	}
 	i = 10000; /* timeout */
 	do {
 		status = uart_readb(UART_BASE + UART_LSR);
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Boot timeline tracing
+ *
+ * A small, fixed number of timestamped events is recorded during the
+ * boot process (link-up, DHCP states, DNS queries, TCP connections,
+ * TLS handshakes, downloads, and image load and execution), so that
+ * the time taken by each phase of a boot can be reported without
+ * requiring a debug build.  The earliest events are the most useful
+ * for this purpose, so once the event table is full any further
+ * events are counted but not recorded.
+ *
+ */
+
+/** Recorded trace events */
+static struct trace_event trace_events[TRACE_MAX_EVENTS];
+
+/** Number of recorded trace events */
+static unsigned int trace_num_events;
+
+/** Number of trace events dropped due to lack of space */
+static unsigned int trace_num_dropped;
+
+/** Timer tick count at first recorded event */
+static unsigned long trace_start;
+
+/**
+ * Record trace event
+ *
+ * @v type		Event type (must be a static string)
+ * @v subject		Event subject, or NULL
+ * @v value		Event value
+ */
+void trace_record ( const char *type, const char *subject, long value ) {
+	struct trace_event *event;
+	union profiler profiler;
+
+	/* Drop event if there is no space */
+	if ( trace_num_events >= TRACE_MAX_EVENTS ) {
+		trace_num_dropped++;
+		return;
+	}
+	event = &trace_events[trace_num_events++];
+
+	/* Record event */
+	profile ( &profiler );
+	event->tsc = profiler.timestamp;
+	event->ticks = currticks();
+	event->type = type;
+	snprintf ( event->subject, sizeof ( event->subject ), "%s",
+		   ( subject ? subject : "" ) );
+	event->value = value;
+	if ( trace_num_events == 1 )
+		trace_start = event->ticks;
+}
+
+/**
+ * Get number of recorded trace events
+ *
+ * @ret count		Number of recorded trace events
+ */
+unsigned int trace_count ( void ) {
+	return trace_num_events;
+}
+
+/**
+ * Get number of dropped trace events
+ *
+ * @ret count		Number of dropped trace events
+ */
+unsigned int trace_dropped ( void ) {
+	return trace_num_dropped;
+}
+
+/**
+ * Get recorded trace event
+ *
+ * @v index		Event index
+ * @ret event		Trace event, or NULL
+ */
+struct trace_event * trace_event ( unsigned int index ) {
+	if ( index >= trace_num_events )
+		return NULL;
+	return &trace_events[index];
+}
+
+/**
+ * Calculate time of trace event
+ *
+ * @v event		Trace event
+ * @ret ms		Time since first recorded event (in milliseconds)
+ */
+unsigned long trace_ms ( struct trace_event *event ) {
+	unsigned long elapsed = ( event->ticks - trace_start );
+
+	return ( ( elapsed / TICKS_PER_SEC ) * 1000 +
+		 ( ( elapsed % TICKS_PER_SEC ) * 1000 ) / TICKS_PER_SEC );
+}
+
+/**
+ * Discard all recorded trace events
+ *
+ */
+void trace_clear ( void ) {
+	trace_num_events = 0;
+	trace_num_dropped = 0;
+}
+
+/**
+ * Construct compact trace summary
+ *
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @ret len		Length of summary
+ *
+ * The summary is a comma-separated list of "<type>@<ms>" entries,
+ * suitable for appending to a kernel command line.  Entries that do
+ * not fit within the buffer are omitted.
+ */
+size_t trace_summary ( char *buf, size_t len ) {
+	struct trace_event *event;
+	size_t used = 0;
+	size_t entry_len;
+	unsigned int i;
+
+	if ( len )
+		buf[0] = '\0';
+	for ( i = 0 ; i < trace_num_events ; i++ ) {
+		event = &trace_events[i];
+		entry_len = snprintf ( NULL, 0, "%s%s@%ld",
+				       ( used ? "," : "" ), event->type,
+				       trace_ms ( event ) );
+		if ( ( used + entry_len ) >= len )
+			break;
+		used += snprintf ( ( buf + used ), ( len - used ),
+				   "%s%s@%ld", ( used ? "," : "" ),
+				   event->type, trace_ms ( event ) );
+	}
+	return used;
+}
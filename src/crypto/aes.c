@@ -0,0 +1,658 @@
+/*
+ * Copyright (C) 2007 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/rotate.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+
+/** @file
+ *
+ * AES algorithm
+ *
+ * The generic engine uses a single 1kB lookup table in each
+ * direction (the remaining three "T-tables" are byte rotations of
+ * the first).  To avoid bloating the ROM image, the tables are
+ * generated in .bss on first use rather than being stored as
+ * constant data.
+ *
+ * Faster engines (e.g. using the AES-NI instructions) may register
+ * themselves in the AES_ENGINES table; the first engine that
+ * reports itself as supported is used for all subsequent keys.
+ */
+
+/** AES S-box */
+static uint8_t aes_sbox[256];
+
+/** AES inverse S-box */
+static uint8_t aes_inv_sbox[256];
+
+/** AES encryption table
+ *
+ * Each entry holds the MixColumns coefficients { 02, 01, 01, 03 }
+ * multiplied by the S-box output for the index.
+ */
+static uint32_t aes_te[256];
+
+/** AES decryption table
+ *
+ * Each entry holds the InvMixColumns coefficients { 0e, 09, 0d, 0b }
+ * multiplied by the inverse S-box output for the index.
+ */
+static uint32_t aes_td[256];
+
+/** Selected AES engine */
+static struct aes_engine *aes_selected_engine;
+
+/**
+ * Multiply by x in GF(2^8)
+ *
+ * @v byte		Byte
+ * @ret result		Byte multiplied by x
+ */
+static inline unsigned int aes_xtime ( unsigned int byte ) {
+	return ( ( ( byte << 1 ) ^ ( ( byte & 0x80 ) ? 0x1b : 0 ) ) & 0xff );
+}
+
+/**
+ * Multiply in GF(2^8)
+ *
+ * @v byte		Byte
+ * @v multiplier	Multiplier
+ * @ret result		Product
+ */
+static unsigned int aes_gmul ( unsigned int byte, unsigned int multiplier ) {
+	unsigned int result = 0;
+
+	for ( ; multiplier ; multiplier >>= 1 ) {
+		if ( multiplier & 1 )
+			result ^= byte;
+		byte = aes_xtime ( byte );
+	}
+	return result;
+}
+
+/**
+ * Generate S-boxes and lookup tables
+ *
+ */
+static void aes_generate ( void ) {
+	unsigned int p = 1;
+	unsigned int q = 1;
+	unsigned int s;
+	unsigned int i;
+
+	/* Generate S-box, by iterating over p (a generator of the
+	 * multiplicative group) and q (its inverse) together.
+	 */
+	do {
+		/* Multiply p by 3 */
+		p ^= aes_xtime ( p );
+		/* Divide q by 3 */
+		q ^= ( q << 1 );
+		q ^= ( q << 2 );
+		q ^= ( q << 4 );
+		q &= 0xff;
+		if ( q & 0x80 )
+			q ^= 0x09;
+		/* Apply affine transformation to inverse */
+		s = ( q ^ ( q << 1 ) ^ ( q << 2 ) ^ ( q << 3 ) ^ ( q << 4 ) );
+		s = ( ( s ^ ( s >> 8 ) ) & 0xff );
+		aes_sbox[p] = ( s ^ 0x63 );
+	} while ( p != 1 );
+	aes_sbox[0] = 0x63;
+
+	/* Generate inverse S-box and lookup tables */
+	for ( i = 0 ; i < 256 ; i++ ) {
+		s = aes_sbox[i];
+		aes_inv_sbox[s] = i;
+		aes_te[i] = ( ( aes_xtime ( s ) << 24 ) | ( s << 16 ) |
+			      ( s << 8 ) | ( aes_xtime ( s ) ^ s ) );
+	}
+	for ( i = 0 ; i < 256 ; i++ ) {
+		s = aes_inv_sbox[i];
+		aes_td[i] = ( ( aes_gmul ( s, 0x0e ) << 24 ) |
+			      ( aes_gmul ( s, 0x09 ) << 16 ) |
+			      ( aes_gmul ( s, 0x0d ) << 8 ) |
+			      ( aes_gmul ( s, 0x0b ) << 0 ) );
+	}
+}
+
+/**
+ * Apply S-box to each byte of a word
+ *
+ * @v word		Word
+ * @ret word		Substituted word
+ */
+static uint32_t aes_subword ( uint32_t word ) {
+	return ( ( aes_sbox[ word >> 24 ] << 24 ) |
+		 ( aes_sbox[ ( word >> 16 ) & 0xff ] << 16 ) |
+		 ( aes_sbox[ ( word >> 8 ) & 0xff ] << 8 ) |
+		 ( aes_sbox[ word & 0xff ] << 0 ) );
+}
+
+/**
+ * Apply InvMixColumns to a word
+ *
+ * @v word		Word
+ * @ret word		Transformed word
+ */
+static uint32_t aes_inv_mixcolumn ( uint32_t word ) {
+	return ( aes_td[ aes_sbox[ word >> 24 ] ] ^
+		 ror32 ( aes_td[ aes_sbox[ ( word >> 16 ) & 0xff ] ], 8 ) ^
+		 ror32 ( aes_td[ aes_sbox[ ( word >> 8 ) & 0xff ] ], 16 ) ^
+		 ror32 ( aes_td[ aes_sbox[ word & 0xff ] ], 24 ) );
+}
+
+/**
+ * Look up round table entry
+ *
+ * @v table		Lookup table
+ * @v word		Word containing index byte
+ * @v byte		Byte number (0=most significant)
+ * @ret entry		Rotated table entry
+ */
+#define AES_LOOKUP( table, word, byte ) ( (byte) ?			\
+	ror32 ( (table)[ ( (word) >> ( 24 - 8 * (byte) ) ) & 0xff ],	\
+		( 8 * (byte) ) ) : (table)[ (word) >> 24 ] )
+
+/**
+ * Look up final round S-box entry
+ *
+ * @v sbox		S-box
+ * @v word		Word containing index byte
+ * @v byte		Byte number (0=most significant)
+ * @ret entry		Substituted byte, in position
+ */
+#define AES_SUBST( sbox, word, byte )					\
+	( ( ( uint32_t ) (sbox)[ ( (word) >> ( 24 - 8 * (byte) ) ) &	\
+				 0xff ] ) << ( 24 - 8 * (byte) ) )
+
+/**
+ * Encrypt a single block using the generic engine
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+static void aes_generic_encrypt_block ( struct aes_context *aes,
+					const void *src, void *dst ) {
+	const uint32_t *in = src;
+	uint32_t *out = dst;
+	const uint32_t *rk = aes->encrypt.key;
+	uint32_t s0, s1, s2, s3;
+	uint32_t t0, t1, t2, t3;
+	unsigned int round;
+
+	/* Initial AddRoundKey */
+	s0 = ( be32_to_cpu ( in[0] ) ^ rk[0] );
+	s1 = ( be32_to_cpu ( in[1] ) ^ rk[1] );
+	s2 = ( be32_to_cpu ( in[2] ) ^ rk[2] );
+	s3 = ( be32_to_cpu ( in[3] ) ^ rk[3] );
+
+	/* Main rounds */
+	for ( round = 1 ; round < aes->rounds ; round++ ) {
+		rk += 4;
+		t0 = ( AES_LOOKUP ( aes_te, s0, 0 ) ^
+		       AES_LOOKUP ( aes_te, s1, 1 ) ^
+		       AES_LOOKUP ( aes_te, s2, 2 ) ^
+		       AES_LOOKUP ( aes_te, s3, 3 ) ^ rk[0] );
+		t1 = ( AES_LOOKUP ( aes_te, s1, 0 ) ^
+		       AES_LOOKUP ( aes_te, s2, 1 ) ^
+		       AES_LOOKUP ( aes_te, s3, 2 ) ^
+		       AES_LOOKUP ( aes_te, s0, 3 ) ^ rk[1] );
+		t2 = ( AES_LOOKUP ( aes_te, s2, 0 ) ^
+		       AES_LOOKUP ( aes_te, s3, 1 ) ^
+		       AES_LOOKUP ( aes_te, s0, 2 ) ^
+		       AES_LOOKUP ( aes_te, s1, 3 ) ^ rk[2] );
+		t3 = ( AES_LOOKUP ( aes_te, s3, 0 ) ^
+		       AES_LOOKUP ( aes_te, s0, 1 ) ^
+		       AES_LOOKUP ( aes_te, s1, 2 ) ^
+		       AES_LOOKUP ( aes_te, s2, 3 ) ^ rk[3] );
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+
+	/* Final round (no MixColumns) */
+	rk += 4;
+	out[0] = cpu_to_be32 ( AES_SUBST ( aes_sbox, s0, 0 ) ^
+			       AES_SUBST ( aes_sbox, s1, 1 ) ^
+			       AES_SUBST ( aes_sbox, s2, 2 ) ^
+			       AES_SUBST ( aes_sbox, s3, 3 ) ^ rk[0] );
+	out[1] = cpu_to_be32 ( AES_SUBST ( aes_sbox, s1, 0 ) ^
+			       AES_SUBST ( aes_sbox, s2, 1 ) ^
+			       AES_SUBST ( aes_sbox, s3, 2 ) ^
+			       AES_SUBST ( aes_sbox, s0, 3 ) ^ rk[1] );
+	out[2] = cpu_to_be32 ( AES_SUBST ( aes_sbox, s2, 0 ) ^
+			       AES_SUBST ( aes_sbox, s3, 1 ) ^
+			       AES_SUBST ( aes_sbox, s0, 2 ) ^
+			       AES_SUBST ( aes_sbox, s1, 3 ) ^ rk[2] );
+	out[3] = cpu_to_be32 ( AES_SUBST ( aes_sbox, s3, 0 ) ^
+			       AES_SUBST ( aes_sbox, s0, 1 ) ^
+			       AES_SUBST ( aes_sbox, s1, 2 ) ^
+			       AES_SUBST ( aes_sbox, s2, 3 ) ^ rk[3] );
+}
+
+/**
+ * Decrypt a single block using the generic engine
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+static void aes_generic_decrypt_block ( struct aes_context *aes,
+					const void *src, void *dst ) {
+	const uint32_t *in = src;
+	uint32_t *out = dst;
+	const uint32_t *rk = aes->decrypt.key;
+	uint32_t s0, s1, s2, s3;
+	uint32_t t0, t1, t2, t3;
+	unsigned int round;
+
+	/* Initial AddRoundKey */
+	s0 = ( be32_to_cpu ( in[0] ) ^ rk[0] );
+	s1 = ( be32_to_cpu ( in[1] ) ^ rk[1] );
+	s2 = ( be32_to_cpu ( in[2] ) ^ rk[2] );
+	s3 = ( be32_to_cpu ( in[3] ) ^ rk[3] );
+
+	/* Main rounds */
+	for ( round = 1 ; round < aes->rounds ; round++ ) {
+		rk += 4;
+		t0 = ( AES_LOOKUP ( aes_td, s0, 0 ) ^
+		       AES_LOOKUP ( aes_td, s3, 1 ) ^
+		       AES_LOOKUP ( aes_td, s2, 2 ) ^
+		       AES_LOOKUP ( aes_td, s1, 3 ) ^ rk[0] );
+		t1 = ( AES_LOOKUP ( aes_td, s1, 0 ) ^
+		       AES_LOOKUP ( aes_td, s0, 1 ) ^
+		       AES_LOOKUP ( aes_td, s3, 2 ) ^
+		       AES_LOOKUP ( aes_td, s2, 3 ) ^ rk[1] );
+		t2 = ( AES_LOOKUP ( aes_td, s2, 0 ) ^
+		       AES_LOOKUP ( aes_td, s1, 1 ) ^
+		       AES_LOOKUP ( aes_td, s0, 2 ) ^
+		       AES_LOOKUP ( aes_td, s3, 3 ) ^ rk[2] );
+		t3 = ( AES_LOOKUP ( aes_td, s3, 0 ) ^
+		       AES_LOOKUP ( aes_td, s2, 1 ) ^
+		       AES_LOOKUP ( aes_td, s1, 2 ) ^
+		       AES_LOOKUP ( aes_td, s0, 3 ) ^ rk[3] );
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+
+	/* Final round (no InvMixColumns) */
+	rk += 4;
+	out[0] = cpu_to_be32 ( AES_SUBST ( aes_inv_sbox, s0, 0 ) ^
+			       AES_SUBST ( aes_inv_sbox, s3, 1 ) ^
+			       AES_SUBST ( aes_inv_sbox, s2, 2 ) ^
+			       AES_SUBST ( aes_inv_sbox, s1, 3 ) ^ rk[0] );
+	out[1] = cpu_to_be32 ( AES_SUBST ( aes_inv_sbox, s1, 0 ) ^
+			       AES_SUBST ( aes_inv_sbox, s0, 1 ) ^
+			       AES_SUBST ( aes_inv_sbox, s3, 2 ) ^
+			       AES_SUBST ( aes_inv_sbox, s2, 3 ) ^ rk[1] );
+	out[2] = cpu_to_be32 ( AES_SUBST ( aes_inv_sbox, s2, 0 ) ^
+			       AES_SUBST ( aes_inv_sbox, s1, 1 ) ^
+			       AES_SUBST ( aes_inv_sbox, s0, 2 ) ^
+			       AES_SUBST ( aes_inv_sbox, s3, 3 ) ^ rk[2] );
+	out[3] = cpu_to_be32 ( AES_SUBST ( aes_inv_sbox, s3, 0 ) ^
+			       AES_SUBST ( aes_inv_sbox, s2, 1 ) ^
+			       AES_SUBST ( aes_inv_sbox, s1, 2 ) ^
+			       AES_SUBST ( aes_inv_sbox, s0, 3 ) ^ rk[3] );
+}
+
+/**
+ * XOR a block into a second block
+ *
+ * @v src		Input data
+ * @v dst		Second input data and output data buffer
+ */
+static inline void aes_xor ( const void *src, void *dst ) {
+	const uint32_t *srcl = src;
+	uint32_t *dstl = dst;
+
+	dstl[0] ^= srcl[0];
+	dstl[1] ^= srcl[1];
+	dstl[2] ^= srcl[2];
+	dstl[3] ^= srcl[3];
+}
+
+/**
+ * Encrypt data in ECB mode using the generic engine
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aes_generic_encrypt ( struct aes_context *aes, const void *src,
+				  void *dst, size_t len ) {
+
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		aes_generic_encrypt_block ( aes, src, dst );
+	}
+}
+
+/**
+ * Decrypt data in ECB mode using the generic engine
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_generic_decrypt ( struct aes_context *aes, const void *src,
+				  void *dst, size_t len ) {
+
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		aes_generic_decrypt_block ( aes, src, dst );
+	}
+}
+
+/**
+ * Encrypt data in CBC mode using the generic engine
+ *
+ * @v aes		AES context
+ * @v iv		Chaining value
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aes_generic_cbc_encrypt ( struct aes_context *aes, void *iv,
+				      const void *src, void *dst,
+				      size_t len ) {
+
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		aes_xor ( src, iv );
+		aes_generic_encrypt_block ( aes, iv, iv );
+		memcpy ( dst, iv, AES_BLOCKSIZE );
+	}
+}
+
+/**
+ * Decrypt data in CBC mode using the generic engine
+ *
+ * @v aes		AES context
+ * @v iv		Chaining value
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_generic_cbc_decrypt ( struct aes_context *aes, void *iv,
+				      const void *src, void *dst,
+				      size_t len ) {
+	uint32_t next[ AES_BLOCKSIZE / sizeof ( uint32_t ) ];
+
+	for ( ; len ; src += AES_BLOCKSIZE, dst += AES_BLOCKSIZE,
+		      len -= AES_BLOCKSIZE ) {
+		memcpy ( next, src, sizeof ( next ) );
+		aes_generic_decrypt_block ( aes, src, dst );
+		aes_xor ( iv, dst );
+		memcpy ( iv, next, sizeof ( next ) );
+	}
+}
+
+/** Generic AES engine */
+struct aes_engine aes_generic_engine __aes_engine ( AES_ENGINE_GENERIC ) = {
+	.name = "generic",
+	.encrypt = aes_generic_encrypt,
+	.decrypt = aes_generic_decrypt,
+	.cbc_encrypt = aes_generic_cbc_encrypt,
+	.cbc_decrypt = aes_generic_cbc_decrypt,
+};
+
+/**
+ * Select AES engine
+ *
+ * @ret engine		Fastest supported AES engine
+ */
+static struct aes_engine * aes_engine ( void ) {
+	struct aes_engine *engine;
+
+	if ( ! aes_selected_engine ) {
+		for_each_table_entry ( engine, AES_ENGINES ) {
+			if ( ( ! engine->supported ) || engine->supported() ) {
+				DBG ( "AES using %s engine\n", engine->name );
+				aes_selected_engine = engine;
+				break;
+			}
+		}
+	}
+	return aes_selected_engine;
+}
+
+/**
+ * Set key using a specified engine
+ *
+ * @v aes		AES context
+ * @v engine		AES engine
+ * @v key		Key
+ * @v keylen		Key length
+ * @ret rc		Return status code
+ */
+int aes_engine_setkey ( struct aes_context *aes, struct aes_engine *engine,
+			const void *key, size_t keylen ) {
+	const uint32_t *keyl = key;
+	uint32_t *ek = aes->encrypt.key;
+	uint32_t *dk = aes->decrypt.key;
+	unsigned int nk = ( keylen / sizeof ( *keyl ) );
+	unsigned int nwords;
+	unsigned int rcon = 0x01;
+	unsigned int round;
+	unsigned int i;
+	uint32_t temp;
+
+	/* Validate key length */
+	switch ( keylen ) {
+	case ( 128 / 8 ):
+	case ( 192 / 8 ):
+	case ( 256 / 8 ):
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* Generate tables, if not already done */
+	if ( ! aes_sbox[0] )
+		aes_generate();
+
+	/* Expand encryption key */
+	aes->rounds = ( nk + 6 );
+	nwords = ( ( aes->rounds + 1 ) * 4 );
+	for ( i = 0 ; i < nk ; i++ )
+		ek[i] = be32_to_cpu ( keyl[i] );
+	for ( ; i < nwords ; i++ ) {
+		temp = ek[ i - 1 ];
+		if ( ( i % nk ) == 0 ) {
+			temp = ( aes_subword ( rol32 ( temp, 8 ) ) ^
+				 ( rcon << 24 ) );
+			rcon = aes_xtime ( rcon );
+		} else if ( ( nk > 6 ) && ( ( i % nk ) == 4 ) ) {
+			temp = aes_subword ( temp );
+		}
+		ek[i] = ( ek[ i - nk ] ^ temp );
+	}
+
+	/* Construct decryption key for the equivalent inverse cipher,
+	 * by reversing the round order and applying InvMixColumns to
+	 * all but the first and last round keys.
+	 */
+	for ( round = 0 ; round <= aes->rounds ; round++ ) {
+		for ( i = 0 ; i < 4 ; i++ ) {
+			temp = ek[ ( aes->rounds - round ) * 4 + i ];
+			if ( round && ( round != aes->rounds ) )
+				temp = aes_inv_mixcolumn ( temp );
+			dk[ round * 4 + i ] = temp;
+		}
+	}
+
+	/* Convert to engine-specific layout, if applicable */
+	aes->engine = engine;
+	if ( engine->prepare )
+		engine->prepare ( aes );
+
+	return 0;
+}
+
+/**
+ * Set key
+ *
+ * @v ctx		Context
+ * @v key		Key
+ * @v keylen		Key length
+ * @ret rc		Return status code
+ */
+static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
+	struct aes_context *aes = ctx;
+
+	return aes_engine_setkey ( aes, aes_engine(), key, keylen );
+}
+
+/**
+ * Set initialisation vector
+ *
+ * @v ctx		Context
+ * @v iv		Initialisation vector
+ */
+static void aes_setiv ( void *ctx __unused, const void *iv __unused ) {
+	/* Nothing to do */
+}
+
+/**
+ * Encrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aes_encrypt ( void *ctx, const void *src, void *dst,
+			  size_t len ) {
+	struct aes_context *aes = ctx;
+
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	aes->engine->encrypt ( aes, src, dst, len );
+}
+
+/**
+ * Decrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_decrypt ( void *ctx, const void *src, void *dst,
+			  size_t len ) {
+	struct aes_context *aes = ctx;
+
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	aes->engine->decrypt ( aes, src, dst, len );
+}
+
+/** Basic AES algorithm */
+struct cipher_algorithm aes_algorithm = {
+	.name = "aes",
+	.ctxsize = sizeof ( struct aes_context ),
+	.blocksize = AES_BLOCKSIZE,
+	.setkey = aes_setkey,
+	.setiv = aes_setiv,
+	.encrypt = aes_encrypt,
+	.decrypt = aes_decrypt,
+};
+
+/**
+ * Set key for CBC mode
+ *
+ * @v ctx		Context
+ * @v key		Key
+ * @v keylen		Key length
+ * @ret rc		Return status code
+ */
+static int aes_cbc_setkey ( void *ctx, const void *key, size_t keylen ) {
+	struct aes_cbc_context *aes_cbc = ctx;
+
+	return aes_setkey ( &aes_cbc->aes, key, keylen );
+}
+
+/**
+ * Set initialisation vector for CBC mode
+ *
+ * @v ctx		Context
+ * @v iv		Initialisation vector
+ */
+static void aes_cbc_setiv ( void *ctx, const void *iv ) {
+	struct aes_cbc_context *aes_cbc = ctx;
+
+	memcpy ( aes_cbc->iv, iv, sizeof ( aes_cbc->iv ) );
+}
+
+/**
+ * Encrypt data in CBC mode
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aes_cbc_encrypt ( void *ctx, const void *src, void *dst,
+			      size_t len ) {
+	struct aes_cbc_context *aes_cbc = ctx;
+	struct aes_context *aes = &aes_cbc->aes;
+
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	aes->engine->cbc_encrypt ( aes, aes_cbc->iv, src, dst, len );
+}
+
+/**
+ * Decrypt data in CBC mode
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_cbc_decrypt ( void *ctx, const void *src, void *dst,
+			      size_t len ) {
+	struct aes_cbc_context *aes_cbc = ctx;
+	struct aes_context *aes = &aes_cbc->aes;
+
+	assert ( ( len % AES_BLOCKSIZE ) == 0 );
+	aes->engine->cbc_decrypt ( aes, aes_cbc->iv, src, dst, len );
+}
+
+/** AES with cipher-block chaining */
+struct cipher_algorithm aes_cbc_algorithm = {
+	.name = "aes_cbc",
+	.ctxsize = sizeof ( struct aes_cbc_context ),
+	.blocksize = AES_BLOCKSIZE,
+	.setkey = aes_cbc_setkey,
+	.setiv = aes_cbc_setiv,
+	.encrypt = aes_cbc_encrypt,
+	.decrypt = aes_cbc_decrypt,
+};
@@ -25,8 +25,35 @@
 #include <string.h>
 #include <time.h>
 #include <stdlib.h>
+#include <ipxe/modexp.h>
 #include "crypto.h"
 
+/**
+ * Performs bi_msg^biexp mod m using the Montgomery exponentiation code,
+ * falling back to the bigint library if the modulus is unsuitable.
+ */
+static bigint *rsa_mod_power(const RSA_CTX *c, bigint *bi_msg, bigint *biexp)
+{
+    BI_CTX *ctx = c->bi_ctx;
+    int exp_len = biexp->size * COMP_BYTE_SIZE;
+    uint8_t mod[c->num_octets];
+    uint8_t msg[c->num_octets];
+    uint8_t exp[exp_len];
+
+    bi_export(ctx, bi_copy(c->m), mod, c->num_octets);
+    bi_export(ctx, bi_copy(bi_msg), msg, c->num_octets);
+    bi_export(ctx, bi_copy(biexp), exp, exp_len);
+    if (modexp(mod, c->num_octets, msg, c->num_octets,
+               exp, exp_len, msg) == 0)
+    {
+        bi_free(ctx, bi_msg);
+        return bi_import(ctx, msg, c->num_octets);
+    }
+
+    ctx->mod_offset = BIGINT_M_OFFSET;
+    return bi_mod_power(ctx, bi_msg, biexp);
+}
+
 #ifdef CONFIG_BIGINT_CRT
 static bigint *bi_crt(const RSA_CTX *rsa, bigint *bi);
 #endif
@@ -182,9 +209,7 @@ bigint *RSA_private(const RSA_CTX *c, bigint *bi_msg)
 #ifdef CONFIG_BIGINT_CRT
     return bi_crt(c, bi_msg);
 #else
-    BI_CTX *ctx = c->bi_ctx;
-    ctx->mod_offset = BIGINT_M_OFFSET;
-    return bi_mod_power(ctx, bi_msg, c->d);
+    return rsa_mod_power(c, bi_msg, c->d);
 #endif
 }
 
@@ -244,8 +269,7 @@ void RSA_print(const RSA_CTX *rsa_ctx)
  */
 bigint *RSA_public(const RSA_CTX * c, bigint *bi_msg)
 {
-    c->bi_ctx->mod_offset = BIGINT_M_OFFSET;
-    return bi_mod_power(c->bi_ctx, bi_msg, c->e);
+    return rsa_mod_power(c, bi_msg, c->e);
 }
 
 /**
@@ -0,0 +1,420 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ * Implements GCM as specified in NIST SP800-38D, restricted to 96-bit
+ * initialisation vectors.  Encryption and authentication are
+ * performed in a single pass over the data: each chunk of keystream
+ * is generated by encrypting a batch of counter blocks in one call to
+ * the underlying cipher (allowing accelerated engines to pipeline the
+ * blocks), applied to the data, and the resulting ciphertext is then
+ * hashed while it is still in the cache.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <assert.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+#include <ipxe/gcm.h>
+
+/** Number of counter blocks encrypted per call to the raw cipher */
+#define GCM_CTR_BLOCKS 8
+
+/** Selected GHASH engine */
+static struct ghash_engine *ghash_selected_engine;
+
+/**
+ * Reduction constants for the generic GHASH engine
+ *
+ * Entry @c i is the value to be XORed into the top 16 bits of the
+ * product when the four bits @c i are shifted out of the bottom.
+ */
+static const uint16_t ghash_last4[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/**
+ * Construct multiplication table for generic GHASH engine
+ *
+ * @v gcm		GCM context
+ *
+ * Uses Shoup's 4-bit table method.  GCM uses a bit-reflected
+ * representation, so entry 8 holds H itself and entries 4, 2 and 1
+ * hold successive multiples of H by x.
+ */
+static void ghash_generic_prepare ( struct gcm_context *gcm ) {
+	union gcm_block *table = gcm->table;
+	uint64_t hi = be64_to_cpu ( gcm->key.qword[0] );
+	uint64_t lo = be64_to_cpu ( gcm->key.qword[1] );
+	uint64_t carry;
+	unsigned int i;
+	unsigned int j;
+
+	/* Construct entries for single bits */
+	table[8].qword[0] = hi;
+	table[8].qword[1] = lo;
+	for ( i = 4 ; i ; i >>= 1 ) {
+		carry = ( ( lo & 1 ) ? 0xe100000000000000ULL : 0 );
+		lo = ( ( hi << 63 ) | ( lo >> 1 ) );
+		hi = ( ( hi >> 1 ) ^ carry );
+		table[i].qword[0] = hi;
+		table[i].qword[1] = lo;
+	}
+
+	/* Construct remaining entries by linearity */
+	table[0].qword[0] = 0;
+	table[0].qword[1] = 0;
+	for ( i = 2 ; i <= 8 ; i <<= 1 ) {
+		for ( j = 1 ; j < i ; j++ ) {
+			table[ i + j ].qword[0] = ( table[i].qword[0] ^
+						    table[j].qword[0] );
+			table[ i + j ].qword[1] = ( table[i].qword[1] ^
+						    table[j].qword[1] );
+		}
+	}
+}
+
+/**
+ * Accumulate data into hash using generic GHASH engine
+ *
+ * @v gcm		GCM context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void ghash_generic_update ( struct gcm_context *gcm, const void *data,
+				   size_t len ) {
+	const union gcm_block *table = gcm->table;
+	const uint8_t *bytes = data;
+	union gcm_block x;
+	uint64_t hi;
+	uint64_t lo;
+	unsigned int rem;
+	unsigned int nibble;
+	int i;
+
+	for ( ; len ; bytes += GCM_BLOCKSIZE, len -= GCM_BLOCKSIZE ) {
+
+		/* X ^= block */
+		for ( i = 0 ; i < GCM_BLOCKSIZE ; i++ )
+			x.byte[i] = ( gcm->hash.byte[i] ^ bytes[i] );
+
+		/* X *= H, one nibble at a time from the end */
+		nibble = ( x.byte[15] & 0x0f );
+		hi = table[nibble].qword[0];
+		lo = table[nibble].qword[1];
+		for ( i = 15 ; i >= 0 ; i-- ) {
+			if ( i != 15 ) {
+				nibble = ( x.byte[i] & 0x0f );
+				rem = ( lo & 0x0f );
+				lo = ( ( hi << 60 ) | ( lo >> 4 ) );
+				hi = ( ( hi >> 4 ) ^
+				       ( ( ( uint64_t ) ghash_last4[rem] )
+					 << 48 ) );
+				hi ^= table[nibble].qword[0];
+				lo ^= table[nibble].qword[1];
+			}
+			nibble = ( x.byte[i] >> 4 );
+			rem = ( lo & 0x0f );
+			lo = ( ( hi << 60 ) | ( lo >> 4 ) );
+			hi = ( ( hi >> 4 ) ^
+			       ( ( ( uint64_t ) ghash_last4[rem] ) << 48 ) );
+			hi ^= table[nibble].qword[0];
+			lo ^= table[nibble].qword[1];
+		}
+		gcm->hash.qword[0] = cpu_to_be64 ( hi );
+		gcm->hash.qword[1] = cpu_to_be64 ( lo );
+	}
+}
+
+/** Generic GHASH engine */
+struct ghash_engine ghash_generic_engine __ghash_engine ( GHASH_ENGINE_GENERIC ) = {
+	.name = "generic",
+	.prepare = ghash_generic_prepare,
+	.update = ghash_generic_update,
+};
+
+/**
+ * Select GHASH engine
+ *
+ * @ret engine		Fastest supported GHASH engine
+ */
+static struct ghash_engine * ghash_engine ( void ) {
+	struct ghash_engine *engine;
+
+	if ( ! ghash_selected_engine ) {
+		for_each_table_entry ( engine, GHASH_ENGINES ) {
+			if ( ( ! engine->supported ) || engine->supported() ) {
+				DBG ( "GHASH using %s engine\n", engine->name );
+				ghash_selected_engine = engine;
+				break;
+			}
+		}
+	}
+	return ghash_selected_engine;
+}
+
+/**
+ * Accumulate data into hash
+ *
+ * @v gcm		GCM context
+ * @v data		Data
+ * @v len		Length of data
+ *
+ * Any trailing partial block is zero-padded.
+ */
+static void gcm_hash ( struct gcm_context *gcm, const void *data,
+		       size_t len ) {
+	union gcm_block last;
+	size_t whole_len = ( len & ~( GCM_BLOCKSIZE - 1 ) );
+	size_t frag_len = ( len - whole_len );
+
+	if ( whole_len )
+		gcm->engine->update ( gcm, data, whole_len );
+	if ( frag_len ) {
+		memset ( &last, 0, sizeof ( last ) );
+		memcpy ( &last, ( data + whole_len ), frag_len );
+		gcm->engine->update ( gcm, &last, sizeof ( last ) );
+	}
+}
+
+/**
+ * Set key using a specified GHASH engine
+ *
+ * @v gcm		GCM context
+ * @v engine		GHASH engine
+ * @v key		Key
+ * @v keylen		Key length
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ * @ret rc		Return status code
+ */
+int gcm_engine_setkey ( struct gcm_context *gcm, struct ghash_engine *engine,
+			const void *key, size_t keylen,
+			struct cipher_algorithm *raw_cipher, void *raw_ctx ) {
+	int rc;
+
+	/* Set underlying cipher key */
+	if ( ( rc = cipher_setkey ( raw_cipher, raw_ctx, key,
+				    keylen ) ) != 0 )
+		return rc;
+
+	/* Construct hash subkey H = E(K,0^128) */
+	memset ( &gcm->key, 0, sizeof ( gcm->key ) );
+	cipher_encrypt ( raw_cipher, raw_ctx, &gcm->key, &gcm->key,
+			 sizeof ( gcm->key ) );
+
+	/* Prepare engine */
+	gcm->engine = engine;
+	if ( engine->prepare )
+		engine->prepare ( gcm );
+
+	return 0;
+}
+
+/**
+ * Set key
+ *
+ * @v gcm		GCM context
+ * @v key		Key
+ * @v keylen		Key length
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ * @ret rc		Return status code
+ */
+int gcm_setkey ( struct gcm_context *gcm, const void *key, size_t keylen,
+		 struct cipher_algorithm *raw_cipher, void *raw_ctx ) {
+
+	return gcm_engine_setkey ( gcm, ghash_engine(), key, keylen,
+				   raw_cipher, raw_ctx );
+}
+
+/**
+ * Set initialisation vector
+ *
+ * @v gcm		GCM context
+ * @v iv		Initialisation vector (GCM_IV_LEN bytes)
+ *
+ * This also starts a new message.
+ */
+void gcm_setiv ( struct gcm_context *gcm, const void *iv ) {
+
+	memcpy ( &gcm->j0, iv, GCM_IV_LEN );
+	gcm->j0.dword[3] = cpu_to_be32 ( 1 );
+	memcpy ( &gcm->ctr, &gcm->j0, sizeof ( gcm->ctr ) );
+	memset ( &gcm->hash, 0, sizeof ( gcm->hash ) );
+	gcm->aad_len = 0;
+	gcm->len = 0;
+}
+
+/**
+ * Apply keystream to data
+ *
+ * @v gcm		GCM context
+ * @v src		Input data
+ * @v dst		Output data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ */
+static void gcm_ctr ( struct gcm_context *gcm, const void *src, void *dst,
+		      size_t len, struct cipher_algorithm *raw_cipher,
+		      void *raw_ctx ) {
+	union gcm_block keystream[GCM_CTR_BLOCKS];
+	const uint32_t *in = src;
+	uint32_t *out = dst;
+	const uint8_t *in_byte;
+	uint8_t *out_byte;
+	unsigned int blocks;
+	unsigned int i;
+	size_t words;
+
+	/* Construct counter blocks */
+	blocks = ( ( len + GCM_BLOCKSIZE - 1 ) / GCM_BLOCKSIZE );
+	assert ( blocks <= GCM_CTR_BLOCKS );
+	for ( i = 0 ; i < blocks ; i++ ) {
+		gcm->ctr.dword[3] =
+			cpu_to_be32 ( be32_to_cpu ( gcm->ctr.dword[3] ) + 1 );
+		memcpy ( &keystream[i], &gcm->ctr, sizeof ( keystream[i] ) );
+	}
+
+	/* Generate keystream */
+	cipher_encrypt ( raw_cipher, raw_ctx, keystream, keystream,
+			 ( blocks * GCM_BLOCKSIZE ) );
+
+	/* Apply keystream, a word at a time where possible */
+	words = ( len / sizeof ( *in ) );
+	for ( i = 0 ; i < words ; i++ )
+		out[i] = ( in[i] ^ keystream[ i / 4 ].dword[ i % 4 ] );
+	in_byte = ( src + ( words * sizeof ( *in ) ) );
+	out_byte = ( dst + ( words * sizeof ( *out ) ) );
+	for ( i = ( words * sizeof ( *in ) ) ; i < len ; i++ ) {
+		*(out_byte++) = ( *(in_byte++) ^
+				  keystream[ i / GCM_BLOCKSIZE ].byte
+					   [ i % GCM_BLOCKSIZE ] );
+	}
+}
+
+/**
+ * Encrypt data
+ *
+ * @v gcm		GCM context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data, or NULL for additional data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ */
+void gcm_encrypt ( struct gcm_context *gcm, const void *src, void *dst,
+		   size_t len, struct cipher_algorithm *raw_cipher,
+		   void *raw_ctx ) {
+	size_t frag_len;
+
+	/* Hash additional data */
+	if ( ! dst ) {
+		assert ( gcm->len == 0 );
+		gcm_hash ( gcm, src, len );
+		gcm->aad_len += len;
+		return;
+	}
+
+	/* Encrypt and then hash each chunk */
+	gcm->len += len;
+	while ( len ) {
+		frag_len = ( GCM_CTR_BLOCKS * GCM_BLOCKSIZE );
+		if ( frag_len > len )
+			frag_len = len;
+		gcm_ctr ( gcm, src, dst, frag_len, raw_cipher, raw_ctx );
+		gcm_hash ( gcm, dst, frag_len );
+		src += frag_len;
+		dst += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Decrypt data
+ *
+ * @v gcm		GCM context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data, or NULL for additional data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ */
+void gcm_decrypt ( struct gcm_context *gcm, const void *src, void *dst,
+		   size_t len, struct cipher_algorithm *raw_cipher,
+		   void *raw_ctx ) {
+	size_t frag_len;
+
+	/* Hash additional data */
+	if ( ! dst ) {
+		gcm_encrypt ( gcm, src, NULL, len, raw_cipher, raw_ctx );
+		return;
+	}
+
+	/* Hash and then decrypt each chunk */
+	gcm->len += len;
+	while ( len ) {
+		frag_len = ( GCM_CTR_BLOCKS * GCM_BLOCKSIZE );
+		if ( frag_len > len )
+			frag_len = len;
+		gcm_hash ( gcm, src, frag_len );
+		gcm_ctr ( gcm, src, dst, frag_len, raw_cipher, raw_ctx );
+		src += frag_len;
+		dst += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Generate authentication tag
+ *
+ * @v gcm		GCM context
+ * @v auth		Buffer for authentication tag (GCM_AUTH_LEN bytes)
+ * @v raw_cipher	Underlying cipher
+ * @v raw_ctx		Underlying cipher context
+ */
+void gcm_auth ( struct gcm_context *gcm, void *auth,
+		struct cipher_algorithm *raw_cipher, void *raw_ctx ) {
+	union gcm_block lengths;
+	union gcm_block *tag = auth;
+	union gcm_block ek_j0;
+
+	/* Hash lengths (in bits) */
+	lengths.qword[0] = cpu_to_be64 ( gcm->aad_len * 8 );
+	lengths.qword[1] = cpu_to_be64 ( gcm->len * 8 );
+	gcm->engine->update ( gcm, &lengths, sizeof ( lengths ) );
+
+	/* Tag is E(K,J0) ^ hash */
+	cipher_encrypt ( raw_cipher, raw_ctx, &gcm->j0, &ek_j0,
+			 sizeof ( ek_j0 ) );
+	tag->qword[0] = ( gcm->hash.qword[0] ^ ek_j0.qword[0] );
+	tag->qword[1] = ( gcm->hash.qword[1] ^ ek_j0.qword[1] );
+}
+
+/* AES in Galois/Counter mode */
+GCM_CIPHER ( aes_gcm, aes_gcm_algorithm, aes_algorithm, struct aes_context )
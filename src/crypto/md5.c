@@ -25,120 +25,108 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <string.h>
 #include <byteswap.h>
+#include <ipxe/rotate.h>
 #include <ipxe/crypto.h>
 #include <ipxe/md5.h>
 
-struct md5_step {
-	u32 ( * f ) ( u32 b, u32 c, u32 d );
-	u8 coefficient;
-	u8 constant;
-};
-
-static u32 f1(u32 b, u32 c, u32 d)
-{
-	return ( d ^ ( b & ( c ^ d ) ) );
-}
-
-static u32 f2(u32 b, u32 c, u32 d)
-{
-	return ( c ^ ( d & ( b ^ c ) ) );
-}
-
-static u32 f3(u32 b, u32 c, u32 d)
-{
-	return ( b ^ c ^ d );
-}
-
-static u32 f4(u32 b, u32 c, u32 d)
-{
-	return ( c ^ ( b | ~d ) );
-}
-
-static struct md5_step md5_steps[4] = {
-	{
-		.f = f1,
-		.coefficient = 1,
-		.constant = 0,
-	},
-	{
-		.f = f2,
-		.coefficient = 5,
-		.constant = 1,
-	},
-	{
-		.f = f3,
-		.coefficient = 3,
-		.constant = 5,
-	},
-	{
-		.f = f4,
-		.coefficient = 7,
-		.constant = 0,
-	}
-};
-
-static const u8 r[64] = {
-	7,12,17,22,7,12,17,22,7,12,17,22,7,12,17,22,
-	5,9,14,20,5,9,14,20,5,9,14,20,5,9,14,20,
-	4,11,16,23,4,11,16,23,4,11,16,23,4,11,16,23,
-	6,10,15,21,6,10,15,21,6,10,15,21,6,10,15,21
-};
-
-static const u32 k[64] = {
-	0xd76aa478UL, 0xe8c7b756UL, 0x242070dbUL, 0xc1bdceeeUL,
-	0xf57c0fafUL, 0x4787c62aUL, 0xa8304613UL, 0xfd469501UL,
-	0x698098d8UL, 0x8b44f7afUL, 0xffff5bb1UL, 0x895cd7beUL,
-	0x6b901122UL, 0xfd987193UL, 0xa679438eUL, 0x49b40821UL,
-	0xf61e2562UL, 0xc040b340UL, 0x265e5a51UL, 0xe9b6c7aaUL,
-	0xd62f105dUL, 0x02441453UL, 0xd8a1e681UL, 0xe7d3fbc8UL,
-	0x21e1cde6UL, 0xc33707d6UL, 0xf4d50d87UL, 0x455a14edUL,
-	0xa9e3e905UL, 0xfcefa3f8UL, 0x676f02d9UL, 0x8d2a4c8aUL,
-	0xfffa3942UL, 0x8771f681UL, 0x6d9d6122UL, 0xfde5380cUL,
-	0xa4beea44UL, 0x4bdecfa9UL, 0xf6bb4b60UL, 0xbebfbc70UL,
-	0x289b7ec6UL, 0xeaa127faUL, 0xd4ef3085UL, 0x04881d05UL,
-	0xd9d4d039UL, 0xe6db99e5UL, 0x1fa27cf8UL, 0xc4ac5665UL,
-	0xf4292244UL, 0x432aff97UL, 0xab9423a7UL, 0xfc93a039UL,
-	0x655b59c3UL, 0x8f0ccc92UL, 0xffeff47dUL, 0x85845dd1UL,
-	0x6fa87e4fUL, 0xfe2ce6e0UL, 0xa3014314UL, 0x4e0811a1UL,
-	0xf7537e82UL, 0xbd3af235UL, 0x2ad7d2bbUL, 0xeb86d391UL,
-};
-
-static void md5_transform(u32 *hash, const u32 *in)
-{
-	u32 a, b, c, d, f, g, temp;
-	int i;
-	struct md5_step *step;
-
-	a = hash[0];
-	b = hash[1];
-	c = hash[2];
-	d = hash[3];
-
-	for ( i = 0 ; i < 64 ; i++ ) {
-		step = &md5_steps[i >> 4];
-		f = step->f ( b, c, d );
-		g = ( ( i * step->coefficient + step->constant ) & 0xf );
-		temp = d;
-		d = c;
-		c = b;
-		a += ( f + k[i] + in[g] );
-		a = ( ( a << r[i] ) | ( a >> ( 32-r[i] ) ) );
-		b += a;
-		a = temp;
-	}
+#define F1(b, c, d) ( d ^ ( b & ( c ^ d ) ) )
+#define F2(b, c, d) ( c ^ ( d & ( b ^ c ) ) )
+#define F3(b, c, d) ( b ^ c ^ d )
+#define F4(b, c, d) ( c ^ ( b | ~d ) )
 
-	hash[0] += a;
-	hash[1] += b;
-	hash[2] += c;
-	hash[3] += d;
-}
+/*
+ * Each step is written out explicitly, so that the message word
+ * index, round constant and rotation are all immediate operands and
+ * the working variables are renamed rather than shuffled.
+ */
+#define MD5STEP(f, a, b, c, d, x, k, s) do {			\
+	a += f ( b, c, d ) + le32_to_cpu ( in[x] ) + k;		\
+	a = rol32 ( a, s ) + b;					\
+	} while ( 0 )
 
-/* XXX: this stuff can be optimized */
-static inline void le32_to_cpu_array(u32 *buf, unsigned int words)
+static void md5_transform(u32 *hash, const void *data, size_t blocks)
 {
-	while (words--) {
-		le32_to_cpus(buf);
-		buf++;
+	const u32 *in = data;
+	u32 a, b, c, d;
+
+	for ( ; blocks-- ; in += MD5_BLOCK_WORDS ) {
+		a = hash[0];
+		b = hash[1];
+		c = hash[2];
+		d = hash[3];
+
+		MD5STEP(F1, a, b, c, d, 0, 0xd76aa478, 7);
+		MD5STEP(F1, d, a, b, c, 1, 0xe8c7b756, 12);
+		MD5STEP(F1, c, d, a, b, 2, 0x242070db, 17);
+		MD5STEP(F1, b, c, d, a, 3, 0xc1bdceee, 22);
+		MD5STEP(F1, a, b, c, d, 4, 0xf57c0faf, 7);
+		MD5STEP(F1, d, a, b, c, 5, 0x4787c62a, 12);
+		MD5STEP(F1, c, d, a, b, 6, 0xa8304613, 17);
+		MD5STEP(F1, b, c, d, a, 7, 0xfd469501, 22);
+		MD5STEP(F1, a, b, c, d, 8, 0x698098d8, 7);
+		MD5STEP(F1, d, a, b, c, 9, 0x8b44f7af, 12);
+		MD5STEP(F1, c, d, a, b, 10, 0xffff5bb1, 17);
+		MD5STEP(F1, b, c, d, a, 11, 0x895cd7be, 22);
+		MD5STEP(F1, a, b, c, d, 12, 0x6b901122, 7);
+		MD5STEP(F1, d, a, b, c, 13, 0xfd987193, 12);
+		MD5STEP(F1, c, d, a, b, 14, 0xa679438e, 17);
+		MD5STEP(F1, b, c, d, a, 15, 0x49b40821, 22);
+
+		MD5STEP(F2, a, b, c, d, 1, 0xf61e2562, 5);
+		MD5STEP(F2, d, a, b, c, 6, 0xc040b340, 9);
+		MD5STEP(F2, c, d, a, b, 11, 0x265e5a51, 14);
+		MD5STEP(F2, b, c, d, a, 0, 0xe9b6c7aa, 20);
+		MD5STEP(F2, a, b, c, d, 5, 0xd62f105d, 5);
+		MD5STEP(F2, d, a, b, c, 10, 0x02441453, 9);
+		MD5STEP(F2, c, d, a, b, 15, 0xd8a1e681, 14);
+		MD5STEP(F2, b, c, d, a, 4, 0xe7d3fbc8, 20);
+		MD5STEP(F2, a, b, c, d, 9, 0x21e1cde6, 5);
+		MD5STEP(F2, d, a, b, c, 14, 0xc33707d6, 9);
+		MD5STEP(F2, c, d, a, b, 3, 0xf4d50d87, 14);
+		MD5STEP(F2, b, c, d, a, 8, 0x455a14ed, 20);
+		MD5STEP(F2, a, b, c, d, 13, 0xa9e3e905, 5);
+		MD5STEP(F2, d, a, b, c, 2, 0xfcefa3f8, 9);
+		MD5STEP(F2, c, d, a, b, 7, 0x676f02d9, 14);
+		MD5STEP(F2, b, c, d, a, 12, 0x8d2a4c8a, 20);
+
+		MD5STEP(F3, a, b, c, d, 5, 0xfffa3942, 4);
+		MD5STEP(F3, d, a, b, c, 8, 0x8771f681, 11);
+		MD5STEP(F3, c, d, a, b, 11, 0x6d9d6122, 16);
+		MD5STEP(F3, b, c, d, a, 14, 0xfde5380c, 23);
+		MD5STEP(F3, a, b, c, d, 1, 0xa4beea44, 4);
+		MD5STEP(F3, d, a, b, c, 4, 0x4bdecfa9, 11);
+		MD5STEP(F3, c, d, a, b, 7, 0xf6bb4b60, 16);
+		MD5STEP(F3, b, c, d, a, 10, 0xbebfbc70, 23);
+		MD5STEP(F3, a, b, c, d, 13, 0x289b7ec6, 4);
+		MD5STEP(F3, d, a, b, c, 0, 0xeaa127fa, 11);
+		MD5STEP(F3, c, d, a, b, 3, 0xd4ef3085, 16);
+		MD5STEP(F3, b, c, d, a, 6, 0x04881d05, 23);
+		MD5STEP(F3, a, b, c, d, 9, 0xd9d4d039, 4);
+		MD5STEP(F3, d, a, b, c, 12, 0xe6db99e5, 11);
+		MD5STEP(F3, c, d, a, b, 15, 0x1fa27cf8, 16);
+		MD5STEP(F3, b, c, d, a, 2, 0xc4ac5665, 23);
+
+		MD5STEP(F4, a, b, c, d, 0, 0xf4292244, 6);
+		MD5STEP(F4, d, a, b, c, 7, 0x432aff97, 10);
+		MD5STEP(F4, c, d, a, b, 14, 0xab9423a7, 15);
+		MD5STEP(F4, b, c, d, a, 5, 0xfc93a039, 21);
+		MD5STEP(F4, a, b, c, d, 12, 0x655b59c3, 6);
+		MD5STEP(F4, d, a, b, c, 3, 0x8f0ccc92, 10);
+		MD5STEP(F4, c, d, a, b, 10, 0xffeff47d, 15);
+		MD5STEP(F4, b, c, d, a, 1, 0x85845dd1, 21);
+		MD5STEP(F4, a, b, c, d, 8, 0x6fa87e4f, 6);
+		MD5STEP(F4, d, a, b, c, 15, 0xfe2ce6e0, 10);
+		MD5STEP(F4, c, d, a, b, 6, 0xa3014314, 15);
+		MD5STEP(F4, b, c, d, a, 13, 0x4e0811a1, 21);
+		MD5STEP(F4, a, b, c, d, 4, 0xf7537e82, 6);
+		MD5STEP(F4, d, a, b, c, 11, 0xbd3af235, 10);
+		MD5STEP(F4, c, d, a, b, 2, 0x2ad7d2bb, 15);
+		MD5STEP(F4, b, c, d, a, 9, 0xeb86d391, 21);
+
+		hash[0] += a;
+		hash[1] += b;
+		hash[2] += c;
+		hash[3] += d;
 	}
 }
 
@@ -150,12 +138,6 @@ static inline void cpu_to_le32_array(u32 *buf, unsigned int words)
 	}
 }
 
-static inline void md5_transform_helper(struct md5_ctx *ctx)
-{
-	le32_to_cpu_array(ctx->block, sizeof(ctx->block) / sizeof(u32));
-	md5_transform(ctx->hash, ctx->block);
-}
-
 static void md5_init(void *context)
 {
 	struct md5_ctx *mctx = context;
@@ -171,6 +153,7 @@ static void md5_update(void *context, const void *data, size_t len)
 {
 	struct md5_ctx *mctx = context;
 	const u32 avail = sizeof(mctx->block) - (mctx->byte_count & 0x3f);
+	size_t blocks;
 
 	mctx->byte_count += len;
 
@@ -183,15 +166,16 @@ static void md5_update(void *context, const void *data, size_t len)
 	memcpy((char *)mctx->block + (sizeof(mctx->block) - avail),
 	       data, avail);
 
-	md5_transform_helper(mctx);
+	md5_transform(mctx->hash, mctx->block, 1);
 	data += avail;
 	len -= avail;
 
-	while (len >= sizeof(mctx->block)) {
-		memcpy(mctx->block, data, sizeof(mctx->block));
-		md5_transform_helper(mctx);
-		data += sizeof(mctx->block);
-		len -= sizeof(mctx->block);
+	/* Transform whole blocks in place, without copying */
+	blocks = len / sizeof(mctx->block);
+	if (blocks) {
+		md5_transform(mctx->hash, data, blocks);
+		data += blocks * sizeof(mctx->block);
+		len -= blocks * sizeof(mctx->block);
 	}
 
 	memcpy(mctx->block, data, len);
@@ -207,17 +191,15 @@ static void md5_final(void *context, void *out)
 	*p++ = 0x80;
 	if (padding < 0) {
 		memset(p, 0x00, padding + sizeof (u64));
-		md5_transform_helper(mctx);
+		md5_transform(mctx->hash, mctx->block, 1);
 		p = (char *)mctx->block;
 		padding = 56;
 	}
 
 	memset(p, 0, padding);
-	mctx->block[14] = mctx->byte_count << 3;
-	mctx->block[15] = mctx->byte_count >> 29;
-	le32_to_cpu_array(mctx->block, (sizeof(mctx->block) -
-	                  sizeof(u64)) / sizeof(u32));
-	md5_transform(mctx->hash, mctx->block);
+	mctx->block[14] = cpu_to_le32(mctx->byte_count << 3);
+	mctx->block[15] = cpu_to_le32(mctx->byte_count >> 29);
+	md5_transform(mctx->hash, mctx->block, 1);
 	cpu_to_le32_array(mctx->hash, sizeof(mctx->hash) / sizeof(u32));
 	memcpy(out, mctx->hash, sizeof(mctx->hash));
 	memset(mctx, 0, sizeof(*mctx));
@@ -0,0 +1,391 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * Modular exponentiation
+ *
+ * Exponentiation uses Montgomery multiplication (in the "coarsely
+ * integrated operand scanning" form) with a fixed exponent window,
+ * so that no division is ever required.  Numbers are held as arrays
+ * of little-endian limbs; the limb size is selected at build time
+ * via MODEXP_LIMB_BITS.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/modexp.h>
+
+/** Number of bytes in a limb */
+#define MODEXP_LIMB_SIZE sizeof ( modexp_limb_t )
+
+/** Maximum exponent window size (in bits) */
+#define MODEXP_MAX_WINDOW 5
+
+/**
+ * Convert big-endian byte string to limbs
+ *
+ * @v dest		Limbs
+ * @v count		Number of limbs
+ * @v src		Big-endian byte string
+ * @v len		Length of byte string
+ * @ret rc		Return status code
+ */
+static int modexp_import ( modexp_limb_t *dest, unsigned int count,
+			   const uint8_t *src, size_t len ) {
+	unsigned int i;
+
+	/* Skip leading zeros that will not fit */
+	while ( len > ( count * MODEXP_LIMB_SIZE ) ) {
+		if ( *(src++) )
+			return -ERANGE;
+		len--;
+	}
+
+	memset ( dest, 0, ( count * MODEXP_LIMB_SIZE ) );
+	for ( i = 0 ; i < len ; i++ ) {
+		dest[ i / MODEXP_LIMB_SIZE ] |=
+			( ( ( modexp_limb_t ) src[ len - i - 1 ] ) <<
+			  ( 8 * ( i % MODEXP_LIMB_SIZE ) ) );
+	}
+	return 0;
+}
+
+/**
+ * Convert limbs to big-endian byte string
+ *
+ * @v src		Limbs
+ * @v dest		Big-endian byte string
+ * @v len		Length of byte string
+ */
+static void modexp_export ( const modexp_limb_t *src, uint8_t *dest,
+			    size_t len ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < len ; i++ ) {
+		dest[ len - i - 1 ] = ( src[ i / MODEXP_LIMB_SIZE ] >>
+					( 8 * ( i % MODEXP_LIMB_SIZE ) ) );
+	}
+}
+
+/**
+ * Compare two numbers
+ *
+ * @v a			Number
+ * @v b			Number
+ * @v count		Number of limbs
+ * @ret geq		a is greater than or equal to b
+ */
+static int modexp_geq ( const modexp_limb_t *a, const modexp_limb_t *b,
+			unsigned int count ) {
+
+	while ( count-- ) {
+		if ( a[count] != b[count] )
+			return ( a[count] > b[count] );
+	}
+	return 1;
+}
+
+/**
+ * Subtract one number from another in place
+ *
+ * @v a			Number to subtract from
+ * @v b			Number to subtract
+ * @v count		Number of limbs
+ */
+static void modexp_sub ( modexp_limb_t *a, const modexp_limb_t *b,
+			 unsigned int count ) {
+	modexp_limb_t borrow = 0;
+	modexp_limb_t diff;
+	unsigned int i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		diff = ( a[i] - b[i] - borrow );
+		borrow = ( ( a[i] < b[i] ) || ( ( a[i] == b[i] ) && borrow ) );
+		a[i] = diff;
+	}
+}
+
+/**
+ * Double a number modulo m
+ *
+ * @v a			Number (must be less than m)
+ * @v m			Modulus
+ * @v count		Number of limbs
+ */
+static void modexp_double ( modexp_limb_t *a, const modexp_limb_t *m,
+			    unsigned int count ) {
+	modexp_limb_t carry = 0;
+	modexp_limb_t next;
+	unsigned int i;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		next = ( a[i] >> ( MODEXP_LIMB_BITS - 1 ) );
+		a[i] = ( ( a[i] << 1 ) | carry );
+		carry = next;
+	}
+	if ( carry || modexp_geq ( a, m, count ) )
+		modexp_sub ( a, m, count );
+}
+
+/**
+ * Calculate Montgomery constant -m^-1 mod 2^MODEXP_LIMB_BITS
+ *
+ * @v m0		Least significant limb of modulus (must be odd)
+ * @ret n0		Montgomery constant
+ */
+static modexp_limb_t modexp_n0 ( modexp_limb_t m0 ) {
+	modexp_limb_t inv = m0;
+	unsigned int bits;
+
+	/* For odd m0, m0 is its own inverse modulo 2^3.  Each Newton
+	 * iteration doubles the number of correct bits.
+	 */
+	for ( bits = 3 ; bits < MODEXP_LIMB_BITS ; bits *= 2 )
+		inv *= ( 2 - ( m0 * inv ) );
+	return ( -inv );
+}
+
+/**
+ * Perform Montgomery multiplication
+ *
+ * @v r			Result r = a * b * R^-1 mod m (may alias a or b)
+ * @v a			Multiplicand (less than m)
+ * @v b			Multiplier (less than m)
+ * @v m			Modulus
+ * @v n0		Montgomery constant
+ * @v t			Temporary storage (count + 2 limbs)
+ * @v count		Number of limbs
+ */
+static void modexp_mont_mul ( modexp_limb_t *r, const modexp_limb_t *a,
+			      const modexp_limb_t *b, const modexp_limb_t *m,
+			      modexp_limb_t n0, modexp_limb_t *t,
+			      unsigned int count ) {
+	modexp_dlimb_t product;
+	modexp_limb_t carry;
+	modexp_limb_t u;
+	unsigned int i;
+	unsigned int j;
+
+	memset ( t, 0, ( ( count + 2 ) * MODEXP_LIMB_SIZE ) );
+	for ( i = 0 ; i < count ; i++ ) {
+
+		/* t += a * b[i] */
+		carry = 0;
+		for ( j = 0 ; j < count ; j++ ) {
+			product = ( ( ( modexp_dlimb_t ) a[j] ) * b[i] +
+				    t[j] + carry );
+			t[j] = product;
+			carry = ( product >> MODEXP_LIMB_BITS );
+		}
+		product = ( ( ( modexp_dlimb_t ) t[count] ) + carry );
+		t[count] = product;
+		t[ count + 1 ] = ( product >> MODEXP_LIMB_BITS );
+
+		/* t = ( t + u * m ) / 2^MODEXP_LIMB_BITS, where u is
+		 * chosen to make the lowest limb zero.
+		 */
+		u = ( t[0] * n0 );
+		product = ( ( ( modexp_dlimb_t ) u ) * m[0] + t[0] );
+		carry = ( product >> MODEXP_LIMB_BITS );
+		for ( j = 1 ; j < count ; j++ ) {
+			product = ( ( ( modexp_dlimb_t ) u ) * m[j] +
+				    t[j] + carry );
+			t[ j - 1 ] = product;
+			carry = ( product >> MODEXP_LIMB_BITS );
+		}
+		product = ( ( ( modexp_dlimb_t ) t[count] ) + carry );
+		t[ count - 1 ] = product;
+		t[count] = ( t[ count + 1 ] + ( product >> MODEXP_LIMB_BITS ) );
+	}
+
+	/* Result is less than 2m; subtract m if necessary */
+	if ( t[count] || modexp_geq ( t, m, count ) )
+		modexp_sub ( t, m, count );
+	memcpy ( r, t, ( count * MODEXP_LIMB_SIZE ) );
+}
+
+/**
+ * Extract bits from big-endian exponent
+ *
+ * @v exponent		Exponent
+ * @v len		Length of exponent
+ * @v bit		Index of first (least significant) bit
+ * @v width		Number of bits
+ * @ret value		Value of bits
+ */
+static unsigned int modexp_bits ( const uint8_t *exponent, size_t len,
+				  unsigned int bit, unsigned int width ) {
+	unsigned int value = 0;
+	unsigned int byte;
+
+	while ( width-- ) {
+		byte = ( ( bit + width ) / 8 );
+		value <<= 1;
+		if ( byte < len ) {
+			value |= ( ( exponent[ len - byte - 1 ] >>
+				     ( ( bit + width ) % 8 ) ) & 1 );
+		}
+	}
+	return value;
+}
+
+/**
+ * Choose exponent window size
+ *
+ * @v bits		Length of exponent (in bits)
+ * @ret window		Window size (in bits)
+ *
+ * Each extra bit of window doubles the size of the precomputed
+ * table, so small (e.g. public) exponents use a narrow window.
+ */
+static unsigned int modexp_window ( unsigned int bits ) {
+
+	if ( bits <= 24 )
+		return 1;
+	if ( bits <= 96 )
+		return 3;
+	if ( bits <= 384 )
+		return 4;
+	return MODEXP_MAX_WINDOW;
+}
+
+/**
+ * Perform modular exponentiation
+ *
+ * @v modulus		Modulus (must be odd)
+ * @v modulus_len	Length of modulus
+ * @v base		Base
+ * @v base_len		Length of base
+ * @v exponent		Exponent
+ * @v exponent_len	Length of exponent
+ * @v result		Result buffer (modulus_len bytes)
+ * @ret rc		Return status code
+ *
+ * All numbers are unsigned big-endian byte strings.  The base must be
+ * less than the modulus.  The result buffer may overlap the base.
+ */
+int modexp ( const void *modulus, size_t modulus_len,
+	     const void *base, size_t base_len,
+	     const void *exponent, size_t exponent_len,
+	     void *result ) {
+	unsigned int count = ( ( modulus_len + MODEXP_LIMB_SIZE - 1 ) /
+			       MODEXP_LIMB_SIZE );
+	const uint8_t *exp = exponent;
+	modexp_limb_t *m;
+	modexp_limb_t *rr;
+	modexp_limb_t *acc;
+	modexp_limb_t *t;
+	modexp_limb_t *table;
+	modexp_limb_t n0;
+	unsigned int bits;
+	unsigned int window;
+	unsigned int windows;
+	unsigned int value;
+	unsigned int i;
+	int rc;
+
+	/* Find length of exponent, ignoring leading zeros */
+	while ( exponent_len && ( exp[0] == 0 ) ) {
+		exp++;
+		exponent_len--;
+	}
+	bits = ( 8 * exponent_len );
+	if ( bits ) {
+		for ( value = exp[0] ; ! ( value & 0x80 ) ; value <<= 1 )
+			bits--;
+	}
+	window = modexp_window ( bits );
+	windows = ( ( bits + window - 1 ) / window );
+
+	/* Allocate working storage */
+	m = malloc ( ( ( 4 + ( 1 << window ) ) * count + 2 ) *
+		     MODEXP_LIMB_SIZE );
+	if ( ! m )
+		return -ENOMEM;
+	rr = ( m + count );
+	acc = ( rr + count );
+	table = ( acc + count );
+	t = ( table + ( count << window ) );
+
+	/* Import modulus and base */
+	if ( ( rc = modexp_import ( m, count, modulus, modulus_len ) ) != 0 )
+		goto done;
+	if ( ! ( m[0] & 1 ) ) {
+		rc = -EINVAL;
+		goto done;
+	}
+	if ( ( rc = modexp_import ( acc, count, base, base_len ) ) != 0 )
+		goto done;
+	n0 = modexp_n0 ( m[0] );
+
+	/* Calculate R mod m and R^2 mod m by repeated doubling */
+	memset ( table, 0, ( count * MODEXP_LIMB_SIZE ) );
+	table[0] = 1;
+	if ( modexp_geq ( table, m, count ) )
+		modexp_sub ( table, m, count );
+	for ( i = 0 ; i < ( count * MODEXP_LIMB_BITS ) ; i++ )
+		modexp_double ( table, m, count );
+	memcpy ( rr, table, ( count * MODEXP_LIMB_SIZE ) );
+	for ( i = 0 ; i < ( count * MODEXP_LIMB_BITS ) ; i++ )
+		modexp_double ( rr, m, count );
+
+	/* Construct table of base^i in Montgomery form, starting
+	 * with base^0 = R mod m (already in place).
+	 */
+	modexp_mont_mul ( ( table + count ), acc, rr, m, n0, t, count );
+	for ( i = 2 ; i < ( 1U << window ) ; i++ ) {
+		modexp_mont_mul ( ( table + ( i * count ) ),
+				  ( table + ( ( i - 1 ) * count ) ),
+				  ( table + count ), m, n0, t, count );
+	}
+
+	/* Process exponent one window at a time, starting with the
+	 * most significant window.
+	 */
+	memcpy ( acc, table, ( count * MODEXP_LIMB_SIZE ) );
+	for ( i = windows ; i-- ; ) {
+		value = modexp_bits ( exp, exponent_len, ( i * window ),
+				      window );
+		if ( i == ( windows - 1 ) ) {
+			memcpy ( acc, ( table + ( value * count ) ),
+				 ( count * MODEXP_LIMB_SIZE ) );
+			continue;
+		}
+		for ( bits = 0 ; bits < window ; bits++ )
+			modexp_mont_mul ( acc, acc, acc, m, n0, t, count );
+		if ( value ) {
+			modexp_mont_mul ( acc, acc, ( table + ( value * count ) ),
+					  m, n0, t, count );
+		}
+	}
+
+	/* Convert out of Montgomery form */
+	memset ( rr, 0, ( count * MODEXP_LIMB_SIZE ) );
+	rr[0] = 1;
+	modexp_mont_mul ( acc, acc, rr, m, n0, t, count );
+	modexp_export ( acc, result, modulus_len );
+
+ done:
+	free ( m );
+	return rc;
+}
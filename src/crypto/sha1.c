@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+/** @file
+ *
+ * SHA-1 algorithm
+ *
+ * The generic engine unrolls each group of five rounds, so that the
+ * working variables are renamed rather than shuffled, and keeps the
+ * message schedule in a sixteen-word circular buffer.  Whole blocks
+ * are digested directly from the caller's buffer without copying.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <assert.h>
+#include <ipxe/rotate.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha1.h>
+
+/** SHA-1 initial hash values */
+static const uint32_t sha1_init_h[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
+
+/** Selected SHA-1 engine */
+static struct sha1_engine *sha1_selected_engine;
+
+/** SHA-1 round functions */
+#define SHA1_CH( b, c, d ) ( (d) ^ ( (b) & ( (c) ^ (d) ) ) )
+#define SHA1_PARITY( b, c, d ) ( (b) ^ (c) ^ (d) )
+#define SHA1_MAJ( b, c, d ) ( ( (b) & (c) ) | ( (d) & ( (b) | (c) ) ) )
+
+/**
+ * Get (and, if necessary, calculate) message schedule word
+ *
+ * @v i			Round number
+ * @ret w		Message schedule word
+ */
+#define SHA1_W( i ) ( ( (i) < 16 ) ?					\
+	( w[ (i) & 15 ] = be32_to_cpu ( src[ (i) & 15 ] ) ) :		\
+	( w[ (i) & 15 ] = rol32 ( ( w[ ( (i) + 13 ) & 15 ] ^		\
+				    w[ ( (i) + 8 ) & 15 ] ^		\
+				    w[ ( (i) + 2 ) & 15 ] ^		\
+				    w[ (i) & 15 ] ), 1 ) ) )
+
+/** Perform one SHA-1 round */
+#define SHA1_ROUND( a, b, c, d, e, f, k, i ) do {			\
+	(e) += ( rol32 ( (a), 5 ) + f ( (b), (c), (d) ) + (k) +	\
+		 SHA1_W ( i ) );					\
+	(b) = rol32 ( (b), 30 );					\
+	} while ( 0 )
+
+/** Perform five SHA-1 rounds, renaming the working variables */
+#define SHA1_ROUNDS_5( f, k, i ) do {					\
+	SHA1_ROUND ( a, b, c, d, e, f, k, ( (i) + 0 ) );		\
+	SHA1_ROUND ( e, a, b, c, d, f, k, ( (i) + 1 ) );		\
+	SHA1_ROUND ( d, e, a, b, c, f, k, ( (i) + 2 ) );		\
+	SHA1_ROUND ( c, d, e, a, b, f, k, ( (i) + 3 ) );		\
+	SHA1_ROUND ( b, c, d, e, a, f, k, ( (i) + 4 ) );		\
+	} while ( 0 )
+
+/**
+ * Digest data blocks using generic SHA-1 engine
+ *
+ * @v h			Hash state
+ * @v data		Data blocks
+ * @v blocks		Number of blocks
+ */
+static void sha1_generic_digest ( uint32_t *h, const void *data,
+				  size_t blocks ) {
+	const uint32_t *src = data;
+	uint32_t w[16];
+	uint32_t a, b, c, d, e;
+	unsigned int i;
+
+	for ( ; blocks-- ; src += ( SHA1_BLOCK_SIZE / sizeof ( *src ) ) ) {
+		a = h[0];
+		b = h[1];
+		c = h[2];
+		d = h[3];
+		e = h[4];
+		for ( i = 0 ; i < 20 ; i += 5 )
+			SHA1_ROUNDS_5 ( SHA1_CH, 0x5a827999, i );
+		for ( ; i < 40 ; i += 5 )
+			SHA1_ROUNDS_5 ( SHA1_PARITY, 0x6ed9eba1, i );
+		for ( ; i < 60 ; i += 5 )
+			SHA1_ROUNDS_5 ( SHA1_MAJ, 0x8f1bbcdc, i );
+		for ( ; i < 80 ; i += 5 )
+			SHA1_ROUNDS_5 ( SHA1_PARITY, 0xca62c1d6, i );
+		h[0] += a;
+		h[1] += b;
+		h[2] += c;
+		h[3] += d;
+		h[4] += e;
+	}
+}
+
+/** Generic SHA-1 engine */
+struct sha1_engine sha1_generic_engine __sha1_engine ( SHA1_ENGINE_GENERIC ) = {
+	.name = "generic",
+	.digest = sha1_generic_digest,
+};
+
+/**
+ * Select SHA-1 engine
+ *
+ * @ret engine		Fastest supported SHA-1 engine
+ */
+static struct sha1_engine * sha1_engine ( void ) {
+	struct sha1_engine *engine;
+
+	if ( ! sha1_selected_engine ) {
+		for_each_table_entry ( engine, SHA1_ENGINES ) {
+			if ( ( ! engine->supported ) || engine->supported() ) {
+				DBG ( "SHA-1 using %s engine\n", engine->name );
+				sha1_selected_engine = engine;
+				break;
+			}
+		}
+	}
+	return sha1_selected_engine;
+}
+
+/**
+ * Initialise SHA-1 algorithm using a specified engine
+ *
+ * @v context		SHA-1 context
+ * @v engine		SHA-1 engine
+ */
+void sha1_engine_init ( struct sha1_context *context,
+			struct sha1_engine *engine ) {
+
+	memcpy ( context->h, sha1_init_h, sizeof ( context->h ) );
+	context->len = 0;
+	context->engine = engine;
+}
+
+/**
+ * Initialise SHA-1 algorithm
+ *
+ * @v ctx		SHA-1 context
+ */
+static void sha1_init ( void *ctx ) {
+	sha1_engine_init ( ctx, sha1_engine() );
+}
+
+/**
+ * Accumulate data with SHA-1 algorithm
+ *
+ * @v ctx		SHA-1 context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void sha1_update ( void *ctx, const void *data, size_t len ) {
+	struct sha1_context *context = ctx;
+	size_t offset = ( context->len % SHA1_BLOCK_SIZE );
+	size_t frag_len;
+	size_t blocks;
+
+	context->len += len;
+
+	/* Complete any partial block */
+	if ( offset ) {
+		frag_len = ( SHA1_BLOCK_SIZE - offset );
+		if ( frag_len > len ) {
+			memcpy ( &context->block[offset], data, len );
+			return;
+		}
+		memcpy ( &context->block[offset], data, frag_len );
+		context->engine->digest ( context->h, context->block, 1 );
+		data += frag_len;
+		len -= frag_len;
+	}
+
+	/* Digest whole blocks in place */
+	blocks = ( len / SHA1_BLOCK_SIZE );
+	if ( blocks ) {
+		context->engine->digest ( context->h, data, blocks );
+		data += ( blocks * SHA1_BLOCK_SIZE );
+		len -= ( blocks * SHA1_BLOCK_SIZE );
+	}
+
+	/* Retain any trailing partial block */
+	memcpy ( context->block, data, len );
+}
+
+/**
+ * Generate SHA-1 digest
+ *
+ * @v ctx		SHA-1 context
+ * @v out		Output buffer
+ */
+static void sha1_final ( void *ctx, void *out ) {
+	struct sha1_context *context = ctx;
+	size_t offset = ( context->len % SHA1_BLOCK_SIZE );
+	uint64_t len_bits = cpu_to_be64 ( context->len * 8 );
+	uint32_t *digest = out;
+	unsigned int i;
+
+	/* Pad message */
+	context->block[offset++] = 0x80;
+	if ( offset > ( SHA1_BLOCK_SIZE - sizeof ( len_bits ) ) ) {
+		memset ( &context->block[offset], 0,
+			 ( SHA1_BLOCK_SIZE - offset ) );
+		context->engine->digest ( context->h, context->block, 1 );
+		offset = 0;
+	}
+	memset ( &context->block[offset], 0,
+		 ( SHA1_BLOCK_SIZE - sizeof ( len_bits ) - offset ) );
+	memcpy ( &context->block[ SHA1_BLOCK_SIZE - sizeof ( len_bits ) ],
+		 &len_bits, sizeof ( len_bits ) );
+	context->engine->digest ( context->h, context->block, 1 );
+
+	/* Copy out final digest */
+	for ( i = 0 ; i < ( SHA1_DIGEST_SIZE / sizeof ( digest[0] ) ) ; i++ )
+		digest[i] = cpu_to_be32 ( context->h[i] );
+}
+
+/** SHA-1 algorithm */
+struct digest_algorithm sha1_algorithm = {
+	.name		= "sha1",
+	.ctxsize	= SHA1_CTX_SIZE,
+	.blocksize	= SHA1_BLOCK_SIZE,
+	.digestsize	= SHA1_DIGEST_SIZE,
+	.init		= sha1_init,
+	.update		= sha1_update,
+	.final		= sha1_final,
+};
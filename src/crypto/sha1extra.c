@@ -22,6 +22,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/sha1.h>
 #include <ipxe/hmac.h>
 #include <stdint.h>
+#include <string.h>
 #include <byteswap.h>
 
 /**
@@ -46,7 +47,7 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
 	u8 keym[key_len];	/* modifiable copy of key */
 	u8 in[strlen ( label ) + 1 + data_len + 1]; /* message to HMAC */
 	u8 *in_blknr;		/* pointer to last byte of in, block number */
-	u8 out[SHA1_SIZE];	/* HMAC-SHA1 result */
+	u8 out[SHA1_DIGEST_SIZE];	/* HMAC-SHA1 result */
 	u8 sha1_ctx[SHA1_CTX_SIZE]; /* SHA1 context */
 	const size_t label_len = strlen ( label );
 
@@ -67,14 +68,14 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
 		hmac_update ( &sha1_algorithm, sha1_ctx, in, sizeof ( in ) );
 		hmac_final ( &sha1_algorithm, sha1_ctx, keym, &key_len, out );
 
-		if ( prf_len <= SHA1_SIZE ) {
+		if ( prf_len <= SHA1_DIGEST_SIZE ) {
 			memcpy ( prf, out, prf_len );
 			break;
 		}
 
-		memcpy ( prf, out, SHA1_SIZE );
-		prf_len -= SHA1_SIZE;
-		prf += SHA1_SIZE;
+		memcpy ( prf, out, SHA1_DIGEST_SIZE );
+		prf_len -= SHA1_DIGEST_SIZE;
+		prf += SHA1_DIGEST_SIZE;
 	}
 }
 
@@ -87,7 +88,7 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
  * @v salt_len		Length of salt
  * @v iterations	Number of iterations of SHA1 to perform
  * @v blocknr		Index of this block, starting at 1
- * @ret block		SHA1_SIZE bytes of PBKDF2 data
+ * @ret block		SHA1_DIGEST_SIZE bytes of PBKDF2 data
  *
  * The operation of this function is described in RFC 2898.
  */
@@ -97,7 +98,10 @@ static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
 {
 	u8 pass[pass_len];	/* modifiable passphrase */
 	u8 in[salt_len + 4];	/* input buffer to first round */
-	u8 last[SHA1_SIZE];	/* output of round N, input of N+1 */
+	u8 last[SHA1_DIGEST_SIZE];	/* output of round N, input of N+1 */
+	u8 opad[SHA1_BLOCK_SIZE];	/* HMAC outer pad */
+	u8 inner_ctx[SHA1_CTX_SIZE];	/* SHA1 context after inner pad */
+	u8 outer_ctx[SHA1_CTX_SIZE];	/* SHA1 context after outer pad */
 	u8 sha1_ctx[SHA1_CTX_SIZE];
 	u8 *next_in = in;	/* changed to `last' after first round */
 	int next_size = sizeof ( in );
@@ -108,19 +112,36 @@ static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
 	memcpy ( pass, passphrase, pass_len );
 	memcpy ( in, salt, salt_len );
 	memcpy ( in + salt_len, &blocknr, 4 );
-	memset ( block, 0, SHA1_SIZE );
+	memset ( block, 0, SHA1_DIGEST_SIZE );
+
+	/* The HMAC key is the same for every iteration, so hash the
+	   inner and outer pads once and restart each HMAC from a copy
+	   of the resulting contexts.  This halves the number of SHA1
+	   blocks processed per iteration. */
+	hmac_init ( &sha1_algorithm, inner_ctx, pass, &pass_len );
+	memset ( opad, 0, sizeof ( opad ) );
+	memcpy ( opad, pass, pass_len );
+	for ( j = 0; j < SHA1_BLOCK_SIZE; j++ ) {
+		opad[j] ^= 0x5c;
+	}
+	digest_init ( &sha1_algorithm, outer_ctx );
+	digest_update ( &sha1_algorithm, outer_ctx, opad, sizeof ( opad ) );
 
 	for ( i = 0; i < iterations; i++ ) {
-		hmac_init ( &sha1_algorithm, sha1_ctx, pass, &pass_len );
-		hmac_update ( &sha1_algorithm, sha1_ctx, next_in, next_size );
-		hmac_final ( &sha1_algorithm, sha1_ctx, pass, &pass_len, last );
-
-		for ( j = 0; j < SHA1_SIZE; j++ ) {
+		memcpy ( sha1_ctx, inner_ctx, sizeof ( sha1_ctx ) );
+		digest_update ( &sha1_algorithm, sha1_ctx, next_in, next_size );
+		digest_final ( &sha1_algorithm, sha1_ctx, last );
+		memcpy ( sha1_ctx, outer_ctx, sizeof ( sha1_ctx ) );
+		digest_update ( &sha1_algorithm, sha1_ctx, last,
+				SHA1_DIGEST_SIZE );
+		digest_final ( &sha1_algorithm, sha1_ctx, last );
+
+		for ( j = 0; j < SHA1_DIGEST_SIZE; j++ ) {
 			block[j] ^= last[j];
 		}
 
 		next_in = last;
-		next_size = SHA1_SIZE;
+		next_size = SHA1_DIGEST_SIZE;
 	}
 }
 
@@ -146,20 +167,20 @@ void pbkdf2_sha1 ( const void *passphrase, size_t pass_len,
 		   const void *salt, size_t salt_len,
 		   int iterations, void *key, size_t key_len )
 {
-	u32 blocks = ( key_len + SHA1_SIZE - 1 ) / SHA1_SIZE;
+	u32 blocks = ( key_len + SHA1_DIGEST_SIZE - 1 ) / SHA1_DIGEST_SIZE;
 	u32 blk;
-	u8 buf[SHA1_SIZE];
+	u8 buf[SHA1_DIGEST_SIZE];
 
 	for ( blk = 1; blk <= blocks; blk++ ) {
 		pbkdf2_sha1_f ( passphrase, pass_len, salt, salt_len,
 				iterations, blk, buf );
-		if ( key_len <= SHA1_SIZE ) {
+		if ( key_len <= SHA1_DIGEST_SIZE ) {
 			memcpy ( key, buf, key_len );
 			break;
 		}
 
-		memcpy ( key, buf, SHA1_SIZE );
-		key_len -= SHA1_SIZE;
-		key += SHA1_SIZE;
+		memcpy ( key, buf, SHA1_DIGEST_SIZE );
+		key_len -= SHA1_DIGEST_SIZE;
+		key += SHA1_DIGEST_SIZE;
 	}
 }
@@ -0,0 +1,273 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+/** @file
+ *
+ * SHA-256 algorithm
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <assert.h>
+#include <ipxe/rotate.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha256.h>
+
+/** SHA-256 initial hash values */
+static const uint32_t sha256_init_h[8] = {
+	0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+	0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+/** SHA-256 round constants
+ *
+ * Aligned so that accelerated engines may use them as SSE operands.
+ */
+const uint32_t sha256_k[SHA256_ROUNDS] __attribute__ (( aligned ( 16 ) )) = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+	0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+	0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+	0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+	0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+	0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+	0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+	0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+	0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+/** Selected SHA-256 engine */
+static struct sha256_engine *sha256_selected_engine;
+
+/** SHA-256 functions */
+#define SHA256_S0( x ) ( ror32 ( x, 2 ) ^ ror32 ( x, 13 ) ^ ror32 ( x, 22 ) )
+#define SHA256_S1( x ) ( ror32 ( x, 6 ) ^ ror32 ( x, 11 ) ^ ror32 ( x, 25 ) )
+#define SHA256_s0( x ) ( ror32 ( x, 7 ) ^ ror32 ( x, 18 ) ^ ( (x) >> 3 ) )
+#define SHA256_s1( x ) ( ror32 ( x, 17 ) ^ ror32 ( x, 19 ) ^ ( (x) >> 10 ) )
+#define SHA256_CH( e, f, g ) ( (g) ^ ( (e) & ( (f) ^ (g) ) ) )
+#define SHA256_MAJ( a, b, c ) ( ( (a) & (b) ) | ( (c) & ( (a) | (b) ) ) )
+
+/**
+ * Get (and, if necessary, calculate) message schedule word
+ *
+ * @v i			Round number
+ * @ret w		Message schedule word
+ */
+#define SHA256_W( i ) ( ( (i) < 16 ) ?					\
+	( w[ (i) & 15 ] = be32_to_cpu ( src[ (i) & 15 ] ) ) :		\
+	( w[ (i) & 15 ] += ( SHA256_s1 ( w[ ( (i) + 14 ) & 15 ] ) +	\
+			     w[ ( (i) + 9 ) & 15 ] +			\
+			     SHA256_s0 ( w[ ( (i) + 1 ) & 15 ] ) ) ) )
+
+/** Perform one SHA-256 round */
+#define SHA256_ROUND( a, b, c, d, e, f, g, h, i ) do {			\
+	uint32_t t1 = ( (h) + SHA256_S1 ( e ) + SHA256_CH ( e, f, g ) +	\
+			sha256_k[i] + SHA256_W ( i ) );			\
+	(d) += t1;							\
+	(h) = ( t1 + SHA256_S0 ( a ) + SHA256_MAJ ( a, b, c ) );	\
+	} while ( 0 )
+
+/** Perform eight SHA-256 rounds, renaming the working variables */
+#define SHA256_ROUNDS_8( i ) do {					\
+	SHA256_ROUND ( a, b, c, d, e, f, g, h, ( (i) + 0 ) );		\
+	SHA256_ROUND ( h, a, b, c, d, e, f, g, ( (i) + 1 ) );		\
+	SHA256_ROUND ( g, h, a, b, c, d, e, f, ( (i) + 2 ) );		\
+	SHA256_ROUND ( f, g, h, a, b, c, d, e, ( (i) + 3 ) );		\
+	SHA256_ROUND ( e, f, g, h, a, b, c, d, ( (i) + 4 ) );		\
+	SHA256_ROUND ( d, e, f, g, h, a, b, c, ( (i) + 5 ) );		\
+	SHA256_ROUND ( c, d, e, f, g, h, a, b, ( (i) + 6 ) );		\
+	SHA256_ROUND ( b, c, d, e, f, g, h, a, ( (i) + 7 ) );		\
+	} while ( 0 )
+
+/**
+ * Digest data blocks using generic SHA-256 engine
+ *
+ * @v state		Hash state
+ * @v data		Data blocks
+ * @v blocks		Number of blocks
+ */
+static void sha256_generic_digest ( uint32_t *state, const void *data,
+				    size_t blocks ) {
+	const uint32_t *src = data;
+	uint32_t w[16];
+	uint32_t a, b, c, d, e, f, g, h;
+	unsigned int i;
+
+	for ( ; blocks-- ; src += ( SHA256_BLOCK_SIZE / sizeof ( *src ) ) ) {
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+		for ( i = 0 ; i < SHA256_ROUNDS ; i += 8 )
+			SHA256_ROUNDS_8 ( i );
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+	}
+}
+
+/** Generic SHA-256 engine */
+struct sha256_engine sha256_generic_engine
+	__sha256_engine ( SHA256_ENGINE_GENERIC ) = {
+	.name = "generic",
+	.digest = sha256_generic_digest,
+};
+
+/**
+ * Select SHA-256 engine
+ *
+ * @ret engine		Fastest supported SHA-256 engine
+ */
+static struct sha256_engine * sha256_engine ( void ) {
+	struct sha256_engine *engine;
+
+	if ( ! sha256_selected_engine ) {
+		for_each_table_entry ( engine, SHA256_ENGINES ) {
+			if ( ( ! engine->supported ) || engine->supported() ) {
+				DBG ( "SHA-256 using %s engine\n",
+				      engine->name );
+				sha256_selected_engine = engine;
+				break;
+			}
+		}
+	}
+	return sha256_selected_engine;
+}
+
+/**
+ * Initialise SHA-256 algorithm using a specified engine
+ *
+ * @v context		SHA-256 context
+ * @v engine		SHA-256 engine
+ */
+void sha256_engine_init ( struct sha256_context *context,
+			  struct sha256_engine *engine ) {
+
+	memcpy ( context->h, sha256_init_h, sizeof ( context->h ) );
+	context->len = 0;
+	context->engine = engine;
+}
+
+/**
+ * Initialise SHA-256 algorithm
+ *
+ * @v ctx		SHA-256 context
+ */
+static void sha256_init ( void *ctx ) {
+	sha256_engine_init ( ctx, sha256_engine() );
+}
+
+/**
+ * Accumulate data with SHA-256 algorithm
+ *
+ * @v ctx		SHA-256 context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void sha256_update ( void *ctx, const void *data, size_t len ) {
+	struct sha256_context *context = ctx;
+	size_t offset = ( context->len % SHA256_BLOCK_SIZE );
+	size_t frag_len;
+	size_t blocks;
+
+	context->len += len;
+
+	/* Complete any partial block */
+	if ( offset ) {
+		frag_len = ( SHA256_BLOCK_SIZE - offset );
+		if ( frag_len > len ) {
+			memcpy ( &context->block.byte[offset], data, len );
+			return;
+		}
+		memcpy ( &context->block.byte[offset], data, frag_len );
+		context->engine->digest ( context->h, context->block.byte, 1 );
+		data += frag_len;
+		len -= frag_len;
+	}
+
+	/* Digest whole blocks in place */
+	blocks = ( len / SHA256_BLOCK_SIZE );
+	if ( blocks ) {
+		context->engine->digest ( context->h, data, blocks );
+		data += ( blocks * SHA256_BLOCK_SIZE );
+		len -= ( blocks * SHA256_BLOCK_SIZE );
+	}
+
+	/* Retain any trailing partial block */
+	memcpy ( context->block.byte, data, len );
+}
+
+/**
+ * Generate SHA-256 digest
+ *
+ * @v ctx		SHA-256 context
+ * @v out		Output buffer
+ */
+static void sha256_final ( void *ctx, void *out ) {
+	struct sha256_context *context = ctx;
+	size_t offset = ( context->len % SHA256_BLOCK_SIZE );
+	uint64_t len_bits = cpu_to_be64 ( context->len * 8 );
+	uint32_t *digest = out;
+	unsigned int i;
+
+	/* Pad message */
+	context->block.byte[offset++] = 0x80;
+	if ( offset > ( SHA256_BLOCK_SIZE - sizeof ( len_bits ) ) ) {
+		memset ( &context->block.byte[offset], 0,
+			 ( SHA256_BLOCK_SIZE - offset ) );
+		context->engine->digest ( context->h, context->block.byte, 1 );
+		offset = 0;
+	}
+	memset ( &context->block.byte[offset], 0,
+		 ( SHA256_BLOCK_SIZE - sizeof ( len_bits ) - offset ) );
+	context->block.qword[ ( SHA256_BLOCK_SIZE / sizeof ( len_bits ) ) - 1 ]
+		= len_bits;
+	context->engine->digest ( context->h, context->block.byte, 1 );
+
+	/* Copy out final digest */
+	for ( i = 0 ; i < ( SHA256_DIGEST_SIZE / sizeof ( digest[0] ) ) ; i++ )
+		digest[i] = cpu_to_be32 ( context->h[i] );
+}
+
+/** SHA-256 algorithm */
+struct digest_algorithm sha256_algorithm = {
+	.name		= "sha256",
+	.ctxsize	= SHA256_CTX_SIZE,
+	.blocksize	= SHA256_BLOCK_SIZE,
+	.digestsize	= SHA256_DIGEST_SIZE,
+	.init		= sha256_init,
+	.update		= sha256_update,
+	.final		= sha256_final,
+};
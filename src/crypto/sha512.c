@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+/** @file
+ *
+ * SHA-512 family of algorithms
+ *
+ * SHA-384 is SHA-512 with different initial hash values and a
+ * truncated digest.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <assert.h>
+#include <ipxe/rotate.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha512.h>
+
+/** SHA-512 initial hash values */
+static const uint64_t sha512_init_h[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+/** SHA-384 initial hash values */
+static const uint64_t sha384_init_h[8] = {
+	0xcbbb9d5dc1059ed8ULL, 0x629a292a367cd507ULL,
+	0x9159015a3070dd17ULL, 0x152fecd8f70e5939ULL,
+	0x67332667ffc00b31ULL, 0x8eb44a8768581511ULL,
+	0xdb0c2e0d64f98fa7ULL, 0x47b5481dbefa4fa4ULL,
+};
+
+/** SHA-512 constants */
+static const uint64_t k[SHA512_ROUNDS] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+/**
+ * Initialise SHA-512 algorithm
+ *
+ * @v ctx		SHA-512 context
+ */
+static void sha512_init ( void *ctx ) {
+	struct sha512_context *context = ctx;
+
+	memcpy ( context->h, sha512_init_h, sizeof ( context->h ) );
+	context->len = 0;
+}
+
+/**
+ * Initialise SHA-384 algorithm
+ *
+ * @v ctx		SHA-512 context
+ */
+static void sha384_init ( void *ctx ) {
+	struct sha512_context *context = ctx;
+
+	memcpy ( context->h, sha384_init_h, sizeof ( context->h ) );
+	context->len = 0;
+}
+
+/**
+ * Calculate SHA-512 digest of accumulated data block
+ *
+ * @v context		SHA-512 context
+ */
+static void sha512_digest ( struct sha512_context *context ) {
+	uint64_t w[SHA512_ROUNDS];
+	uint64_t a = context->h[0];
+	uint64_t b = context->h[1];
+	uint64_t c = context->h[2];
+	uint64_t d = context->h[3];
+	uint64_t e = context->h[4];
+	uint64_t f = context->h[5];
+	uint64_t g = context->h[6];
+	uint64_t h = context->h[7];
+	uint64_t s0, s1, maj, t1, t2, ch;
+	unsigned int i;
+
+	/* Construct message schedule */
+	for ( i = 0 ; i < 16 ; i++ )
+		w[i] = be64_to_cpu ( context->block.qword[i] );
+	for ( ; i < SHA512_ROUNDS ; i++ ) {
+		s0 = ( ror64 ( w[ i - 15 ], 1 ) ^ ror64 ( w[ i - 15 ], 8 ) ^
+		       ( w[ i - 15 ] >> 7 ) );
+		s1 = ( ror64 ( w[ i - 2 ], 19 ) ^ ror64 ( w[ i - 2 ], 61 ) ^
+		       ( w[ i - 2 ] >> 6 ) );
+		w[i] = ( w[ i - 16 ] + s0 + w[ i - 7 ] + s1 );
+	}
+
+	/* Main loop */
+	for ( i = 0 ; i < SHA512_ROUNDS ; i++ ) {
+		s0 = ( ror64 ( a, 28 ) ^ ror64 ( a, 34 ) ^ ror64 ( a, 39 ) );
+		maj = ( ( a & b ) ^ ( a & c ) ^ ( b & c ) );
+		t2 = ( s0 + maj );
+		s1 = ( ror64 ( e, 14 ) ^ ror64 ( e, 18 ) ^ ror64 ( e, 41 ) );
+		ch = ( ( e & f ) ^ ( (~e) & g ) );
+		t1 = ( h + s1 + ch + k[i] + w[i] );
+		h = g;
+		g = f;
+		f = e;
+		e = ( d + t1 );
+		d = c;
+		c = b;
+		b = a;
+		a = ( t1 + t2 );
+	}
+
+	/* Add chunk to hash */
+	context->h[0] += a;
+	context->h[1] += b;
+	context->h[2] += c;
+	context->h[3] += d;
+	context->h[4] += e;
+	context->h[5] += f;
+	context->h[6] += g;
+	context->h[7] += h;
+}
+
+/**
+ * Accumulate data with SHA-512 algorithm
+ *
+ * @v ctx		SHA-512 context
+ * @v data		Data
+ * @v len		Length of data
+ */
+static void sha512_update ( void *ctx, const void *data, size_t len ) {
+	struct sha512_context *context = ctx;
+	const uint8_t *byte = data;
+	size_t offset;
+	size_t frag_len;
+
+	while ( len ) {
+		offset = ( context->len % SHA512_BLOCK_SIZE );
+		frag_len = ( SHA512_BLOCK_SIZE - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( &context->block.byte[offset], byte, frag_len );
+		context->len += frag_len;
+		byte += frag_len;
+		len -= frag_len;
+		if ( ( context->len % SHA512_BLOCK_SIZE ) == 0 )
+			sha512_digest ( context );
+	}
+}
+
+/**
+ * Generate SHA-512 family digest
+ *
+ * @v ctx		SHA-512 context
+ * @v out		Output buffer
+ * @v digest_len	Length of digest
+ */
+static void sha512_family_final ( void *ctx, void *out, size_t digest_len ) {
+	struct sha512_context *context = ctx;
+	uint64_t len_bits[2];
+	static const uint8_t pad = 0x80;
+	static const uint8_t zero = 0x00;
+	uint64_t digest[8];
+	unsigned int i;
+
+	/* Pad message */
+	len_bits[0] = 0;
+	len_bits[1] = cpu_to_be64 ( context->len * 8 );
+	sha512_update ( ctx, &pad, sizeof ( pad ) );
+	while ( ( context->len % SHA512_BLOCK_SIZE ) !=
+		( SHA512_BLOCK_SIZE - sizeof ( len_bits ) ) ) {
+		sha512_update ( ctx, &zero, sizeof ( zero ) );
+	}
+	sha512_update ( ctx, len_bits, sizeof ( len_bits ) );
+	assert ( ( context->len % SHA512_BLOCK_SIZE ) == 0 );
+
+	/* Copy out final digest */
+	for ( i = 0 ; i < ( sizeof ( digest ) / sizeof ( digest[0] ) ) ; i++ )
+		digest[i] = cpu_to_be64 ( context->h[i] );
+	memcpy ( out, digest, digest_len );
+}
+
+/**
+ * Generate SHA-512 digest
+ *
+ * @v ctx		SHA-512 context
+ * @v out		Output buffer
+ */
+static void sha512_final ( void *ctx, void *out ) {
+	sha512_family_final ( ctx, out, SHA512_DIGEST_SIZE );
+}
+
+/**
+ * Generate SHA-384 digest
+ *
+ * @v ctx		SHA-512 context
+ * @v out		Output buffer
+ */
+static void sha384_final ( void *ctx, void *out ) {
+	sha512_family_final ( ctx, out, SHA384_DIGEST_SIZE );
+}
+
+/** SHA-512 algorithm */
+struct digest_algorithm sha512_algorithm = {
+	.name		= "sha512",
+	.ctxsize	= SHA512_CTX_SIZE,
+	.blocksize	= SHA512_BLOCK_SIZE,
+	.digestsize	= SHA512_DIGEST_SIZE,
+	.init		= sha512_init,
+	.update		= sha512_update,
+	.final		= sha512_final,
+};
+
+/** SHA-384 algorithm */
+struct digest_algorithm sha384_algorithm = {
+	.name		= "sha384",
+	.ctxsize	= SHA512_CTX_SIZE,
+	.blocksize	= SHA512_BLOCK_SIZE,
+	.digestsize	= SHA384_DIGEST_SIZE,
+	.init		= sha384_init,
+	.update		= sha512_update,
+	.final		= sha384_final,
+};
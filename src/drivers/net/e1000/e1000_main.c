@@ -337,6 +337,7 @@ static int e1000_refill_rx_ring ( struct e1000_adapter *adapter )
 
 		if ( ! iob ) {
 			DBG ( "alloc_iob failed\n" );
+			netdev_rx_alloc_fail ( adapter->netdev );
 			rc = -ENOMEM;
 			break;
 		} else {
@@ -593,6 +594,7 @@ static int e1000_transmit ( struct net_device *netdev, struct io_buffer *iobuf )
 
 	if ( adapter->tx_fill_ctr == NUM_TX_DESC ) {
 		DBG ("TX overflow\n");
+		netdev_tx_ring_full ( netdev );
 		return -ENOBUFS;
 	}
 
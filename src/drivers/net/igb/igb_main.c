@@ -417,6 +417,7 @@ static int igb_refill_rx_ring ( struct igb_adapter *adapter )
 
 		if ( ! iob ) {
 			DBG ( "alloc_iob failed\n" );
+			netdev_rx_alloc_fail ( adapter->netdev );
 			rc = -ENOMEM;
 			break;
 		} else {
@@ -678,6 +679,7 @@ static int igb_transmit ( struct net_device *netdev, struct io_buffer *iobuf )
 
 	if ( adapter->tx_fill_ctr == NUM_TX_DESC ) {
 		DBG ("TX overflow\n");
+		netdev_tx_ring_full ( netdev );
 		return -ENOBUFS;
 	}
 
@@ -150,8 +150,10 @@ static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 
 		/* Try to allocate a buffer, stop for now if out of memory */
 		iobuf = alloc_iob ( RX_BUF_SIZE );
-		if ( ! iobuf )
+		if ( ! iobuf ) {
+			netdev_rx_alloc_fail ( netdev );
 			break;
+		}
 
 		/* Keep track of iobuf so close() can free it */
 		list_add ( &iobuf->list, &virtnet->rx_iobufs );
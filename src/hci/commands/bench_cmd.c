@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdio.h>
+#include <getopt.h>
+#include <ipxe/command.h>
+
+/** @file
+ *
+ * Benchmark commands
+ *
+ */
+
+extern void aes_test ( void );
+extern void gcm_test ( void );
+extern void digest_test ( void );
+extern void modexp_test ( void );
+extern void bench_test ( void );
+
+/**
+ * "bench" command syntax message
+ *
+ * @v argv		Argument list
+ */
+static void bench_syntax ( char **argv ) {
+	printf ( "Usage:\n"
+		 "  %s\n"
+		 "\n"
+		 "Run crypto self-tests and data-path micro-benchmarks\n",
+		 argv[0] );
+}
+
+/**
+ * The "bench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int bench_exec ( int argc, char **argv ) {
+	static struct option longopts[] = {
+		{ "help", 0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c;
+
+	/* Parse options */
+	while ( ( c = getopt_long ( argc, argv, "h", longopts,
+				    NULL ) ) >= 0 ) {
+		switch ( c ) {
+		case 'h':
+			/* Display help text */
+		default:
+			/* Unrecognised/invalid option */
+			bench_syntax ( argv );
+			return 1;
+		}
+	}
+
+	/* Need no arguments */
+	if ( optind != argc ) {
+		bench_syntax ( argv );
+		return 1;
+	}
+
+	/* Check the implementations before timing them */
+	aes_test();
+	gcm_test();
+	digest_test();
+	modexp_test();
+	bench_test();
+
+	return 0;
+}
+
+/** Benchmark commands */
+struct command bench_commands[] __command = {
+	{
+		.name = "bench",
+		.exec = bench_exec,
+	},
+};
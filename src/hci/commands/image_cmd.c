@@ -24,8 +24,12 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <errno.h>
 #include <libgen.h>
 #include <getopt.h>
+#include <string.h>
 #include <ipxe/image.h>
 #include <ipxe/command.h>
+#include <ipxe/crypto.h>
+#include <ipxe/base16.h>
+#include <ipxe/sha256.h>
 #include <usr/imgmgmt.h>
 
 /** @file
@@ -74,6 +78,53 @@ static int imgfill_cmdline ( struct image *image, unsigned int nargs,
 	}
 }
 
+/** Length of the largest digest that may be used to verify an image */
+#define IMGFETCH_MAX_DIGEST_SIZE SHA256_DIGEST_SIZE
+
+/**
+ * Set expected image digest
+ *
+ * @v image		Image
+ * @v text		Expected digest, as "<algorithm>:<checksum>"
+ * @ret rc		Return status code
+ */
+static int imgfetch_set_digest ( struct image *image, const char *text ) {
+	struct image_digest *image_digest;
+	struct digest_algorithm *digest = NULL;
+	uint8_t value[IMGFETCH_MAX_DIGEST_SIZE];
+	const char *checksum;
+	size_t name_len;
+	int len;
+
+	/* Identify algorithm */
+	checksum = strchr ( text, ':' );
+	if ( ! checksum )
+		return -EINVAL;
+	name_len = ( checksum++ - text );
+	for_each_table_entry ( image_digest, IMAGE_DIGESTS ) {
+		if ( ( strlen ( image_digest->digest->name ) == name_len ) &&
+		     ( memcmp ( image_digest->digest->name, text,
+				name_len ) == 0 ) ) {
+			digest = image_digest->digest;
+			break;
+		}
+	}
+	if ( ! digest )
+		return -ENOTSUP;
+
+	/* Decode checksum */
+	if ( digest->digestsize > sizeof ( value ) )
+		return -ENOTSUP;
+	if ( base16_decoded_max_len ( checksum ) > digest->digestsize )
+		return -EINVAL;
+	len = base16_decode ( checksum, value );
+	if ( len < 0 )
+		return len;
+	if ( ( size_t ) len != digest->digestsize )
+		return -EINVAL;
+	return image_set_digest ( image, digest, value );
+}
+
 /**
  * "imgfetch"/"module"/"kernel" command syntax message
  *
@@ -87,9 +138,17 @@ static void imgfetch_core_syntax ( char **argv, enum image_action action ) {
 	};
 
 	printf ( "Usage:\n"
-		 "  %s [-n|--name <name>] filename [arguments...]\n"
+		 "  %s [-n|--name <name>] [-b|--background]\n"
+		 "      [-d|--digest <algorithm>:<checksum>] filename "
+		 "[arguments...]\n"
+		 "\n"
+		 "%s executable/loadable image\n"
 		 "\n"
-		 "%s executable/loadable image\n",
+		 "If a digest is given, the image is rejected unless its md5,\n"
+		 "sha1 or sha256 checksum matches.\n"
+		 "\n"
+		 "A background fetch returns immediately; use \"imgwait\" to\n"
+		 "wait for all background fetches to complete.\n",
 		 argv[0], actions[action] );
 }
 
@@ -108,23 +167,35 @@ static int imgfetch_core_exec ( struct image_type *image_type,
 	static struct option longopts[] = {
 		{ "help", 0, NULL, 'h' },
 		{ "name", required_argument, NULL, 'n' },
+		{ "digest", required_argument, NULL, 'd' },
+		{ "background", 0, NULL, 'b' },
 		{ NULL, 0, NULL, 0 },
 	};
 	struct image *image;
 	const char *name = NULL;
+	const char *digest = NULL;
+	int background = 0;
 	char *filename;
 	int ( * image_register ) ( struct image *image );
 	int c;
 	int rc;
 
 	/* Parse options */
-	while ( ( c = getopt_long ( argc, argv, "hn:",
+	while ( ( c = getopt_long ( argc, argv, "hn:d:b",
 				    longopts, NULL ) ) >= 0 ) {
 		switch ( c ) {
+		case 'b':
+			/* Fetch in background */
+			background = 1;
+			break;
 		case 'n':
 			/* Set image name */
 			name = optarg;
 			break;
+		case 'd':
+			/* Set expected digest */
+			digest = optarg;
+			break;
 		case 'h':
 			/* Display help text */
 		default:
@@ -159,6 +230,16 @@ static int imgfetch_core_exec ( struct image_type *image_type,
 	/* Set image type (if specified) */
 	image->type = image_type;
 
+	/* Set expected digest (if specified) */
+	if ( digest ) {
+		if ( ( rc = imgfetch_set_digest ( image, digest ) ) != 0 ) {
+			printf ( "Invalid digest \"%s\": %s\n",
+				 digest, strerror ( rc ) );
+			image_put ( image );
+			return rc;
+		}
+	}
+
 	/* Fill in command line */
 	if ( ( rc = imgfill_cmdline ( image, ( argc - optind ),
 				      &argv[optind] ) ) != 0 )
@@ -179,7 +260,12 @@ static int imgfetch_core_exec ( struct image_type *image_type,
 		assert ( 0 );
 		return -EINVAL;
 	}
-	if ( ( rc = imgfetch ( image, filename, image_register ) ) != 0 ) {
+	if ( background ) {
+		rc = imgfetch_background ( image, filename, image_register );
+	} else {
+		rc = imgfetch ( image, filename, image_register );
+	}
+	if ( rc != 0 ) {
 		printf ( "Could not fetch %s: %s\n",
 			 filename, strerror ( rc ) );
 		image_put ( image );
@@ -559,6 +645,58 @@ static int imgfree_exec ( int argc, char **argv ) {
 	return 0;
 }
 
+/**
+ * "imgwait" command syntax message
+ *
+ * @v argv		Argument list
+ */
+static void imgwait_syntax ( char **argv ) {
+	printf ( "Usage:\n"
+		 "  %s\n"
+		 "\n"
+		 "Wait for all background image fetches to complete\n",
+		 argv[0] );
+}
+
+/**
+ * The "imgwait" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int imgwait_exec ( int argc, char **argv ) {
+	static struct option longopts[] = {
+		{ "help", 0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int c;
+	int rc;
+
+	/* Parse options */
+	while ( ( c = getopt_long ( argc, argv, "h", longopts, NULL ) ) >= 0 ){
+		switch ( c ) {
+		case 'h':
+			/* Display help text */
+		default:
+			/* Unrecognised/invalid option */
+			imgwait_syntax ( argv );
+			return 1;
+		}
+	}
+
+	/* Need no arguments */
+	if ( optind != argc ) {
+		imgwait_syntax ( argv );
+		return 1;
+	}
+
+	if ( ( rc = imgwait() ) != 0 )
+		return rc;
+
+	return 0;
+}
+
 /** Image management commands */
 struct command image_commands[] __command = {
 	{
@@ -605,4 +743,8 @@ struct command image_commands[] __command = {
 		.name = "imgfree",
 		.exec = imgfree_exec,
 	},
+	{
+		.name = "imgwait",
+		.exec = imgwait_exec,
+	},
 };
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdio.h>
+#include <getopt.h>
+#include <byteswap.h>
+#include <ipxe/in.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcp.h>
+#include <ipxe/command.h>
+
+/** @file
+ *
+ * TCP statistics commands
+ *
+ */
+
+/**
+ * "tcpstat" command syntax message
+ *
+ * @v argv		Argument list
+ */
+static void tcpstat_syntax ( char **argv ) {
+	printf ( "Usage:\n"
+		 "  %s\n"
+		 "\n"
+		 "Show TCP connection statistics\n",
+		 argv[0] );
+}
+
+/**
+ * Show TCP connection statistics
+ *
+ * @v stats		TCP connection statistics
+ */
+static void tcpstat_show ( struct tcp_statistics *stats ) {
+	struct sockaddr_in *sin = ( struct sockaddr_in * ) &stats->peer;
+
+	printf ( "TCP %d -> ", stats->local_port );
+	if ( sin->sin_family == AF_INET ) {
+		printf ( "%s", inet_ntoa ( sin->sin_addr ) );
+	} else {
+		printf ( "<unknown>" );
+	}
+	printf ( ":%d %s rtt %ldms\n", ntohs ( sin->sin_port ), stats->state,
+		 ( ( stats->rtt * 1000 ) / TICKS_PER_SEC ) );
+	printf ( "  TX:%ld TXB:%ld RETX:%ld STALL:%ld\n",
+		 stats->tx_segments, stats->tx_bytes, stats->retransmits,
+		 stats->tx_stalls );
+	printf ( "  RX:%ld RXB:%ld DUPACK:%ld OOO:%ld DROP:%ld STALL:%ld\n",
+		 stats->rx_segments, stats->rx_bytes, stats->dup_acks,
+		 stats->rx_ooo, stats->rx_drops, stats->rx_stalls );
+}
+
+/**
+ * The "tcpstat" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int tcpstat_exec ( int argc, char **argv ) {
+	static struct option longopts[] = {
+		{ "help", 0, NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+	struct tcp_statistics stats;
+	unsigned int i;
+	int c;
+
+	/* Parse options */
+	while ( ( c = getopt_long ( argc, argv, "h", longopts,
+				    NULL ) ) >= 0 ) {
+		switch ( c ) {
+		case 'h':
+			/* Display help text */
+		default:
+			/* Unrecognised/invalid option */
+			tcpstat_syntax ( argv );
+			return 1;
+		}
+	}
+
+	/* Need no arguments */
+	if ( optind != argc ) {
+		tcpstat_syntax ( argv );
+		return 1;
+	}
+
+	/* Show statistics for open and recently closed connections */
+	for ( i = 0 ; tcp_stat ( i, &stats ) == 0 ; i++ )
+		tcpstat_show ( &stats );
+
+	return 0;
+}
+
+/** TCP statistics commands */
+struct command tcpstat_commands[] __command = {
+	{
+		.name = "tcpstat",
+		.exec = tcpstat_exec,
+	},
+};
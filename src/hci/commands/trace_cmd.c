@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdio.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <ipxe/command.h>
+#include <ipxe/process.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Boot timeline trace commands
+ *
+ */
+
+/**
+ * Time allowed for console output to drain after each event (in ms)
+ *
+ * At 115200bps this is enough to send a typical event line, so that a
+ * full trace does not overrun the serial console's transmit buffer.
+ */
+#define TRACE_DRAIN_MS 10
+
+/**
+ * "trace" command syntax message
+ *
+ * @v argv		Argument list
+ */
+static void trace_syntax ( char **argv ) {
+	printf ( "Usage:\n"
+		 "  %s [-j|--json] [-c|--clear]\n"
+		 "\n"
+		 "Show boot timeline trace (as CSV, or as JSON)\n",
+		 argv[0] );
+}
+
+/**
+ * Print string as JSON string literal
+ *
+ * @v string		String
+ */
+static void trace_json_string ( const char *string ) {
+	char c;
+
+	printf ( "\"" );
+	while ( ( c = *(string++) ) ) {
+		if ( ( c == '"' ) || ( c == '\\' ) ) {
+			printf ( "\\%c", c );
+		} else if ( ( c >= ' ' ) && ( c <= '~' ) ) {
+			printf ( "%c", c );
+		}
+	}
+	printf ( "\"" );
+}
+
+/**
+ * Print string as quoted CSV field
+ *
+ * @v string		String
+ */
+static void trace_csv_string ( const char *string ) {
+	char c;
+
+	printf ( "\"" );
+	while ( ( c = *(string++) ) ) {
+		if ( c == '"' ) {
+			printf ( "\"\"" );
+		} else if ( ( c >= ' ' ) && ( c <= '~' ) ) {
+			printf ( "%c", c );
+		}
+	}
+	printf ( "\"" );
+}
+
+/**
+ * Allow pending console output to drain
+ *
+ * The serial console buffers its output and drops characters when
+ * the buffer is full, so run the process scheduler for a short while
+ * after printing each event.
+ */
+static void trace_drain ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < TRACE_DRAIN_MS ; i++ ) {
+		trace_drain();
+		mdelay ( 1 );
+	}
+}
+
+/**
+ * Show boot timeline trace as CSV
+ *
+ */
+static void trace_csv ( void ) {
+	struct trace_event *event;
+	unsigned int i;
+
+	printf ( "index,tsc,ms,type,subject,value\n" );
+	for ( i = 0 ; ( event = trace_event ( i ) ) ; i++ ) {
+		printf ( "%u,%#llx,%lu,%s,", i, event->tsc,
+			 trace_ms ( event ), event->type );
+		trace_csv_string ( event->subject );
+		printf ( ",%ld\n", event->value );
+		trace_drain();
+	}
+}
+
+/**
+ * Show boot timeline trace as JSON
+ *
+ */
+static void trace_json ( void ) {
+	struct trace_event *event;
+	unsigned int i;
+
+	printf ( "{\"dropped\":%u,\"events\":[", trace_dropped() );
+	for ( i = 0 ; ( event = trace_event ( i ) ) ; i++ ) {
+		printf ( "%s\n{\"tsc\":\"%#llx\",\"ms\":%lu,\"type\":",
+			 ( i ? "," : "" ), event->tsc, trace_ms ( event ) );
+		trace_json_string ( event->type );
+		printf ( ",\"subject\":" );
+		trace_json_string ( event->subject );
+		printf ( ",\"value\":%ld}", event->value );
+		trace_drain();
+	}
+	printf ( "]}\n" );
+}
+
+/**
+ * The "trace" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Exit code
+ */
+static int trace_exec ( int argc, char **argv ) {
+	static struct option longopts[] = {
+		{ "help", 0, NULL, 'h' },
+		{ "json", 0, NULL, 'j' },
+		{ "clear", 0, NULL, 'c' },
+		{ NULL, 0, NULL, 0 },
+	};
+	int json = 0;
+	int clear = 0;
+	int c;
+
+	/* Parse options */
+	while ( ( c = getopt_long ( argc, argv, "hjc", longopts,
+				    NULL ) ) >= 0 ) {
+		switch ( c ) {
+		case 'j':
+			json = 1;
+			break;
+		case 'c':
+			clear = 1;
+			break;
+		case 'h':
+			/* Display help text */
+		default:
+			/* Unrecognised/invalid option */
+			trace_syntax ( argv );
+			return 1;
+		}
+	}
+
+	/* Need no arguments */
+	if ( optind != argc ) {
+		trace_syntax ( argv );
+		return 1;
+	}
+
+	/* Clear or show trace */
+	if ( clear ) {
+		trace_clear();
+	} else if ( json ) {
+		trace_json();
+	} else {
+		trace_csv();
+	}
+
+	return 0;
+}
+
+/** Boot timeline trace commands */
+struct command trace_commands[] __command = {
+	{
+		.name = "trace",
+		.exec = trace_exec,
+	},
+};
@@ -1,28 +1,141 @@
 #ifndef _IPXE_AES_H
 #define _IPXE_AES_H
 
+/** @file
+ *
+ * AES algorithm
+ *
+ */
+
 FILE_LICENCE ( GPL2_OR_LATER );
 
+#include <stdint.h>
+#include <stddef.h>
+#include <ipxe/tables.h>
+
 struct cipher_algorithm;
 
 /** Basic AES blocksize */
 #define AES_BLOCKSIZE 16
 
-#include "crypto/axtls/crypto.h"
+/** Maximum number of AES rounds (for 256-bit keys) */
+#define AES_MAX_ROUNDS 14
+
+/** AES round keys */
+struct aes_round_keys {
+	/** Round keys
+	 *
+	 * The generic engine stores each round key as four
+	 * host-endian words; an engine's prepare() method may convert
+	 * these into whatever layout it requires.
+	 */
+	uint32_t key[ ( AES_MAX_ROUNDS + 1 ) * 4 ];
+};
 
 /** AES context */
 struct aes_context {
-	/** AES context for AXTLS */
-	AES_CTX axtls_ctx;
-	/** Cipher is being used for decrypting */
-	int decrypting;
+	/** Encryption round keys */
+	struct aes_round_keys encrypt;
+	/** Decryption round keys (for the equivalent inverse cipher) */
+	struct aes_round_keys decrypt;
+	/** Number of rounds */
+	unsigned int rounds;
+	/** AES engine */
+	struct aes_engine *engine;
 };
 
 /** AES context size */
 #define AES_CTX_SIZE sizeof ( struct aes_context )
 
+/** AES context with cipher-block chaining */
+struct aes_cbc_context {
+	/** AES context */
+	struct aes_context aes;
+	/** Chaining value */
+	uint8_t iv[AES_BLOCKSIZE];
+};
+
+/** An AES engine */
+struct aes_engine {
+	/** Engine name */
+	const char *name;
+	/** Check if engine can be used on this CPU
+	 *
+	 * @ret supported	Engine is supported
+	 *
+	 * May be NULL, if the engine is always usable.
+	 */
+	int ( * supported ) ( void );
+	/** Prepare expanded round keys for use by this engine
+	 *
+	 * @v aes		AES context
+	 *
+	 * May be NULL, if the engine uses the generic key layout.
+	 */
+	void ( * prepare ) ( struct aes_context *aes );
+	/** Encrypt data in electronic codebook mode
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to encrypt
+	 * @v dst		Buffer for encrypted data
+	 * @v len		Length of data (a multiple of AES_BLOCKSIZE)
+	 */
+	void ( * encrypt ) ( struct aes_context *aes, const void *src,
+			     void *dst, size_t len );
+	/** Decrypt data in electronic codebook mode
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to decrypt
+	 * @v dst		Buffer for decrypted data
+	 * @v len		Length of data (a multiple of AES_BLOCKSIZE)
+	 */
+	void ( * decrypt ) ( struct aes_context *aes, const void *src,
+			     void *dst, size_t len );
+	/** Encrypt data in cipher-block chaining mode
+	 *
+	 * @v aes		AES context
+	 * @v iv		Chaining value (updated on return)
+	 * @v src		Data to encrypt
+	 * @v dst		Buffer for encrypted data
+	 * @v len		Length of data (a multiple of AES_BLOCKSIZE)
+	 */
+	void ( * cbc_encrypt ) ( struct aes_context *aes, void *iv,
+				 const void *src, void *dst, size_t len );
+	/** Decrypt data in cipher-block chaining mode
+	 *
+	 * @v aes		AES context
+	 * @v iv		Chaining value (updated on return)
+	 * @v src		Data to decrypt
+	 * @v dst		Buffer for decrypted data
+	 * @v len		Length of data (a multiple of AES_BLOCKSIZE)
+	 *
+	 * @c src and @c dst may be identical, but must not otherwise
+	 * overlap.
+	 */
+	void ( * cbc_decrypt ) ( struct aes_context *aes, void *iv,
+				 const void *src, void *dst, size_t len );
+};
+
+/** AES engine table */
+#define AES_ENGINES __table ( struct aes_engine, "aes_engines" )
+
+/** Declare an AES engine */
+#define __aes_engine( engine_order ) __table_entry ( AES_ENGINES, engine_order )
+
+/** Hardware-accelerated AES engine priority */
+#define AES_ENGINE_ACCELERATED 01
+
+/** Generic AES engine priority */
+#define AES_ENGINE_GENERIC 02
+
+extern struct aes_engine aes_generic_engine;
 extern struct cipher_algorithm aes_algorithm;
 extern struct cipher_algorithm aes_cbc_algorithm;
+extern struct cipher_algorithm aes_gcm_algorithm;
+
+extern int aes_engine_setkey ( struct aes_context *aes,
+			       struct aes_engine *engine,
+			       const void *key, size_t keylen );
 
 int aes_wrap ( const void *kek, const void *src, void *dest, int nblk );
 int aes_unwrap ( const void *kek, const void *src, void *dest, int nblk );
@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <ipxe/tables.h>
 
+struct io_buffer;
 struct net_device;
 struct net_protocol;
 
@@ -37,10 +38,8 @@ struct arp_net_protocol {
 
 extern struct net_protocol arp_protocol;
 
-extern int arp_resolve ( struct net_device *netdev,
-			 struct net_protocol *net_protocol,
-			 const void *dest_net_addr,
-			 const void *source_net_addr,
-			 void *dest_ll_addr );
+extern int arp_tx ( struct io_buffer *iobuf, struct net_device *netdev,
+		    struct net_protocol *net_protocol, const void *net_dest,
+		    const void *net_source );
 
 #endif /* _IPXE_ARP_H */
@@ -49,5 +49,7 @@ struct cpio_header {
 #define CPIO_MAGIC "070701"
 
 extern void cpio_set_field ( char *field, unsigned long value );
+extern size_t cpio_header_len ( const char *name );
+extern void cpio_header ( const char *name, size_t len, void *data );
 
 #endif /* _IPXE_CPIO_H */
@@ -343,6 +343,36 @@ struct dhcp_netdev_desc {
  */
 #define DHCP_EB_USE_CACHED DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xb2 )
 
+/** Persist DHCP lease
+ *
+ * If set to a non-zero value, the address obtained via DHCP (and the
+ * ProxyDHCP server used, if any) will be recorded in the network
+ * device's non-volatile stored options.  Subsequent boots will then
+ * attempt to reacquire the same address via an INIT-REBOOT
+ * DHCPREQUEST, skipping the DHCPDISCOVER and ProxyDHCP phases.
+ */
+#define DHCP_EB_PERSIST_LEASE DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xb3 )
+
+/** Persisted DHCP lease address
+ *
+ * This is written automatically when DHCP_EB_PERSIST_LEASE is set.
+ */
+#define DHCP_EB_LEASE_ADDRESS DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xb4 )
+
+/** Persisted ProxyDHCP server address
+ *
+ * This is written automatically when DHCP_EB_PERSIST_LEASE is set.
+ */
+#define DHCP_EB_LEASE_PROXY DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xb5 )
+
+/** Append boot timeline trace to kernel command line
+ *
+ * If set to a non-zero value, a compact summary of the boot timeline
+ * trace will be appended to a Linux kernel's command line as
+ * "ipxe.trace=<type>@<ms>,...".
+ */
+#define DHCP_EB_TRACE_CMDLINE DHCP_ENCAP_OPT ( DHCP_EB_ENCAP, 0xb6 )
+
 /** BIOS drive number
  *
  * This is the drive number for a drive emulated via INT 13.  0x80 is
@@ -603,6 +633,9 @@ struct dhcphdr {
 /** Maximum time that we will wait for Boot Server responses */
 #define PXEBS_MAX_TIMEOUT ( 3 * TICKS_PER_SEC )
 
+/** Maximum time that we will wait to reacquire a persisted lease */
+#define DHCP_REBOOT_MAX_TIMEOUT ( 2 * TICKS_PER_SEC )
+
 /** Settings block name used for DHCP responses */
 #define DHCP_SETTINGS_NAME "dhcp"
 
@@ -625,6 +658,9 @@ extern int dhcp_create_request ( struct dhcp_packet *dhcppkt,
 extern int start_dhcp ( struct interface *job, struct net_device *netdev );
 extern int start_pxebs ( struct interface *job, struct net_device *netdev,
 			 unsigned int pxe_type );
+extern struct settings * dhcp_pxe_settings ( struct net_device *netdev,
+					     const char *name );
+extern void dhcp_pxe_unregister ( struct net_device *netdev );
 
 /* In environments that can provide cached DHCP packets, this function
  * should look for such a packet and call store_cached_dhcpack() with
@@ -19,6 +19,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define DNS_TYPE_A		1
 #define DNS_TYPE_CNAME		5
+#define DNS_TYPE_SOA		6
 #define DNS_TYPE_ANY		255
 
 #define DNS_CLASS_IN		1
@@ -42,6 +43,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define	DNS_PORT		53
 #define	DNS_MAX_RETRIES		3
 #define	DNS_MAX_CNAME_RECURSION	0x30
+#define	DNS_MAX_SERVERS		4
 
 /*
  * DNS protocol structures
@@ -83,6 +85,14 @@ struct dns_rr_info_cname {
 	char cname[0];
 } __attribute__ (( packed ));
 
+struct dns_rr_info_soa_tail {
+	uint32_t	serial;
+	uint32_t	refresh;
+	uint32_t	retry;
+	uint32_t	expire;
+	uint32_t	minimum;
+} __attribute__ (( packed ));
+
 union dns_rr_info {
 	struct dns_rr_info_common common;
 	struct dns_rr_info_a a;
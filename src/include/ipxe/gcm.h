@@ -0,0 +1,181 @@
+#ifndef _IPXE_GCM_H
+#define _IPXE_GCM_H
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <ipxe/tables.h>
+#include <ipxe/crypto.h>
+
+/** GCM block size (of the underlying block cipher) */
+#define GCM_BLOCKSIZE 16
+
+/** GCM initialisation vector length
+ *
+ * We support only the 96-bit IVs recommended by SP800-38D (and used
+ * by all TLS cipher suites).
+ */
+#define GCM_IV_LEN 12
+
+/** GCM authentication tag length */
+#define GCM_AUTH_LEN 16
+
+/** A GCM block */
+union gcm_block {
+	uint8_t byte[GCM_BLOCKSIZE];
+	uint32_t dword[ GCM_BLOCKSIZE / sizeof ( uint32_t ) ];
+	uint64_t qword[ GCM_BLOCKSIZE / sizeof ( uint64_t ) ];
+};
+
+/** GCM context */
+struct gcm_context {
+	/** Hash subkey H (in byte order) */
+	union gcm_block key;
+	/** Multiples of H by each 4-bit value
+	 *
+	 * Used only by the generic GHASH engine.  Each entry holds
+	 * the high and low halves as host-endian quadwords.
+	 */
+	union gcm_block table[16];
+	/** Accumulated hash (in byte order) */
+	union gcm_block hash;
+	/** Pre-counter block J0 */
+	union gcm_block j0;
+	/** Current counter block */
+	union gcm_block ctr;
+	/** Length of additional data */
+	uint64_t aad_len;
+	/** Length of encrypted data */
+	uint64_t len;
+	/** GHASH engine */
+	struct ghash_engine *engine;
+};
+
+/** A GHASH engine */
+struct ghash_engine {
+	/** Engine name */
+	const char *name;
+	/** Check if engine can be used on this CPU
+	 *
+	 * @ret supported	Engine is supported
+	 *
+	 * May be NULL, if the engine is always usable.
+	 */
+	int ( * supported ) ( void );
+	/** Precompute any key-dependent tables
+	 *
+	 * @v gcm		GCM context
+	 *
+	 * May be NULL, if the engine needs only the hash subkey.
+	 */
+	void ( * prepare ) ( struct gcm_context *gcm );
+	/** Accumulate data into hash
+	 *
+	 * @v gcm		GCM context
+	 * @v data		Data
+	 * @v len		Length of data (a multiple of GCM_BLOCKSIZE)
+	 */
+	void ( * update ) ( struct gcm_context *gcm, const void *data,
+			    size_t len );
+};
+
+/** GHASH engine table */
+#define GHASH_ENGINES __table ( struct ghash_engine, "ghash_engines" )
+
+/** Declare a GHASH engine */
+#define __ghash_engine( engine_order ) \
+	__table_entry ( GHASH_ENGINES, engine_order )
+
+/** Hardware-accelerated GHASH engine priority */
+#define GHASH_ENGINE_ACCELERATED 01
+
+/** Generic GHASH engine priority */
+#define GHASH_ENGINE_GENERIC 02
+
+extern struct ghash_engine ghash_generic_engine;
+
+extern int gcm_setkey ( struct gcm_context *gcm, const void *key,
+			size_t keylen, struct cipher_algorithm *raw_cipher,
+			void *raw_ctx );
+extern void gcm_setiv ( struct gcm_context *gcm, const void *iv );
+extern void gcm_encrypt ( struct gcm_context *gcm, const void *src,
+			  void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern void gcm_decrypt ( struct gcm_context *gcm, const void *src,
+			  void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern void gcm_auth ( struct gcm_context *gcm, void *auth,
+		       struct cipher_algorithm *raw_cipher, void *raw_ctx );
+extern int gcm_engine_setkey ( struct gcm_context *gcm,
+			       struct ghash_engine *engine, const void *key,
+			       size_t keylen,
+			       struct cipher_algorithm *raw_cipher,
+			       void *raw_ctx );
+
+/**
+ * Create a GCM mode of behaviour of an existing cipher
+ *
+ * @v _gcm_name		Name for the new GCM cipher
+ * @v _gcm_cipher	New cipher algorithm
+ * @v _raw_cipher	Underlying cipher algorithm
+ * @v _raw_context	Context structure for the underlying cipher
+ *
+ * The underlying cipher must have a 16-byte block size.  The
+ * resulting cipher takes a GCM_IV_LEN-byte initialisation vector,
+ * which must be set before each message.  Additional data (if any)
+ * must be supplied via a single call to encrypt() or decrypt() with
+ * a NULL destination, before any data is processed.  Data may be
+ * supplied in several calls, but only the last may have a length
+ * that is not a multiple of GCM_BLOCKSIZE.
+ */
+#define GCM_CIPHER( _gcm_name, _gcm_cipher, _raw_cipher, _raw_context )	\
+struct _gcm_name ## _context {						\
+	_raw_context raw_ctx;						\
+	struct gcm_context gcm;						\
+};									\
+static int _gcm_name ## _setkey ( void *ctx, const void *key,		\
+				  size_t keylen ) {			\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	return gcm_setkey ( &_gcm_name ## _ctx->gcm, key, keylen,	\
+			    &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _setiv ( void *ctx, const void *iv ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_setiv ( &_gcm_name ## _ctx->gcm, iv );			\
+}									\
+static void _gcm_name ## _encrypt ( void *ctx, const void *src,	\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_encrypt ( &_gcm_name ## _ctx->gcm, src, dst, len,		\
+		      &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _decrypt ( void *ctx, const void *src,	\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_decrypt ( &_gcm_name ## _ctx->gcm, src, dst, len,		\
+		      &_raw_cipher, &_gcm_name ## _ctx->raw_ctx );	\
+}									\
+static void _gcm_name ## _auth ( void *ctx, void *auth ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_auth ( &_gcm_name ## _ctx->gcm, auth, &_raw_cipher,		\
+		   &_gcm_name ## _ctx->raw_ctx );			\
+}									\
+struct cipher_algorithm _gcm_cipher = {					\
+	.name		= #_gcm_name,					\
+	.ctxsize	= sizeof ( struct _gcm_name ## _context ),	\
+	.blocksize	= 1,						\
+	.authsize	= GCM_AUTH_LEN,					\
+	.setkey		= _gcm_name ## _setkey,				\
+	.setiv		= _gcm_name ## _setiv,				\
+	.encrypt	= _gcm_name ## _encrypt,			\
+	.decrypt	= _gcm_name ## _decrypt,			\
+	.auth		= _gcm_name ## _auth,				\
+};
+
+#endif /* _IPXE_GCM_H */
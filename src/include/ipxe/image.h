@@ -17,6 +17,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 struct uri;
 struct image_type;
+struct digest_algorithm;
 
 /** An executable or loadable image */
 struct image {
@@ -39,6 +40,22 @@ struct image {
 	userptr_t data;
 	/** Length of raw file image */
 	size_t len;
+	/** Space reserved immediately before raw file image
+	 *
+	 * An image type may use this space to prepend a header to
+	 * the image in situ (e.g. a cpio header for a Linux initrd),
+	 * rather than copying the whole image elsewhere.
+	 */
+	size_t headroom;
+
+	/** Expected digest algorithm, or NULL
+	 *
+	 * If set, the downloader will refuse to register an image
+	 * whose contents do not match the expected digest value.
+	 */
+	struct digest_algorithm *digest;
+	/** Expected digest value */
+	void *digest_value;
 
 	/** Image type, if known */
 	struct image_type *type;
@@ -131,6 +148,18 @@ struct image_type {
 /** An executable or loadable image type */
 #define __image_type( probe_order ) __table_entry ( IMAGE_TYPES, probe_order )
 
+/** A digest algorithm usable for verifying downloaded images */
+struct image_digest {
+	/** Digest algorithm */
+	struct digest_algorithm *digest;
+};
+
+/** Image verification digest algorithm table */
+#define IMAGE_DIGESTS __table ( struct image_digest, "image_digests" )
+
+/** Declare an image verification digest algorithm */
+#define __image_digest __table_entry ( IMAGE_DIGESTS, 01 )
+
 extern struct list_head images;
 
 /** Iterate over all registered images */
@@ -149,6 +178,9 @@ static inline int have_images ( void ) {
 extern struct image * alloc_image ( void );
 extern int image_set_uri ( struct image *image, struct uri *uri );
 extern int image_set_cmdline ( struct image *image, const char *cmdline );
+extern int image_set_digest ( struct image *image,
+			      struct digest_algorithm *digest,
+			      const void *value );
 extern int register_image ( struct image *image );
 extern void unregister_image ( struct image *image );
 extern void promote_image ( struct image *image );
@@ -32,8 +32,11 @@ struct net_protocol;
 #define IP_TOS		0
 #define IP_TTL		64
 
-#define IP_FRAG_IOB_SIZE	1500
-#define IP_FRAG_TIMEOUT		50
+/** Fragment reassembly timeout */
+#define IP_FRAG_TIMEOUT		( 2 * TICKS_PER_SEC )
+
+/** Maximum length of a reassembled IPv4 payload */
+#define IP_MAX_PAYLOAD		( 0xffff - sizeof ( struct iphdr ) )
 
 /** An IPv4 packet header */
 struct iphdr {
@@ -74,20 +77,53 @@ struct ipv4_miniroute {
 	struct in_addr gateway;
 };
 
-/* Fragment reassembly buffer */
-struct frag_buffer {
-	/* Identification number */
-	uint16_t ident;
-	/* Source network address */
+/** A hole in a partially reassembled IPv4 datagram
+ *
+ * As described in RFC 815, each hole descriptor is stored within the
+ * hole itself, in the reassembly buffer.  All offsets are relative
+ * to the start of the reassembled payload.
+ */
+struct ipv4_hole {
+	/** Offset of first byte in hole */
+	uint16_t first;
+	/** Offset of last byte in hole, or IP_HOLE_INFINITY */
+	uint16_t last;
+	/** Offset of next hole descriptor, or IP_HOLE_NONE */
+	uint16_t next;
+} __attribute__ (( packed ));
+
+/** Last byte of a hole extending to the (as yet unknown) end */
+#define IP_HOLE_INFINITY	0xffffU
+
+/** Terminator for list of holes */
+#define IP_HOLE_NONE		0xffffU
+
+/** A partially reassembled IPv4 datagram */
+struct ipv4_fragment {
+	/** List of partially reassembled datagrams */
+	struct list_head list;
+	/** Source address */
 	struct in_addr src;
-	/* Destination network address */
+	/** Destination address */
 	struct in_addr dest;
-	/* Reassembled I/O buffer */
-	struct io_buffer *frag_iob;
-	/* Reassembly timer */
-	struct retry_timer frag_timer;
-	/* List of fragment reassembly buffers */
-	struct list_head list;
+	/** Identification */
+	uint16_t ident;
+	/** Protocol */
+	uint8_t protocol;
+	/** Reassembly buffer
+	 *
+	 * This holds an IPv4 header followed by @c size bytes of
+	 * payload space.
+	 */
+	struct io_buffer *iobuf;
+	/** Size of payload space in reassembly buffer */
+	size_t size;
+	/** Offset of first hole descriptor, or IP_HOLE_NONE */
+	uint16_t hole;
+	/** Total payload length, or zero if not yet known */
+	size_t len;
+	/** Reassembly timer */
+	struct retry_timer timer;
 };
 
 extern struct list_head ipv4_miniroutes;
@@ -0,0 +1,52 @@
+#ifndef _IPXE_MODEXP_H
+#define _IPXE_MODEXP_H
+
+/** @file
+ *
+ * Modular exponentiation
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Limb size (in bits)
+ *
+ * This may be overridden at build time (e.g. by adding
+ * "-DMODEXP_LIMB_BITS=32" to EXTRA_CFLAGS).  64-bit limbs require
+ * the compiler to provide a 128-bit integer type for the
+ * double-width product, and so are available only on 64-bit builds.
+ */
+#ifndef MODEXP_LIMB_BITS
+#ifdef __SIZEOF_INT128__
+#define MODEXP_LIMB_BITS 64
+#else
+#define MODEXP_LIMB_BITS 32
+#endif
+#endif
+
+#if MODEXP_LIMB_BITS == 64
+#ifndef __SIZEOF_INT128__
+#error "64-bit modular exponentiation limbs require a 128-bit integer type"
+#endif
+/** A limb */
+typedef uint64_t modexp_limb_t;
+/** A double-width limb */
+typedef unsigned __int128 modexp_dlimb_t;
+#elif MODEXP_LIMB_BITS == 32
+/** A limb */
+typedef uint32_t modexp_limb_t;
+/** A double-width limb */
+typedef uint64_t modexp_dlimb_t;
+#else
+#error "Unsupported modular exponentiation limb size"
+#endif
+
+extern int modexp ( const void *modulus, size_t modulus_len,
+		    const void *base, size_t base_len,
+		    const void *exponent, size_t exponent_len,
+		    void *result );
+
+#endif /* _IPXE_MODEXP_H */
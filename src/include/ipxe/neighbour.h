@@ -0,0 +1,69 @@
+#ifndef _IPXE_NEIGHBOUR_H
+#define _IPXE_NEIGHBOUR_H
+
+/** @file
+ *
+ * Neighbour discovery
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <ipxe/list.h>
+
+struct io_buffer;
+struct net_device;
+struct net_protocol;
+
+/** Number of hash buckets in a neighbour table
+ *
+ * Must be a power of two.
+ */
+#define NEIGHBOUR_BUCKETS 16
+
+/** A neighbour discovery protocol */
+struct neighbour_discovery {
+	/** Name */
+	const char *name;
+	/** Transmit neighbour discovery request
+	 *
+	 * @v netdev		Network device
+	 * @v net_protocol	Network-layer protocol
+	 * @v net_dest		Destination network-layer address
+	 * @v net_source	Source network-layer address
+	 * @ret rc		Return status code
+	 */
+	int ( * tx_request ) ( struct net_device *netdev,
+			       struct net_protocol *net_protocol,
+			       const void *net_dest, const void *net_source );
+};
+
+/** A neighbour table
+ *
+ * Each network device has its own neighbour table, shared by all
+ * network-layer protocols on that device.
+ */
+struct neighbour_table {
+	/** Hash buckets */
+	struct list_head buckets[NEIGHBOUR_BUCKETS];
+	/** List of entries, most recently used first */
+	struct list_head lru;
+	/** Number of entries */
+	unsigned int count;
+};
+
+extern void neighbour_init ( struct neighbour_table *table );
+extern int neighbour_tx ( struct io_buffer *iobuf, struct net_device *netdev,
+			  struct net_protocol *net_protocol,
+			  const void *net_dest,
+			  struct neighbour_discovery *discovery,
+			  const void *net_source );
+extern int neighbour_update ( struct net_device *netdev,
+			      struct net_protocol *net_protocol,
+			      const void *net_dest, const void *ll_dest );
+extern int neighbour_define ( struct net_device *netdev,
+			      struct net_protocol *net_protocol,
+			      const void *net_dest, const void *ll_dest );
+extern void neighbour_flush ( struct net_device *netdev );
+
+#endif /* _IPXE_NEIGHBOUR_H */
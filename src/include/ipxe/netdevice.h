@@ -14,6 +14,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/tables.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/settings.h>
+#include <ipxe/neighbour.h>
 
 struct io_buffer;
 struct net_device;
@@ -43,7 +44,7 @@ struct device;
 #define MAX_LL_HEADER_LEN 32
 
 /** Maximum length of a network-layer address */
-#define MAX_NET_ADDR_LEN 4
+#define MAX_NET_ADDR_LEN 16
 
 /**
  * A network-layer protocol
@@ -249,6 +250,50 @@ struct net_device_stats {
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
 
+/** Network device performance counters */
+struct net_device_perf {
+	/** Number of bytes transmitted successfully */
+	unsigned long tx_bytes;
+	/** Number of bytes received */
+	unsigned long rx_bytes;
+	/** Number of transmissions rejected due to a full TX ring */
+	unsigned int tx_ring_full;
+	/** Number of failures to allocate an RX buffer */
+	unsigned int rx_alloc_fail;
+	/** Current depth of TX queue */
+	unsigned int tx_queue_len;
+	/** High-water mark of TX queue depth */
+	unsigned int tx_queue_max;
+	/** Current depth of RX queue */
+	unsigned int rx_queue_len;
+	/** High-water mark of RX queue depth */
+	unsigned int rx_queue_max;
+	/** Number of polls */
+	unsigned long polls;
+	/** Total cost of polls (in CPU-specific ticks) */
+	uint64_t poll_cost;
+	/** Maximum cost of a single poll (in CPU-specific ticks) */
+	unsigned long poll_max;
+	/** Start of current rate sampling interval (in ticks) */
+	unsigned long sample_start;
+	/** TX packet count at start of sampling interval */
+	unsigned int sample_tx;
+	/** TX byte count at start of sampling interval */
+	unsigned long sample_tx_bytes;
+	/** RX packet count at start of sampling interval */
+	unsigned int sample_rx;
+	/** RX byte count at start of sampling interval */
+	unsigned long sample_rx_bytes;
+	/** TX packets per second over last sampling interval */
+	unsigned long tx_pps;
+	/** TX bytes per second over last sampling interval */
+	unsigned long tx_bps;
+	/** RX packets per second over last sampling interval */
+	unsigned long rx_pps;
+	/** RX bytes per second over last sampling interval */
+	unsigned long rx_bps;
+};
+
 /**
  * A network device
  *
@@ -318,6 +363,10 @@ struct net_device {
 	struct net_device_stats tx_stats;
 	/** RX statistics */
 	struct net_device_stats rx_stats;
+	/** Performance counters */
+	struct net_device_perf perf;
+	/** Neighbour cache */
+	struct neighbour_table neighbours;
 
 	/** Configuration settings applicable to this device */
 	struct generic_settings settings;
@@ -530,6 +579,32 @@ extern int net_tx ( struct io_buffer *iobuf, struct net_device *netdev,
 extern int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		    uint16_t net_proto, const void *ll_source );
 
+/**
+ * Record transmission rejected due to a full TX ring
+ *
+ * @v netdev		Network device
+ *
+ * Drivers should call this method before returning an error from
+ * their transmit() method because no TX descriptors are available.
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_tx_ring_full ( struct net_device *netdev ) {
+	netdev->perf.tx_ring_full++;
+}
+
+/**
+ * Record failure to allocate an RX buffer
+ *
+ * @v netdev		Network device
+ *
+ * Drivers should call this method when they are unable to allocate
+ * an I/O buffer to refill their RX ring.
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_rx_alloc_fail ( struct net_device *netdev ) {
+	netdev->perf.rx_alloc_fail++;
+}
+
 /**
  * Complete network transmission
  *
@@ -16,6 +16,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 struct nvs_device;
 struct refcnt;
 
+/** Name of non-volatile stored options settings block */
+#define NVO_SETTINGS_NAME "nvo"
+
 /**
  * A fragment of a non-volatile storage device used for stored options
  */
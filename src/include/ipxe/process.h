@@ -31,12 +31,47 @@ struct process {
 	 * object, this field may be NULL.
 	 */
 	struct refcnt *refcnt;
+	/** Priority
+	 *
+	 * This is one of the PROCESS_PRIO_XXX constants.
+	 */
+	int priority;
+	/** Flags */
+	unsigned int flags;
+};
+
+/** Process flags */
+enum process_flags {
+	/** Process is sleeping, waiting to be woken by process_wake() */
+	PROCESS_SLEEPING = 0x0001,
 };
 
+/** High process priority (e.g. network reception) */
+#define PROCESS_PRIO_HIGH 1
+
+/** Normal process priority */
+#define PROCESS_PRIO_NORMAL 0
+
+/** Low process priority (e.g. user interface output) */
+#define PROCESS_PRIO_LOW -1
+
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
+extern void process_sleep ( struct process *process );
+extern void process_wake ( struct process *process );
 extern void step ( void );
 
+/**
+ * Check if process is sleeping
+ *
+ * @v process		Process
+ * @ret sleeping	Process is sleeping
+ */
+static inline __attribute__ (( always_inline )) int
+process_sleeping ( struct process *process ) {
+	return ( process->flags & PROCESS_SLEEPING );
+}
+
 /**
  * Initialise process without adding to process list
  *
@@ -50,6 +85,8 @@ process_init_stopped ( struct process *process,
 	INIT_LIST_HEAD ( &process->list );
 	process->step = step;
 	process->refcnt = refcnt;
+	process->priority = PROCESS_PRIO_NORMAL;
+	process->flags = 0;
 }
 
 /**
@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <ipxe/interface.h>
 #include <ipxe/tables.h>
+#include <ipxe/socket.h>
 
 struct sockaddr;
 
@@ -32,8 +33,11 @@ struct resolver {
 /** Numeric resolver priority */
 #define RESOLV_NUMERIC 01
 
+/** Cached resolver priority */
+#define RESOLV_CACHE 02
+
 /** Normal resolver priority */
-#define RESOLV_NORMAL 02
+#define RESOLV_NORMAL 03
 
 /** Resolvers table */
 #define RESOLVERS __table ( struct resolver, "resolvers" )
@@ -48,4 +52,10 @@ extern void resolv_done ( struct interface *intf, struct sockaddr *sa );
 extern int resolv ( struct interface *resolv, const char *name,
 		    struct sockaddr *sa );
 
+extern int resolv_cache_add ( const char *name, struct sockaddr *sa,
+			      unsigned long ttl );
+extern int resolv_cache_add_negative ( const char *name, sa_family_t family,
+				       unsigned long ttl );
+extern void resolv_cache_flush ( void );
+
 #endif /* _IPXE_RESOLV_H */
@@ -19,7 +19,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 /** A retry timer */
 struct retry_timer {
-	/** List of active timers */
+	/** Timer wheel slot list */
 	struct list_head list;
 	/** Timer is currently running */
 	unsigned int running;
@@ -67,6 +67,7 @@ extern void start_timer ( struct retry_timer *timer );
 extern void start_timer_fixed ( struct retry_timer *timer,
 				unsigned long timeout );
 extern void stop_timer ( struct retry_timer *timer );
+extern unsigned long retry_idle_ticks ( void );
 
 /**
  * Start timer with no delay
@@ -1,17 +1,82 @@
 #ifndef _IPXE_SHA1_H
 #define _IPXE_SHA1_H
 
+/** @file
+ *
+ * SHA-1 algorithm
+ *
+ */
+
 FILE_LICENCE ( GPL2_OR_LATER );
 
-#include "crypto/axtls/crypto.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <ipxe/tables.h>
 
 struct digest_algorithm;
 
-#define SHA1_CTX_SIZE sizeof ( SHA1_CTX )
-#define SHA1_DIGEST_SIZE SHA1_SIZE
+/** SHA-1 block size */
+#define SHA1_BLOCK_SIZE 64
+
+/** SHA-1 digest size */
+#define SHA1_DIGEST_SIZE 20
+
+/** SHA-1 context */
+struct sha1_context {
+	/** Hash state */
+	uint32_t h[5];
+	/** Amount of accumulated data (in bytes) */
+	uint64_t len;
+	/** Partial data block */
+	uint8_t block[SHA1_BLOCK_SIZE];
+	/** SHA-1 engine */
+	struct sha1_engine *engine;
+};
+
+/** SHA-1 context size */
+#define SHA1_CTX_SIZE sizeof ( struct sha1_context )
+
+/** A SHA-1 engine */
+struct sha1_engine {
+	/** Engine name */
+	const char *name;
+	/** Check if engine can be used on this CPU
+	 *
+	 * @ret supported	Engine is supported
+	 *
+	 * May be NULL, if the engine is always usable.
+	 */
+	int ( * supported ) ( void );
+	/** Digest data blocks
+	 *
+	 * @v h			Hash state
+	 * @v data		Data blocks
+	 * @v blocks		Number of blocks
+	 *
+	 * The data need not be aligned.
+	 */
+	void ( * digest ) ( uint32_t *h, const void *data, size_t blocks );
+};
 
+/** SHA-1 engine table */
+#define SHA1_ENGINES __table ( struct sha1_engine, "sha1_engines" )
+
+/** Declare a SHA-1 engine */
+#define __sha1_engine( engine_order ) \
+	__table_entry ( SHA1_ENGINES, engine_order )
+
+/** Hardware-accelerated SHA-1 engine priority */
+#define SHA1_ENGINE_ACCELERATED 01
+
+/** Generic SHA-1 engine priority */
+#define SHA1_ENGINE_GENERIC 02
+
+extern struct sha1_engine sha1_generic_engine;
 extern struct digest_algorithm sha1_algorithm;
 
+extern void sha1_engine_init ( struct sha1_context *context,
+			       struct sha1_engine *engine );
+
 /* SHA1-wrapping functions defined in sha1extra.c: */
 
 void prf_sha1 ( const void *key, size_t key_len, const char *label,
@@ -0,0 +1,88 @@
+#ifndef _IPXE_SHA256_H
+#define _IPXE_SHA256_H
+
+/** @file
+ *
+ * SHA-256 algorithm
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+#include <ipxe/tables.h>
+
+struct digest_algorithm;
+
+/** SHA-256 number of rounds */
+#define SHA256_ROUNDS 64
+
+/** SHA-256 block size */
+#define SHA256_BLOCK_SIZE 64
+
+/** SHA-256 digest size */
+#define SHA256_DIGEST_SIZE 32
+
+/** SHA-256 context */
+struct sha256_context {
+	/** Hash state */
+	uint32_t h[8];
+	/** Amount of accumulated data (in bytes) */
+	uint64_t len;
+	/** Partial data block */
+	union {
+		uint8_t byte[SHA256_BLOCK_SIZE];
+		uint32_t dword[ SHA256_BLOCK_SIZE / sizeof ( uint32_t ) ];
+		uint64_t qword[ SHA256_BLOCK_SIZE / sizeof ( uint64_t ) ];
+	} block;
+	/** SHA-256 engine */
+	struct sha256_engine *engine;
+};
+
+/** SHA-256 context size */
+#define SHA256_CTX_SIZE sizeof ( struct sha256_context )
+
+/** A SHA-256 engine */
+struct sha256_engine {
+	/** Engine name */
+	const char *name;
+	/** Check if engine can be used on this CPU
+	 *
+	 * @ret supported	Engine is supported
+	 *
+	 * May be NULL, if the engine is always usable.
+	 */
+	int ( * supported ) ( void );
+	/** Digest data blocks
+	 *
+	 * @v h			Hash state
+	 * @v data		Data blocks
+	 * @v blocks		Number of blocks
+	 *
+	 * The data need not be aligned.
+	 */
+	void ( * digest ) ( uint32_t *h, const void *data, size_t blocks );
+};
+
+/** SHA-256 engine table */
+#define SHA256_ENGINES __table ( struct sha256_engine, "sha256_engines" )
+
+/** Declare a SHA-256 engine */
+#define __sha256_engine( engine_order ) \
+	__table_entry ( SHA256_ENGINES, engine_order )
+
+/** Hardware-accelerated SHA-256 engine priority */
+#define SHA256_ENGINE_ACCELERATED 01
+
+/** Generic SHA-256 engine priority */
+#define SHA256_ENGINE_GENERIC 02
+
+extern const uint32_t sha256_k[SHA256_ROUNDS];
+extern struct sha256_engine sha256_generic_engine;
+extern struct digest_algorithm sha256_algorithm;
+
+extern void sha256_engine_init ( struct sha256_context *context,
+				 struct sha256_engine *engine );
+
+#endif /* _IPXE_SHA256_H */
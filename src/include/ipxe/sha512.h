@@ -0,0 +1,51 @@
+#ifndef _IPXE_SHA512_H
+#define _IPXE_SHA512_H
+
+/** @file
+ *
+ * SHA-512 family of algorithms
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+
+struct digest_algorithm;
+
+/** SHA-512 number of rounds */
+#define SHA512_ROUNDS 80
+
+/** SHA-512 block size */
+#define SHA512_BLOCK_SIZE 128
+
+/** SHA-512 digest size */
+#define SHA512_DIGEST_SIZE 64
+
+/** SHA-384 digest size */
+#define SHA384_DIGEST_SIZE 48
+
+/** SHA-512 context */
+struct sha512_context {
+	/** Hash state */
+	uint64_t h[8];
+	/** Amount of accumulated data (in bytes)
+	 *
+	 * The message length field is 128 bits wide, but we can
+	 * never hash anywhere near 2^64 bytes.
+	 */
+	uint64_t len;
+	/** Partial data block */
+	union {
+		uint8_t byte[SHA512_BLOCK_SIZE];
+		uint64_t qword[ SHA512_BLOCK_SIZE / sizeof ( uint64_t ) ];
+	} block;
+};
+
+/** SHA-512 context size */
+#define SHA512_CTX_SIZE sizeof ( struct sha512_context )
+
+extern struct digest_algorithm sha512_algorithm;
+extern struct digest_algorithm sha384_algorithm;
+
+#endif /* _IPXE_SHA512_H */
@@ -342,6 +342,45 @@ static inline int tcp_in_window ( uint32_t seq, uint32_t start,
 	return ( ( seq - start ) < len );
 }
 
+/** Number of closed TCP connections retained for statistics */
+#define TCP_STAT_HISTORY 4
+
+/** TCP connection statistics */
+struct tcp_statistics {
+	/** Remote socket address */
+	struct sockaddr_tcpip peer;
+	/** Local port */
+	unsigned int local_port;
+	/** Name of current TCP state */
+	const char *state;
+	/** Smoothed round-trip time (in ticks) */
+	unsigned long rtt;
+	/** Number of segments transmitted */
+	unsigned long tx_segments;
+	/** Number of payload bytes transmitted */
+	unsigned long tx_bytes;
+	/** Number of segments retransmitted */
+	unsigned long retransmits;
+	/** Number of times transmission stalled on a zero send window */
+	unsigned long tx_stalls;
+	/** Number of segments received */
+	unsigned long rx_segments;
+	/** Number of payload bytes received */
+	unsigned long rx_bytes;
+	/** Number of duplicate ACKs received */
+	unsigned long dup_acks;
+	/** Number of segments received out of order */
+	unsigned long rx_ooo;
+	/** Number of received segments dropped as duplicate or
+	 * outside the receive window
+	 */
+	unsigned long rx_drops;
+	/** Number of times reception stalled on a zero receive window */
+	unsigned long rx_stalls;
+};
+
 extern struct tcpip_protocol tcp_protocol;
 
+extern int tcp_stat ( unsigned int index, struct tcp_statistics *stats );
+
 #endif /* _IPXE_TCP_H */
@@ -16,6 +16,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/crypto.h>
 #include <ipxe/md5.h>
 #include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/sha512.h>
 #include <ipxe/x509.h>
 
 /** A TLS header */
@@ -40,6 +42,9 @@ struct tls_header {
 /** TLS version 1.1 */
 #define TLS_VERSION_TLS_1_1 0x0302
 
+/** TLS version 1.2 */
+#define TLS_VERSION_TLS_1_2 0x0303
+
 /** Change cipher content type */
 #define TLS_TYPE_CHANGE_CIPHER 20
 
@@ -73,6 +78,14 @@ struct tls_header {
 #define TLS_RSA_WITH_NULL_SHA 0x0002
 #define TLS_RSA_WITH_AES_128_CBC_SHA 0x002f
 #define TLS_RSA_WITH_AES_256_CBC_SHA 0x0035
+#define TLS_RSA_WITH_AES_128_GCM_SHA256 0x009c
+#define TLS_RSA_WITH_AES_256_GCM_SHA384 0x009d
+
+/** Length of fixed (implicit) part of an AEAD nonce */
+#define TLS_AEAD_FIXED_IV_LEN 4
+
+/** Length of explicit part of an AEAD nonce */
+#define TLS_AEAD_EXPLICIT_IV_LEN 8
 
 /** TLS RX state machine state */
 enum tls_rx_state {
@@ -110,8 +123,26 @@ struct tls_cipherspec {
 	void *cipher_next_ctx;
 	/** MAC secret */
 	void *mac_secret;
+	/** Fixed part of AEAD nonce (AEAD ciphers only) */
+	uint8_t fixed_iv[TLS_AEAD_FIXED_IV_LEN];
 };
 
+/** A TLS AEAD nonce */
+struct tls_aead_nonce {
+	/** Fixed part */
+	uint8_t fixed[TLS_AEAD_FIXED_IV_LEN];
+	/** Explicit part (the record sequence number) */
+	uint64_t seq;
+} __attribute__ (( packed ));
+
+/** TLS AEAD additional data */
+struct tls_aead_data {
+	/** Sequence number */
+	uint64_t seq;
+	/** Record header, with the plaintext length */
+	struct tls_header tlshdr;
+} __attribute__ (( packed ));
+
 /** TLS pre-master secret */
 struct tls_pre_master_secret {
 	/** TLS version */
@@ -138,6 +169,17 @@ struct tls_session {
 	/** Ciphertext stream */
 	struct interface cipherstream;
 
+	/** Protocol version
+	 *
+	 * This is a TLS_VERSION_XXX constant, in host byte order.
+	 * It is the version to be used for outgoing records, and
+	 * becomes the negotiated version once the Server Hello has
+	 * been received.
+	 */
+	uint16_t version;
+	/** PRF and handshake verification digest (TLSv1.2 only) */
+	struct digest_algorithm *prf_digest;
+
 	/** Current TX cipher specification */
 	struct tls_cipherspec tx_cipherspec;
 	/** Next TX cipher specification */
@@ -158,6 +200,10 @@ struct tls_session {
 	uint8_t handshake_md5_ctx[MD5_CTX_SIZE];
 	/** SHA1 context for handshake verification */
 	uint8_t handshake_sha1_ctx[SHA1_CTX_SIZE];
+	/** SHA-256 context for handshake verification */
+	uint8_t handshake_sha256_ctx[SHA256_CTX_SIZE];
+	/** SHA-384 context for handshake verification */
+	uint8_t handshake_sha384_ctx[SHA512_CTX_SIZE];
 
 	/** Hack: server RSA public key */
 	struct x509_rsa_public_key rsa;
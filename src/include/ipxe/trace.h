@@ -0,0 +1,68 @@
+#ifndef _IPXE_TRACE_H
+#define _IPXE_TRACE_H
+
+/** @file
+ *
+ * Boot timeline tracing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <stdint.h>
+#include <stddef.h>
+#include <config/general.h>
+
+/** Maximum number of recorded trace events */
+#define TRACE_MAX_EVENTS 128
+
+/** Maximum length of a trace event subject (including NUL) */
+#define TRACE_SUBJECT_LEN 24
+
+/** A trace event */
+struct trace_event {
+	/** CPU timestamp counter */
+	uint64_t tsc;
+	/** Timer ticks */
+	unsigned long ticks;
+	/** Event type (e.g. "dhcp") */
+	const char *type;
+	/** Event subject (e.g. a network device or image name) */
+	char subject[TRACE_SUBJECT_LEN];
+	/** Event value (e.g. a byte count or status code) */
+	long value;
+};
+
+/** Boot timeline tracing is enabled */
+#ifdef TRACE_CMD
+#define TRACE_ENABLED 1
+#else
+#define TRACE_ENABLED 0
+#endif
+
+extern void trace_record ( const char *type, const char *subject,
+			   long value );
+extern unsigned int trace_count ( void );
+extern unsigned int trace_dropped ( void );
+extern struct trace_event * trace_event ( unsigned int index );
+extern unsigned long trace_ms ( struct trace_event *event );
+extern void trace_clear ( void );
+extern size_t trace_summary ( char *buf, size_t len );
+
+/**
+ * Record trace event
+ *
+ * @v type		Event type (must be a static string)
+ * @v subject		Event subject, or NULL
+ * @v value		Event value
+ *
+ * When boot timeline tracing is disabled, this compiles away to
+ * nothing and the trace recording code is not linked in.
+ */
+static inline __attribute__ (( always_inline )) void
+trace ( const char *type, const char *subject, long value ) {
+	if ( TRACE_ENABLED )
+		trace_record ( type, subject, value );
+}
+
+#endif /* _IPXE_TRACE_H */
@@ -20,6 +20,7 @@
  *		- 'z'		- Signed / unsigned size_t
  *	- Conversion specifiers
  *		- 'd'		- Signed decimal
+ *		- 'u'		- Unsigned decimal
  *		- 'x','X'	- Unsigned hexadecimal
  *		- 'c'		- Character
  *		- 's'		- String
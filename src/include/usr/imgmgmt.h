@@ -13,6 +13,10 @@ struct image;
 
 extern int imgfetch ( struct image *image, const char *uri_string,
 		      int ( * image_register ) ( struct image *image ) );
+extern int imgfetch_background ( struct image *image, const char *uri_string,
+				int ( * image_register )
+					( struct image *image ) );
+extern int imgwait ( void );
 extern int imgload ( struct image *image );
 extern int imgexec ( struct image *image );
 extern struct image * imgautoselect ( void );
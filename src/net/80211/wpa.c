@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/ethernet.h>
 #include <stdlib.h>
 #include <string.h>
+#include <byteswap.h>
 #include <errno.h>
 
 /** @file
@@ -26,6 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/crc32.h>
 #include <ipxe/arc4.h>
 #include <ipxe/wpa.h>
+#include <string.h>
 #include <byteswap.h>
 #include <errno.h>
 
@@ -5,6 +5,8 @@
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/list.h>
+#include <ipxe/malloc.h>
+#include <ipxe/timer.h>
 #include <ipxe/in.h>
 #include <ipxe/arp.h>
 #include <ipxe/if_ether.h>
@@ -31,8 +33,8 @@ struct net_protocol ipv4_protocol;
 /** List of IPv4 miniroutes */
 struct list_head ipv4_miniroutes = LIST_HEAD_INIT ( ipv4_miniroutes );
 
-/** List of fragment reassembly buffers */
-static LIST_HEAD ( frag_buffers );
+/** List of partially reassembled datagrams */
+static LIST_HEAD ( ipv4_fragments );
 
 /**
  * Add IPv4 minirouting table entry
@@ -134,103 +136,278 @@ static struct ipv4_miniroute * ipv4_route ( struct in_addr *dest ) {
 }
 
 /**
- * Fragment reassembly counter timeout
+ * Get IPv4 hole descriptor
  *
- * @v timer	Retry timer
- * @v over	If asserted, the timer is greater than @c MAX_TIMEOUT 
+ * @v frag		Partially reassembled datagram
+ * @v offset		Offset of hole within payload
+ * @ret hole		Hole descriptor
  */
-static void ipv4_frag_expired ( struct retry_timer *timer __unused,
-				int over ) {
-	if ( over ) {
-		DBG ( "Fragment reassembly timeout" );
-		/* Free the fragment buffer */
+static inline struct ipv4_hole * ipv4_hole ( struct ipv4_fragment *frag,
+					     unsigned int offset ) {
+	return ( frag->iobuf->data + sizeof ( struct iphdr ) + offset );
+}
+
+/**
+ * Set IPv4 hole list link
+ *
+ * @v frag		Partially reassembled datagram
+ * @v prev		Offset of previous hole, or IP_HOLE_NONE
+ * @v next		Offset of next hole, or IP_HOLE_NONE
+ */
+static void ipv4_hole_link ( struct ipv4_fragment *frag, unsigned int prev,
+			     unsigned int next ) {
+	if ( prev == IP_HOLE_NONE ) {
+		frag->hole = next;
+	} else {
+		ipv4_hole ( frag, prev )->next = next;
+	}
+}
+
+/**
+ * Create IPv4 hole descriptor
+ *
+ * @v frag		Partially reassembled datagram
+ * @v first		Offset of first byte in hole
+ * @v last		Offset of last byte in hole, or IP_HOLE_INFINITY
+ * @v next		Offset of next hole, or IP_HOLE_NONE
+ */
+static void ipv4_hole_create ( struct ipv4_fragment *frag, unsigned int first,
+			       unsigned int last, unsigned int next ) {
+	struct ipv4_hole *hole = ipv4_hole ( frag, first );
+
+	hole->first = first;
+	hole->last = last;
+	hole->next = next;
+}
+
+/**
+ * Free partially reassembled datagram
+ *
+ * @v frag		Partially reassembled datagram
+ */
+static void ipv4_fragment_free ( struct ipv4_fragment *frag ) {
+	stop_timer ( &frag->timer );
+	list_del ( &frag->list );
+	free_iob ( frag->iobuf );
+	free ( frag );
+}
+
+/**
+ * Handle fragment reassembly timeout
+ *
+ * @v timer		Reassembly timer
+ * @v fail		Failure indicator
+ */
+static void ipv4_fragment_expired ( struct retry_timer *timer,
+				    int fail __unused ) {
+	struct ipv4_fragment *frag =
+		container_of ( timer, struct ipv4_fragment, timer );
+
+	DBG ( "IPv4 reassembly of %s id %04x timed out\n",
+	      inet_ntoa ( frag->src ), ntohs ( frag->ident ) );
+	ipv4_fragment_free ( frag );
+}
+
+/**
+ * Ensure reassembly buffer is large enough
+ *
+ * @v frag		Partially reassembled datagram
+ * @v size		Required payload space
+ * @ret rc		Return status code
+ *
+ * If the total length is not yet known, the buffer is grown
+ * geometrically to limit the amount of copying.  No reassembly
+ * buffer is allowed to take more than half of the remaining free
+ * heap.
+ */
+static int ipv4_fragment_resize ( struct ipv4_fragment *frag, size_t size ) {
+	struct io_buffer *iobuf;
+
+	/* Do nothing if buffer is already large enough */
+	if ( size <= frag->size )
+		return 0;
+
+	/* Calculate new size */
+	if ( ( ! frag->len ) && ( size < ( 2 * frag->size ) ) )
+		size = ( 2 * frag->size );
+	if ( size > ( IP_MAX_PAYLOAD + sizeof ( struct ipv4_hole ) ) )
+		size = ( IP_MAX_PAYLOAD + sizeof ( struct ipv4_hole ) );
+	if ( size > ( freemem / 2 ) ) {
+		DBG ( "IPv4 reassembly buffer of %zd bytes exceeds heap "
+		      "limit\n", size );
+		return -ENOBUFS;
 	}
+
+	/* Allocate new buffer and copy in existing contents (including
+	 * any hole descriptors).
+	 */
+	iobuf = alloc_iob ( sizeof ( struct iphdr ) + size );
+	if ( ! iobuf )
+		return -ENOMEM;
+	memcpy ( iobuf->data, frag->iobuf->data,
+		 ( sizeof ( struct iphdr ) + frag->size ) );
+	free_iob ( frag->iobuf );
+	frag->iobuf = iobuf;
+	frag->size = size;
+
+	return 0;
 }
 
 /**
- * Free fragment buffer
+ * Find or create partially reassembled datagram
  *
- * @v fragbug	Fragment buffer
+ * @v iphdr		IPv4 header of received fragment
+ * @ret frag		Partially reassembled datagram, or NULL
  */
-static void free_fragbuf ( struct frag_buffer *fragbuf ) {
-	free ( fragbuf );
+static struct ipv4_fragment * ipv4_fragment ( struct iphdr *iphdr ) {
+	struct ipv4_fragment *frag;
+
+	/* Find existing datagram, if any */
+	list_for_each_entry ( frag, &ipv4_fragments, list ) {
+		if ( ( frag->ident == iphdr->ident ) &&
+		     ( frag->protocol == iphdr->protocol ) &&
+		     ( frag->src.s_addr == iphdr->src.s_addr ) &&
+		     ( frag->dest.s_addr == iphdr->dest.s_addr ) )
+			return frag;
+	}
+
+	/* Create new datagram, containing a single hole */
+	frag = zalloc ( sizeof ( *frag ) );
+	if ( ! frag )
+		goto err_alloc;
+	frag->src = iphdr->src;
+	frag->dest = iphdr->dest;
+	frag->ident = iphdr->ident;
+	frag->protocol = iphdr->protocol;
+	frag->iobuf = alloc_iob ( sizeof ( *iphdr ) );
+	if ( ! frag->iobuf )
+		goto err_alloc_iob;
+	memcpy ( frag->iobuf->data, iphdr, sizeof ( *iphdr ) );
+	if ( ipv4_fragment_resize ( frag, sizeof ( struct ipv4_hole ) ) != 0 )
+		goto err_resize;
+	ipv4_hole_create ( frag, 0, IP_HOLE_INFINITY, IP_HOLE_NONE );
+	frag->hole = 0;
+	timer_init ( &frag->timer, ipv4_fragment_expired );
+	start_timer_fixed ( &frag->timer, IP_FRAG_TIMEOUT );
+	list_add ( &frag->list, &ipv4_fragments );
+
+	return frag;
+
+ err_resize:
+	free_iob ( frag->iobuf );
+ err_alloc_iob:
+	free ( frag );
+ err_alloc:
+	return NULL;
 }
 
 /**
  * Fragment reassembler
  *
  * @v iobuf		I/O buffer, fragment of the datagram
- * @ret frag_iob	Reassembled packet, or NULL
+ * @ret iobuf		Reassembled datagram, or NULL
+ *
+ * Fragments may arrive in any order, and may overlap.  Reassembly
+ * uses the hole descriptor algorithm from RFC 815.  The reassembled
+ * datagram is returned with a fresh IPv4 header (without options).
  */
-static struct io_buffer * ipv4_reassemble ( struct io_buffer * iobuf ) {
+static struct io_buffer * ipv4_reassemble ( struct io_buffer *iobuf ) {
 	struct iphdr *iphdr = iobuf->data;
-	struct frag_buffer *fragbuf;
-	
-	/**
-	 * Check if the fragment belongs to any fragment series
+	size_t hdrlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	unsigned int frags = ntohs ( iphdr->frags );
+	size_t offset = ( ( frags & IP_MASK_OFFSET ) * 8 );
+	size_t len = ( iob_len ( iobuf ) - hdrlen );
+	size_t end = ( offset + len );
+	int more = ( frags & IP_MASK_MOREFRAGS );
+	struct ipv4_fragment *frag;
+	struct ipv4_hole hole;
+	unsigned int first;
+	unsigned int prev;
+	unsigned int next;
+
+	/* Sanity checks */
+	if ( ( len == 0 ) || ( more && ( len & 7 ) ) ||
+	     ( end > IP_MAX_PAYLOAD ) ) {
+		DBG ( "IPv4 invalid fragment at [%zd,%zd)\n", offset, end );
+		goto drop;
+	}
+
+	/* Find or create partially reassembled datagram */
+	frag = ipv4_fragment ( iphdr );
+	if ( ! frag )
+		goto drop;
+
+	/* Check consistency with total length, if known */
+	if ( frag->len &&
+	     ( ( end > frag->len ) || ( ( ! more ) && ( end != frag->len ) ) ) ){
+		DBG ( "IPv4 fragment at [%zd,%zd) inconsistent with length "
+		      "%zd\n", offset, end, frag->len );
+		goto drop;
+	}
+	if ( ! more )
+		frag->len = end;
+
+	/* Ensure buffer is large enough, allowing for a trailing hole
+	 * descriptor if the total length is not yet known.
 	 */
-	list_for_each_entry ( fragbuf, &frag_buffers, list ) {
-		if ( fragbuf->ident == iphdr->ident &&
-		     fragbuf->src.s_addr == iphdr->src.s_addr ) {
-			/**
-			 * Check if the packet is the expected fragment
-			 * 
-			 * The offset of the new packet must be equal to the
-			 * length of the data accumulated so far (the length of
-			 * the reassembled I/O buffer
-			 */
-			if ( iob_len ( fragbuf->frag_iob ) == 
-			      ( iphdr->frags & IP_MASK_OFFSET ) ) {
-				/**
-				 * Append the contents of the fragment to the
-				 * reassembled I/O buffer
-				 */
-				iob_pull ( iobuf, sizeof ( *iphdr ) );
-				memcpy ( iob_put ( fragbuf->frag_iob,
-							iob_len ( iobuf ) ),
-					 iobuf->data, iob_len ( iobuf ) );
-				free_iob ( iobuf );
-
-				/** Check if the fragment series is over */
-				if ( ! ( iphdr->frags & IP_MASK_MOREFRAGS ) ) {
-					iobuf = fragbuf->frag_iob;
-					free_fragbuf ( fragbuf );
-					return iobuf;
-				}
-
-			} else {
-				/* Discard the fragment series */
-				free_fragbuf ( fragbuf );
-				free_iob ( iobuf );
-			}
-			return NULL;
-		}
+	if ( ipv4_fragment_resize ( frag, ( end + ( frag->len ? 0 :
+			sizeof ( struct ipv4_hole ) ) ) ) != 0 ) {
+		ipv4_fragment_free ( frag );
+		goto drop;
 	}
-	
-	/** Check if the fragment is the first in the fragment series */
-	if ( iphdr->frags & IP_MASK_MOREFRAGS &&
-			( ( iphdr->frags & IP_MASK_OFFSET ) == 0 ) ) {
-	
-		/** Create a new fragment buffer */
-		fragbuf = ( struct frag_buffer* ) malloc ( sizeof( *fragbuf ) );
-		fragbuf->ident = iphdr->ident;
-		fragbuf->src = iphdr->src;
-
-		/* Set up the reassembly I/O buffer */
-		fragbuf->frag_iob = alloc_iob ( IP_FRAG_IOB_SIZE );
-		iob_pull ( iobuf, sizeof ( *iphdr ) );
-		memcpy ( iob_put ( fragbuf->frag_iob, iob_len ( iobuf ) ),
-			 iobuf->data, iob_len ( iobuf ) );
-		free_iob ( iobuf );
-
-		/* Set the reassembly timer */
-		timer_init ( &fragbuf->frag_timer, ipv4_frag_expired );
-		start_timer_fixed ( &fragbuf->frag_timer, IP_FRAG_TIMEOUT );
-
-		/* Add the fragment buffer to the list of fragment buffers */
-		list_add ( &fragbuf->list, &frag_buffers );
+
+	/* Replace each hole overlapped by this fragment with the
+	 * (up to two) holes that remain on either side of it.
+	 */
+	prev = IP_HOLE_NONE;
+	for ( first = frag->hole ; first != IP_HOLE_NONE ; first = hole.next ) {
+		hole = *ipv4_hole ( frag, first );
+		if ( ( offset > hole.last ) || ( end <= hole.first ) ) {
+			prev = first;
+			continue;
+		}
+		next = hole.next;
+		if ( more && ( end <= hole.last ) ) {
+			ipv4_hole_create ( frag, end, hole.last, next );
+			next = end;
+		}
+		if ( offset > hole.first ) {
+			ipv4_hole_create ( frag, hole.first, ( offset - 1 ),
+					   next );
+			next = hole.first;
+		}
+		ipv4_hole_link ( frag, prev, next );
+		while ( next != hole.next ) {
+			prev = next;
+			next = ipv4_hole ( frag, prev )->next;
+		}
 	}
-	
+
+	/* Copy in fragment data */
+	memcpy ( ( frag->iobuf->data + sizeof ( *iphdr ) + offset ),
+		 ( iobuf->data + hdrlen ), len );
+	free_iob ( iobuf );
+
+	/* Done if any holes remain */
+	if ( frag->hole != IP_HOLE_NONE )
+		return NULL;
+
+	/* Construct header for reassembled datagram */
+	iobuf = frag->iobuf;
+	frag->iobuf = NULL;
+	iphdr = iob_put ( iobuf, ( sizeof ( *iphdr ) + frag->len ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->len = htons ( sizeof ( *iphdr ) + frag->len );
+	iphdr->frags = 0;
+	iphdr->chksum = 0;
+	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+	DBG ( "IPv4 reassembled %zd-byte datagram from %s id %04x\n",
+	      frag->len, inet_ntoa ( iphdr->src ), ntohs ( iphdr->ident ) );
+	ipv4_fragment_free ( frag );
+	return iobuf;
+
+ drop:
+	free_iob ( iobuf );
 	return NULL;
 }
 
@@ -258,16 +435,15 @@ static uint16_t ipv4_pshdr_chksum ( struct io_buffer *iobuf, uint16_t csum ) {
 }
 
 /**
- * Determine link-layer address
+ * Determine link-layer address for a broadcast or multicast address
  *
  * @v dest		IPv4 destination address
- * @v src		IPv4 source address
  * @v netdev		Network device
  * @v ll_dest		Link-layer destination address buffer
  * @ret rc		Return status code
  */
-static int ipv4_ll_addr ( struct in_addr dest, struct in_addr src,
-			  struct net_device *netdev, uint8_t *ll_dest ) {
+static int ipv4_ll_addr ( struct in_addr dest, struct net_device *netdev,
+			  uint8_t *ll_dest ) {
 	struct ll_protocol *ll_protocol = netdev->ll_protocol;
 
 	if ( dest.s_addr == INADDR_BROADCAST ) {
@@ -275,12 +451,9 @@ static int ipv4_ll_addr ( struct in_addr dest, struct in_addr src,
 		memcpy ( ll_dest, netdev->ll_broadcast,
 			 ll_protocol->ll_addr_len );
 		return 0;
-	} else if ( IN_MULTICAST ( ntohl ( dest.s_addr ) ) ) {
-		return ll_protocol->mc_hash ( AF_INET, &dest, ll_dest );
 	} else {
-		/* Unicast address: resolve via ARP */
-		return arp_resolve ( netdev, &ipv4_protocol, &dest,
-				     &src, ll_dest );
+		/* Multicast address */
+		return ll_protocol->mc_hash ( AF_INET, &dest, ll_dest );
 	}
 }
 
@@ -337,14 +510,6 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 		goto err;
 	}
 
-	/* Determine link-layer destination address */
-	if ( ( rc = ipv4_ll_addr ( next_hop, iphdr->src, netdev,
-				   ll_dest ) ) != 0 ) {
-		DBG ( "IPv4 has no link-layer address for %s: %s\n",
-		      inet_ntoa ( next_hop ), strerror ( rc ) );
-		goto err;
-	}
-
 	/* Fix up checksums */
 	if ( trans_csum )
 		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
@@ -356,8 +521,24 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	      inet_ntoa ( iphdr->dest ), ntohs ( iphdr->len ), iphdr->protocol,
 	      ntohs ( iphdr->ident ), ntohs ( iphdr->chksum ) );
 
-	/* Hand off to link layer */
-	if ( ( rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest ) ) != 0 ) {
+	/* Hand off to link layer.  Unicast packets go via ARP, which
+	 * will hold on to the packet if the link-layer address is not
+	 * yet known.
+	 */
+	if ( ( next_hop.s_addr == INADDR_BROADCAST ) ||
+	     IN_MULTICAST ( ntohl ( next_hop.s_addr ) ) ) {
+		if ( ( rc = ipv4_ll_addr ( next_hop, netdev,
+					   ll_dest ) ) != 0 ) {
+			DBG ( "IPv4 has no link-layer address for %s: %s\n",
+			      inet_ntoa ( next_hop ), strerror ( rc ) );
+			goto err;
+		}
+		rc = net_tx ( iobuf, netdev, &ipv4_protocol, ll_dest );
+	} else {
+		rc = arp_tx ( iobuf, netdev, &ipv4_protocol, &next_hop,
+			      &iphdr->src );
+	}
+	if ( rc != 0 ) {
 		DBG ( "IPv4 could not transmit packet via %s: %s\n",
 		      netdev->name, strerror ( rc ) );
 		return rc;
@@ -437,12 +618,8 @@ static int ipv4_rx ( struct io_buffer *iobuf, struct net_device *netdev __unused
 	      inet_ntoa ( iphdr->src ), ntohs ( iphdr->len ), iphdr->protocol,
 	      ntohs ( iphdr->ident ), ntohs ( iphdr->chksum ) );
 
-	/* Truncate packet to correct length, calculate pseudo-header
-	 * checksum and then strip off the IPv4 header.
-	 */
+	/* Truncate packet to correct length */
 	iob_unput ( iobuf, ( iob_len ( iobuf ) - len ) );
-	pshdr_csum = ipv4_pshdr_chksum ( iobuf, TCPIP_EMPTY_CSUM );
-	iob_pull ( iobuf, hdrlen );
 
 	/* Fragment reassembly */
 	if ( ( iphdr->frags & htons ( IP_MASK_MOREFRAGS ) ) || 
@@ -453,8 +630,16 @@ static int ipv4_rx ( struct io_buffer *iobuf, struct net_device *netdev __unused
 		iobuf = ipv4_reassemble ( iobuf );
 		if ( ! iobuf )
 			return 0;
+		iphdr = iobuf->data;
+		hdrlen = sizeof ( *iphdr );
 	}
 
+	/* Calculate pseudo-header checksum and then strip off the
+	 * IPv4 header.
+	 */
+	pshdr_csum = ipv4_pshdr_chksum ( iobuf, TCPIP_EMPTY_CSUM );
+	iob_pull ( iobuf, hdrlen );
+
 	/* Construct socket addresses and hand off to transport layer */
 	memset ( &src, 0, sizeof ( src ) );
 	src.sin.sin_family = AF_INET;
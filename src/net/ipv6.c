@@ -236,11 +236,7 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 		ll_dest_buf[5] = next_hop.in6_u.u6_addr8[15];
 	} else {
 		/* Unicast address needs to be resolved by NDP */
-		if ( ( rc = ndp_resolve ( netdev, &next_hop, &ip6hdr->src,
-					  ll_dest_buf ) ) != 0 ) {
-			DBG ( "No entry for %s\n", inet6_ntoa ( next_hop ) );
-			goto err;
-		}
+		return ndp_tx ( iobuf, netdev, &next_hop, &ip6hdr->src );
 	}
 
 	/* Transmit packet */
@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2010 Michael Brown <mbrown@fensystems.co.uk>.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
+#include <ipxe/neighbour.h>
+
+/** @file
+ *
+ * Neighbour discovery
+ *
+ * This file implements a neighbour cache which is shared between the
+ * network-layer protocols (e.g. IPv4 via ARP, and IPv6 via NDP).
+ * Each network device has its own hashed table of neighbours.
+ * Packets for which the link-layer address is not yet known are
+ * queued until the neighbour discovery protocol completes.
+ *
+ */
+
+/** A neighbour cache entry */
+struct neighbour {
+	/** List of entries in the same hash bucket */
+	struct list_head list;
+	/** List of entries in least-recently-used order */
+	struct list_head lru;
+	/** Network device */
+	struct net_device *netdev;
+	/** Network-layer protocol */
+	struct net_protocol *net_protocol;
+	/** Network-layer address */
+	uint8_t net_dest[MAX_NET_ADDR_LEN];
+	/** Link-layer address */
+	uint8_t ll_dest[MAX_LL_ADDR_LEN];
+	/** Time at which link-layer address was last confirmed */
+	unsigned long updated;
+
+	/** Neighbour discovery protocol, if discovery is in progress */
+	struct neighbour_discovery *discovery;
+	/** Source network-layer address used for discovery */
+	uint8_t net_source[MAX_NET_ADDR_LEN];
+	/** Discovery retransmission timer */
+	struct retry_timer timer;
+	/** Queue of packets awaiting discovery */
+	struct list_head tx_queue;
+	/** Number of packets awaiting discovery */
+	unsigned int count;
+};
+
+/** Maximum number of entries in a neighbour table */
+#define NEIGHBOUR_MAX_ENTRIES 64
+
+/** Maximum number of packets queued for each neighbour */
+#define NEIGHBOUR_MAX_PENDING 8
+
+/** Time after which neighbour discovery is abandoned */
+#define NEIGHBOUR_MAX_TIMEOUT ( 3 * TICKS_PER_SEC )
+
+/** Time after which a link-layer address must be rediscovered */
+#define NEIGHBOUR_MAX_AGE ( 60 * TICKS_PER_SEC )
+
+/**
+ * Initialise neighbour table
+ *
+ * @v table		Neighbour table
+ */
+void neighbour_init ( struct neighbour_table *table ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < NEIGHBOUR_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &table->buckets[i] );
+	INIT_LIST_HEAD ( &table->lru );
+	table->count = 0;
+}
+
+/**
+ * Identify hash bucket for a network-layer address
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Network-layer address
+ * @ret bucket		Hash bucket
+ *
+ * Neighbours on the same link usually differ only in the last few
+ * bytes of their addresses, so a simple fold is sufficient.
+ */
+static struct list_head * neighbour_bucket ( struct net_device *netdev,
+					     struct net_protocol *net_protocol,
+					     const void *net_dest ) {
+	const uint8_t *bytes = net_dest;
+	unsigned int hash = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < net_protocol->net_addr_len ; i++ )
+		hash = ( ( hash << 1 ) ^ bytes[i] );
+	hash ^= ( hash >> 4 );
+	return &netdev->neighbours.buckets[ hash & ( NEIGHBOUR_BUCKETS - 1 ) ];
+}
+
+/**
+ * Find neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Network-layer address
+ * @ret neighbour	Neighbour cache entry, or NULL
+ */
+static struct neighbour * neighbour_find ( struct net_device *netdev,
+					   struct net_protocol *net_protocol,
+					   const void *net_dest ) {
+	struct list_head *bucket;
+	struct neighbour *neighbour;
+
+	bucket = neighbour_bucket ( netdev, net_protocol, net_dest );
+	list_for_each_entry ( neighbour, bucket, list ) {
+		if ( ( neighbour->net_protocol == net_protocol ) &&
+		     ( memcmp ( neighbour->net_dest, net_dest,
+				net_protocol->net_addr_len ) == 0 ) )
+			return neighbour;
+	}
+	return NULL;
+}
+
+/**
+ * Free neighbour cache entry
+ *
+ * @v neighbour		Neighbour cache entry
+ *
+ * Any packets awaiting discovery are discarded.
+ */
+static void neighbour_free ( struct neighbour *neighbour ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	stop_timer ( &neighbour->timer );
+	list_for_each_entry_safe ( iobuf, tmp, &neighbour->tx_queue, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+	list_del ( &neighbour->list );
+	list_del ( &neighbour->lru );
+	neighbour->netdev->neighbours.count--;
+	free ( neighbour );
+}
+
+/**
+ * Handle neighbour discovery timer expiry
+ *
+ * @v timer		Retransmission timer
+ * @v fail		Failure indicator
+ */
+static void neighbour_expired ( struct retry_timer *timer, int fail ) {
+	struct neighbour *neighbour =
+		container_of ( timer, struct neighbour, timer );
+	struct net_device *netdev = neighbour->netdev;
+	struct net_protocol *net_protocol = neighbour->net_protocol;
+
+	/* Give up and discard queued packets if we have timed out */
+	if ( fail ) {
+		DBGC ( netdev, "NEIGHBOUR %s %s %s timed out; discarding %d "
+		       "packets\n", netdev->name, net_protocol->name,
+		       net_protocol->ntoa ( neighbour->net_dest ),
+		       neighbour->count );
+		neighbour_free ( neighbour );
+		return;
+	}
+
+	/* Otherwise, retransmit the request */
+	start_timer ( &neighbour->timer );
+	neighbour->discovery->tx_request ( netdev, net_protocol,
+					   neighbour->net_dest,
+					   neighbour->net_source );
+}
+
+/**
+ * Create neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Network-layer address
+ * @ret neighbour	Neighbour cache entry, or NULL
+ *
+ * If the table is full, the least recently used entry is evicted.
+ * Entries with discovery in progress are evicted only if there is no
+ * alternative, since doing so discards their queued packets.
+ */
+static struct neighbour * neighbour_create ( struct net_device *netdev,
+					     struct net_protocol *net_protocol,
+					     const void *net_dest ) {
+	struct neighbour_table *table = &netdev->neighbours;
+	struct neighbour *neighbour;
+	struct neighbour *victim = NULL;
+
+	/* Evict an entry, if necessary */
+	if ( table->count >= NEIGHBOUR_MAX_ENTRIES ) {
+		list_for_each_entry_reverse ( neighbour, &table->lru, lru ) {
+			if ( ! victim )
+				victim = neighbour;
+			if ( ! neighbour->discovery ) {
+				victim = neighbour;
+				break;
+			}
+		}
+		DBGC ( netdev, "NEIGHBOUR %s %s %s evicted\n", netdev->name,
+		       victim->net_protocol->name,
+		       victim->net_protocol->ntoa ( victim->net_dest ) );
+		neighbour_free ( victim );
+	}
+
+	/* Allocate and populate entry */
+	neighbour = zalloc ( sizeof ( *neighbour ) );
+	if ( ! neighbour )
+		return NULL;
+	neighbour->netdev = netdev;
+	neighbour->net_protocol = net_protocol;
+	memcpy ( neighbour->net_dest, net_dest, net_protocol->net_addr_len );
+	timer_init ( &neighbour->timer, neighbour_expired );
+	neighbour->timer.max_timeout = NEIGHBOUR_MAX_TIMEOUT;
+	INIT_LIST_HEAD ( &neighbour->tx_queue );
+	list_add ( &neighbour->list,
+		   neighbour_bucket ( netdev, net_protocol, net_dest ) );
+	list_add ( &neighbour->lru, &table->lru );
+	table->count++;
+
+	return neighbour;
+}
+
+/**
+ * Start neighbour discovery
+ *
+ * @v neighbour		Neighbour cache entry
+ * @v discovery		Neighbour discovery protocol
+ * @v net_source	Source network-layer address
+ */
+static void neighbour_discover ( struct neighbour *neighbour,
+				 struct neighbour_discovery *discovery,
+				 const void *net_source ) {
+	struct net_device *netdev = neighbour->netdev;
+	struct net_protocol *net_protocol = neighbour->net_protocol;
+	int rc;
+
+	DBGC ( netdev, "NEIGHBOUR %s %s %s starting %s discovery\n",
+	       netdev->name, net_protocol->name,
+	       net_protocol->ntoa ( neighbour->net_dest ), discovery->name );
+
+	/* Record discovery parameters */
+	neighbour->discovery = discovery;
+	memcpy ( neighbour->net_source, net_source,
+		 net_protocol->net_addr_len );
+
+	/* Transmit request.  Any failure is left to the
+	 * retransmission timer.
+	 */
+	neighbour->timer.timeout = 0;
+	start_timer ( &neighbour->timer );
+	if ( ( rc = discovery->tx_request ( netdev, net_protocol,
+					    neighbour->net_dest,
+					    net_source ) ) != 0 ) {
+		DBGC ( netdev, "NEIGHBOUR %s %s %s could not transmit %s "
+		       "request: %s\n", netdev->name, net_protocol->name,
+		       net_protocol->ntoa ( neighbour->net_dest ),
+		       discovery->name, strerror ( rc ) );
+	}
+}
+
+/**
+ * Complete neighbour discovery
+ *
+ * @v neighbour		Neighbour cache entry
+ * @v ll_dest		Link-layer address
+ *
+ * Any packets awaiting discovery are transmitted.
+ */
+static void neighbour_discovered ( struct neighbour *neighbour,
+				   const void *ll_dest ) {
+	struct net_device *netdev = neighbour->netdev;
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct net_protocol *net_protocol = neighbour->net_protocol;
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	/* Record link-layer address */
+	memcpy ( neighbour->ll_dest, ll_dest, ll_protocol->ll_addr_len );
+	neighbour->updated = currticks();
+	DBGC ( netdev, "NEIGHBOUR %s %s %s is %s %s\n", netdev->name,
+	       net_protocol->name, net_protocol->ntoa ( neighbour->net_dest ),
+	       ll_protocol->name, ll_protocol->ntoa ( neighbour->ll_dest ) );
+
+	/* Stop discovery and transmit any queued packets */
+	stop_timer ( &neighbour->timer );
+	neighbour->discovery = NULL;
+	list_for_each_entry_safe ( iobuf, tmp, &neighbour->tx_queue, list ) {
+		list_del ( &iobuf->list );
+		neighbour->count--;
+		net_tx ( iobuf, netdev, net_protocol, neighbour->ll_dest );
+	}
+}
+
+/**
+ * Transmit packet, determining link-layer address via neighbour cache
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @v discovery		Neighbour discovery protocol
+ * @v net_source	Source network-layer address
+ * @ret rc		Return status code
+ *
+ * If the destination link-layer address is present in the neighbour
+ * cache (and has not aged out), the packet will be transmitted
+ * immediately.  Otherwise, neighbour discovery will be started (if
+ * not already in progress) and the packet will be queued until
+ * discovery completes or is abandoned.
+ *
+ * This function takes ownership of the I/O buffer.
+ */
+int neighbour_tx ( struct io_buffer *iobuf, struct net_device *netdev,
+		   struct net_protocol *net_protocol, const void *net_dest,
+		   struct neighbour_discovery *discovery,
+		   const void *net_source ) {
+	struct neighbour *neighbour;
+	int rc;
+
+	/* Find or create neighbour cache entry */
+	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
+	if ( ! neighbour ) {
+		neighbour = neighbour_create ( netdev, net_protocol,
+					       net_dest );
+		if ( ! neighbour ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+		neighbour_discover ( neighbour, discovery, net_source );
+	} else if ( ( ! neighbour->discovery ) &&
+		    ( ( currticks() - neighbour->updated ) >
+		      NEIGHBOUR_MAX_AGE ) ) {
+		neighbour_discover ( neighbour, discovery, net_source );
+	}
+
+	/* Mark as most recently used */
+	list_del ( &neighbour->lru );
+	list_add ( &neighbour->lru, &netdev->neighbours.lru );
+
+	/* Transmit immediately if link-layer address is known */
+	if ( ! neighbour->discovery )
+		return net_tx ( iobuf, netdev, net_protocol,
+				neighbour->ll_dest );
+
+	/* Otherwise, queue packet */
+	if ( neighbour->count >= NEIGHBOUR_MAX_PENDING ) {
+		DBGC ( netdev, "NEIGHBOUR %s %s %s queue full\n", netdev->name,
+		       net_protocol->name, net_protocol->ntoa ( net_dest ) );
+		rc = -ENOBUFS;
+		goto err;
+	}
+	list_add_tail ( &iobuf->list, &neighbour->tx_queue );
+	neighbour->count++;
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/**
+ * Update existing neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Network-layer address
+ * @v ll_dest		Link-layer address
+ * @ret rc		Return status code
+ *
+ * This will update the link-layer address of an existing entry
+ * (e.g. in response to a gratuitous ARP), and will complete any
+ * discovery in progress.  No new entry will be created.
+ */
+int neighbour_update ( struct net_device *netdev,
+		       struct net_protocol *net_protocol,
+		       const void *net_dest, const void *ll_dest ) {
+	struct neighbour *neighbour;
+
+	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
+	if ( ! neighbour )
+		return -ENOENT;
+	neighbour_discovered ( neighbour, ll_dest );
+	return 0;
+}
+
+/**
+ * Define neighbour cache entry
+ *
+ * @v netdev		Network device
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Network-layer address
+ * @v ll_dest		Link-layer address
+ * @ret rc		Return status code
+ */
+int neighbour_define ( struct net_device *netdev,
+		       struct net_protocol *net_protocol,
+		       const void *net_dest, const void *ll_dest ) {
+	struct neighbour *neighbour;
+
+	neighbour = neighbour_find ( netdev, net_protocol, net_dest );
+	if ( ! neighbour ) {
+		neighbour = neighbour_create ( netdev, net_protocol,
+					       net_dest );
+		if ( ! neighbour )
+			return -ENOMEM;
+	}
+	neighbour_discovered ( neighbour, ll_dest );
+	return 0;
+}
+
+/**
+ * Flush neighbour table
+ *
+ * @v netdev		Network device
+ *
+ * All entries are removed, and any packets awaiting discovery are
+ * discarded.
+ */
+void neighbour_flush ( struct net_device *netdev ) {
+	struct neighbour *neighbour;
+	struct neighbour *tmp;
+
+	list_for_each_entry_safe ( neighbour, tmp, &netdev->neighbours.lru,
+				   lru ) {
+		neighbour_free ( neighbour );
+	}
+}
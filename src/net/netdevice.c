@@ -29,6 +29,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/iobuf.h>
 #include <ipxe/tables.h>
 #include <ipxe/process.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
 #include <ipxe/init.h>
 #include <ipxe/device.h>
 #include <ipxe/errortab.h>
@@ -129,6 +131,8 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->tx_queue );
+	if ( ++netdev->perf.tx_queue_len > netdev->perf.tx_queue_max )
+		netdev->perf.tx_queue_max = netdev->perf.tx_queue_len;
 
 	/* Avoid calling transmit() on unopened network devices */
 	if ( ! netdev_is_open ( netdev ) ) {
@@ -169,6 +173,7 @@ void netdev_tx_complete_err ( struct net_device *netdev,
 	/* Update statistics counter */
 	netdev_record_stat ( &netdev->tx_stats, rc );
 	if ( rc == 0 ) {
+		netdev->perf.tx_bytes += iob_len ( iobuf );
 		DBGC ( netdev, "NETDEV %p transmission %p complete\n",
 		       netdev, iobuf );
 	} else {
@@ -182,6 +187,7 @@ void netdev_tx_complete_err ( struct net_device *netdev,
 
 	/* Dequeue and free I/O buffer */
 	list_del ( &iobuf->list );
+	netdev->perf.tx_queue_len--;
 	free_iob ( iobuf );
 }
 
@@ -238,9 +244,12 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->rx_queue );
+	if ( ++netdev->perf.rx_queue_len > netdev->perf.rx_queue_max )
+		netdev->perf.rx_queue_max = netdev->perf.rx_queue_len;
 
 	/* Update statistics counter */
 	netdev_record_stat ( &netdev->rx_stats, 0 );
+	netdev->perf.rx_bytes += iob_len ( iobuf );
 }
 
 /**
@@ -268,6 +277,37 @@ void netdev_rx_err ( struct net_device *netdev,
 	netdev_record_stat ( &netdev->rx_stats, rc );
 }
 
+/**
+ * Update network device packet rates
+ *
+ * @v netdev		Network device
+ *
+ * Packet and byte rates are recalculated once per second.
+ */
+static void netdev_sample_rates ( struct net_device *netdev ) {
+	struct net_device_perf *perf = &netdev->perf;
+	unsigned long elapsed = ( currticks() - perf->sample_start );
+
+	if ( elapsed < TICKS_PER_SEC )
+		return;
+
+	perf->tx_pps = ( ( ( netdev->tx_stats.good - perf->sample_tx ) *
+			   TICKS_PER_SEC ) / elapsed );
+	perf->tx_bps = ( ( ( uint64_t ) ( perf->tx_bytes -
+					  perf->sample_tx_bytes ) *
+			   TICKS_PER_SEC ) / elapsed );
+	perf->rx_pps = ( ( ( netdev->rx_stats.good - perf->sample_rx ) *
+			   TICKS_PER_SEC ) / elapsed );
+	perf->rx_bps = ( ( ( uint64_t ) ( perf->rx_bytes -
+					  perf->sample_rx_bytes ) *
+			   TICKS_PER_SEC ) / elapsed );
+	perf->sample_start += elapsed;
+	perf->sample_tx = netdev->tx_stats.good;
+	perf->sample_tx_bytes = perf->tx_bytes;
+	perf->sample_rx = netdev->rx_stats.good;
+	perf->sample_rx_bytes = perf->rx_bytes;
+}
+
 /**
  * Poll for completed and received packets on network device
  *
@@ -278,9 +318,19 @@ void netdev_rx_err ( struct net_device *netdev,
  * via netdev_rx().
  */
 void netdev_poll ( struct net_device *netdev ) {
+	union profiler profiler;
+	unsigned long cost;
 
-	if ( netdev_is_open ( netdev ) )
+	if ( netdev_is_open ( netdev ) ) {
+		profile ( &profiler );
 		netdev->op->poll ( netdev );
+		cost = profile ( &profiler );
+		netdev->perf.polls++;
+		netdev->perf.poll_cost += cost;
+		if ( cost > netdev->perf.poll_max )
+			netdev->perf.poll_max = cost;
+		netdev_sample_rates ( netdev );
+	}
 }
 
 /**
@@ -297,6 +347,7 @@ struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev ) {
 
 	list_for_each_entry ( iobuf, &netdev->rx_queue, list ) {
 		list_del ( &iobuf->list );
+		netdev->perf.rx_queue_len--;
 		return iobuf;
 	}
 	return NULL;
@@ -350,6 +401,7 @@ struct net_device * alloc_netdev ( size_t priv_size ) {
 		netdev->link_rc = -EUNKNOWN_LINK_STATUS;
 		INIT_LIST_HEAD ( &netdev->tx_queue );
 		INIT_LIST_HEAD ( &netdev->rx_queue );
+		neighbour_init ( &netdev->neighbours );
 		netdev_settings_init ( netdev );
 		netdev->priv = ( ( ( void * ) netdev ) + sizeof ( *netdev ) );
 	}
@@ -461,6 +513,9 @@ void unregister_netdev ( struct net_device *netdev ) {
 	/* Ensure device is closed */
 	netdev_close ( netdev );
 
+	/* Discard any cached neighbours */
+	neighbour_flush ( netdev );
+
 	/* Unregister per-netdev configuration settings */
 	unregister_settings ( netdev_settings ( netdev ) );
 
@@ -653,4 +708,5 @@ static void net_step ( struct process *process __unused ) {
 struct process net_process __permanent_process = {
 	.list = LIST_HEAD_INIT ( net_process.list ),
 	.step = net_step,
+	.priority = PROCESS_PRIO_HIGH,
 };
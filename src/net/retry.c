@@ -44,8 +44,100 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Number of slots in the timer wheel (must be a power of two) */
+#define RETRY_WHEEL_SIZE 64
+
+/** Number of timer wheel slots per second */
+#define RETRY_WHEEL_HZ 32
+
+/**
+ * Timer wheel
+ *
+ * Each running timer is placed in the slot corresponding to its
+ * expiry time, measured in slot periods, modulo the wheel size.  A
+ * slot may contain timers that are not due to expire until a later
+ * revolution of the wheel.
+ */
+static struct list_head retry_wheel[RETRY_WHEEL_SIZE];
+
+/** Length of a timer wheel slot period (in ticks) */
+static unsigned long retry_wheel_period;
+
+/** Most recent slot period for which the wheel has been processed */
+static unsigned long retry_wheel_pos;
+
+/** Number of running timers */
+static unsigned int retry_wheel_count;
+
+struct process retry_process __permanent_process;
+
+/**
+ * Check if timer has expired
+ *
+ * @v timer		Retry timer
+ * @v now		Current time (in ticks)
+ * @ret expired		Timer has expired
+ */
+static inline __attribute__ (( always_inline )) int
+timer_due ( struct retry_timer *timer, unsigned long now ) {
+	return ( ( now - timer->start ) >= timer->timeout );
+}
+
+/**
+ * Get timer wheel slot
+ *
+ * @v pos		Slot period
+ * @ret slot		Timer wheel slot
+ */
+static inline __attribute__ (( always_inline )) struct list_head *
+retry_wheel_slot ( unsigned long pos ) {
+	return &retry_wheel[ pos & ( RETRY_WHEEL_SIZE - 1 ) ];
+}
+
+/**
+ * Add timer to timer wheel
+ *
+ * @v timer		Retry timer
+ *
+ * The timer's start time and timeout must already be set.
+ */
+static void retry_wheel_add ( struct retry_timer *timer ) {
+	unsigned long pos;
+	unsigned int i;
+
+	/* Initialise wheel on first use */
+	if ( ! retry_wheel_period ) {
+		for ( i = 0 ; i < RETRY_WHEEL_SIZE ; i++ )
+			INIT_LIST_HEAD ( &retry_wheel[i] );
+		retry_wheel_period = ( TICKS_PER_SEC / RETRY_WHEEL_HZ );
+		if ( ! retry_wheel_period )
+			retry_wheel_period = 1;
+		retry_wheel_pos = ( currticks() / retry_wheel_period );
+	}
+
+	/* Timers that have already expired go into the next slot to
+	 * be processed, to avoid waiting a full revolution.
+	 */
+	pos = ( ( timer->start + timer->timeout ) / retry_wheel_period );
+	if ( ( ( long ) ( pos - retry_wheel_pos ) ) <= 0 )
+		pos = ( retry_wheel_pos + 1 );
+
+	list_add_tail ( &timer->list, retry_wheel_slot ( pos ) );
+	retry_wheel_count++;
+
+	/* Wake retry timer process */
+	process_wake ( &retry_process );
+}
+
+/**
+ * Remove timer from timer wheel
+ *
+ * @v timer		Retry timer
+ */
+static void retry_wheel_del ( struct retry_timer *timer ) {
+	list_del ( &timer->list );
+	retry_wheel_count--;
+}
 
 /**
  * Start timer
@@ -57,8 +149,8 @@ static LIST_HEAD ( timers );
  * be stopped and the timer's callback function will be called.
  */
 void start_timer ( struct retry_timer *timer ) {
-	if ( ! timer->running )
-		list_add ( &timer->list, &timers );
+	if ( timer->running )
+		retry_wheel_del ( timer );
 	timer->start = currticks();
 	timer->running = 1;
 
@@ -72,6 +164,7 @@ void start_timer ( struct retry_timer *timer ) {
 	if ( timer->timeout < timer->min_timeout )
 		timer->timeout = timer->min_timeout;
 
+	retry_wheel_add ( timer );
 	DBG2 ( "Timer %p started at time %ld (expires at %ld)\n",
 	       timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -84,7 +177,9 @@ void start_timer ( struct retry_timer *timer ) {
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 	start_timer ( timer );
+	retry_wheel_del ( timer );
 	timer->timeout = timeout;
+	retry_wheel_add ( timer );
 	DBG2 ( "Timer %p expiry time changed to %ld\n",
 	       timer, ( timer->start + timer->timeout ) );
 }
@@ -105,7 +200,7 @@ void stop_timer ( struct retry_timer *timer ) {
 	if ( ! timer->running )
 		return;
 
-	list_del ( &timer->list );
+	retry_wheel_del ( timer );
 	runtime = ( now - timer->start );
 	timer->running = 0;
 	DBG2 ( "Timer %p stopped at time %ld (ran for %ld)\n",
@@ -150,7 +245,7 @@ static void timer_expired ( struct retry_timer *timer ) {
 	DBG2 ( "Timer %p stopped at time %ld on expiry\n",
 	       timer, currticks() );
 	assert ( timer->running );
-	list_del ( &timer->list );
+	retry_wheel_del ( timer );
 	timer->running = 0;
 	timer->count++;
 
@@ -168,21 +263,107 @@ static void timer_expired ( struct retry_timer *timer ) {
 }
 
 /**
- * Single-step the retry timer list
+ * Expire a single due timer within a timer wheel slot
  *
- * @v process		Retry timer process
+ * @v slot		Timer wheel slot
+ * @v now		Current time (in ticks)
+ * @ret expired		A timer was expired
+ *
+ * Since an expiry callback may start or stop arbitrary timers, the
+ * slot must be rescanned after each expiry.
  */
-static void retry_step ( struct process *process __unused ) {
+static int retry_expire_slot ( struct list_head *slot, unsigned long now ) {
 	struct retry_timer *timer;
-	struct retry_timer *tmp;
-	unsigned long now = currticks();
-	unsigned long used;
 
-	list_for_each_entry_safe ( timer, tmp, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout )
+	list_for_each_entry ( timer, slot, list ) {
+		if ( timer_due ( timer, now ) ) {
 			timer_expired ( timer );
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * Single-step the retry timer wheel
+ *
+ * @v process		Retry timer process
+ *
+ * Only the slots corresponding to slot periods that have elapsed
+ * since the previous step (plus the current, partially elapsed,
+ * period) are examined.
+ */
+static void retry_step ( struct process *process ) {
+	unsigned long now;
+	unsigned long pos;
+	unsigned long end;
+
+	/* Sleep unless at least one timer is running */
+	if ( ! retry_wheel_count ) {
+		process_sleep ( process );
+		return;
+	}
+
+	/* Process each elapsed slot period, visiting each slot at
+	 * most once if more than a full revolution has elapsed.
+	 */
+	now = currticks();
+	end = ( now / retry_wheel_period );
+	pos = retry_wheel_pos;
+	if ( ( end - pos ) > RETRY_WHEEL_SIZE )
+		pos = ( end - RETRY_WHEEL_SIZE );
+	while ( pos != end ) {
+		/* Advance wheel before expiring timers, so that a
+		 * timer restarted by an expiry callback cannot be
+		 * expired again within the same slot.
+		 */
+		retry_wheel_pos = ++pos;
+		while ( retry_expire_slot ( retry_wheel_slot ( pos ), now ) ) {}
+	}
+
+	/* Leave the current slot period to be examined again */
+	retry_wheel_pos = ( end - 1 );
+}
+
+/**
+ * Calculate time until next timer expiry
+ *
+ * @ret ticks		Ticks until next expiry
+ *
+ * The returned value is zero if any timer is already due, and is
+ * capped at one revolution of the timer wheel.  This may be used to
+ * decide whether or not it is safe to halt the CPU while idle.
+ */
+unsigned long retry_idle_ticks ( void ) {
+	struct retry_timer *timer;
+	unsigned long now;
+	unsigned long pos;
+	unsigned long remaining;
+	unsigned long idle;
+	unsigned int i;
+
+	/* Do nothing unless at least one timer is running */
+	idle = ( ( RETRY_WHEEL_SIZE * TICKS_PER_SEC ) / RETRY_WHEEL_HZ );
+	if ( ! retry_wheel_count )
+		return idle;
+
+	/* Find the earliest expiry, stopping once no later slot
+	 * could contain anything earlier.
+	 */
+	now = currticks();
+	pos = ( retry_wheel_pos + 1 );
+	for ( i = 0 ; i < RETRY_WHEEL_SIZE ; i++, pos++ ) {
+		list_for_each_entry ( timer, retry_wheel_slot ( pos ), list ) {
+			if ( timer_due ( timer, now ) )
+				return 0;
+			remaining = ( timer->timeout - ( now - timer->start ) );
+			if ( remaining < idle )
+				idle = remaining;
+		}
+		if ( idle <= ( i * retry_wheel_period ) )
+			break;
 	}
+	return idle;
 }
 
 /** Retry timer process */
@@ -12,8 +12,10 @@
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
+#include <ipxe/in.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/tcp.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -87,6 +89,9 @@ struct tcp_connection {
 	struct retry_timer timer;
 	/** Shutdown (TIME_WAIT) timer */
 	struct retry_timer wait;
+
+	/** Statistics */
+	struct tcp_statistics stats;
 };
 
 /** TCP flags */
@@ -97,6 +102,10 @@ enum tcp_flags {
 	TCP_TS_ENABLED = 0x0002,
 	/** TCP acknowledgement is pending */
 	TCP_ACK_PENDING = 0x0004,
+	/** Transmission is stalled on a zero send window */
+	TCP_TX_STALLED = 0x0008,
+	/** Reception is stalled on a zero receive window */
+	TCP_RX_STALLED = 0x0010,
 };
 
 /** TCP internal header
@@ -127,12 +136,19 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/** Statistics for recently closed TCP connections */
+static struct tcp_statistics tcp_history[TCP_STAT_HISTORY];
+
+/** Number of closed TCP connections recorded */
+static unsigned int tcp_history_count;
+
 /* Forward declarations */
 static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 			uint32_t win );
+static size_t tcp_xfer_window ( struct tcp_connection *tcp );
 
 /**
  * Name TCP state
@@ -192,6 +208,95 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
 		DBGC2 ( tcp, " ACK" );
 }
 
+/***************************************************************************
+ *
+ * Statistics
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Take snapshot of TCP connection statistics
+ *
+ * @v tcp		TCP connection
+ * @v stats		Statistics to fill in
+ */
+static void tcp_snapshot ( struct tcp_connection *tcp,
+			   struct tcp_statistics *stats ) {
+
+	memcpy ( stats, &tcp->stats, sizeof ( *stats ) );
+	memcpy ( &stats->peer, &tcp->peer, sizeof ( stats->peer ) );
+	stats->local_port = tcp->local_port;
+	stats->state = tcp_state ( tcp->tcp_state );
+	/* The retransmission timeout is four times the smoothed RTT */
+	stats->rtt = ( tcp->timer.timeout / 4 );
+}
+
+/**
+ * Record statistics for a closing TCP connection
+ *
+ * @v tcp		TCP connection
+ *
+ * The statistics are retained for display by tcp_stat(), and a
+ * summary is added to the boot timeline trace.
+ */
+static void tcp_record ( struct tcp_connection *tcp ) {
+	struct tcp_statistics *stats;
+	char subject[TRACE_SUBJECT_LEN];
+
+	/* Store in history */
+	stats = &tcp_history[ tcp_history_count++ % TCP_STAT_HISTORY ];
+	tcp_snapshot ( tcp, stats );
+
+	/* Add summary to trace, if enabled */
+	if ( ! TRACE_ENABLED )
+		return;
+	snprintf ( subject, sizeof ( subject ), "%d->%d", tcp->local_port,
+		   ntohs ( tcp->peer.st_port ) );
+	trace ( "tcp-close", subject, stats->rx_bytes );
+	if ( stats->retransmits )
+		trace ( "tcp-retransmit", subject, stats->retransmits );
+	if ( stats->tx_stalls || stats->rx_stalls ) {
+		trace ( "tcp-stall", subject,
+			( stats->tx_stalls + stats->rx_stalls ) );
+	}
+	trace ( "tcp-rtt-ms", subject,
+		( ( stats->rtt * 1000 ) / TICKS_PER_SEC ) );
+}
+
+/**
+ * Get TCP connection statistics
+ *
+ * @v index		Connection index
+ * @v stats		Statistics to fill in
+ * @ret rc		Return status code
+ *
+ * Open connections are listed first, followed by the most recently
+ * closed connections (most recent first).
+ */
+int tcp_stat ( unsigned int index, struct tcp_statistics *stats ) {
+	struct tcp_connection *tcp;
+	unsigned int count;
+
+	/* Check open connections */
+	list_for_each_entry ( tcp, &tcp_conns, list ) {
+		if ( index-- == 0 ) {
+			tcp_snapshot ( tcp, stats );
+			return 0;
+		}
+	}
+
+	/* Check closed connections */
+	count = tcp_history_count;
+	if ( count > TCP_STAT_HISTORY )
+		count = TCP_STAT_HISTORY;
+	if ( index >= count )
+		return -ENOENT;
+	memcpy ( stats, &tcp_history[ ( tcp_history_count - index - 1 ) %
+				      TCP_STAT_HISTORY ], sizeof ( *stats ) );
+	return 0;
+}
+
 /***************************************************************************
  *
  * Open and close
@@ -337,6 +442,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 		/* Remove from list and drop reference */
 		stop_timer ( &tcp->timer );
 		list_del ( &tcp->list );
+		tcp_record ( tcp );
 		ref_put ( &tcp->refcnt );
 		DBGC ( tcp, "TCP %p connection deleted\n", tcp );
 		return;
@@ -461,6 +567,16 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
 					     NULL, 0 );
 	}
+
+	/* Count each stall on a zero send window */
+	if ( ( len == 0 ) && TCP_CAN_SEND_DATA ( tcp->tcp_state ) &&
+	     ( ! list_empty ( &tcp->tx_queue ) ) ) {
+		if ( ! ( tcp->flags & TCP_TX_STALLED ) )
+			tcp->stats.tx_stalls++;
+		tcp->flags |= TCP_TX_STALLED;
+	} else {
+		tcp->flags &= ~TCP_TX_STALLED;
+	}
 	seq_len = len;
 	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
 	if ( flags & ( TCP_SYN | TCP_FIN ) ) {
@@ -506,6 +622,16 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 	if ( tcp->rcv_win < max_rcv_win )
 		tcp->rcv_win = max_rcv_win;
 
+	/* Count each stall on a zero receive window */
+	if ( ( tcp->rcv_win == 0 ) &&
+	     ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) ) {
+		if ( ! ( tcp->flags & TCP_RX_STALLED ) )
+			tcp->stats.rx_stalls++;
+		tcp->flags |= TCP_RX_STALLED;
+	} else {
+		tcp->flags &= ~TCP_RX_STALLED;
+	}
+
 	/* Fill up the TCP header */
 	payload = iobuf->data;
 	if ( flags & TCP_SYN ) {
@@ -555,6 +681,10 @@ static int tcp_xmit ( struct tcp_connection *tcp ) {
 	/* Clear ACK-pending flag */
 	tcp->flags &= ~TCP_ACK_PENDING;
 
+	/* Update statistics */
+	tcp->stats.tx_segments++;
+	tcp->stats.tx_bytes += len;
+
 	return 0;
 }
 
@@ -587,7 +717,12 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
-		/* Otherwise, retransmit the packet */
+		/* Otherwise, retransmit the packet.  (The timer is
+		 * also used to send the initial SYN, which is not a
+		 * retransmission.)
+		 */
+		if ( tcp->snd_sent )
+			tcp->stats.retransmits++;
 		tcp_xmit ( tcp );
 	}
 }
@@ -764,6 +899,7 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 		tcp->rcv_ack = seq;
 		if ( options->tsopt )
 			tcp->flags |= TCP_TS_ENABLED;
+		trace ( "tcp-connect", NULL, ntohs ( tcp->peer.st_port ) );
 	}
 
 	/* Ignore duplicate SYN */
@@ -819,8 +955,11 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	 * duplicate ACK is received and we still have data in our
 	 * transmit queue.)
 	 */
-	if ( ack_len == 0 )
+	if ( ack_len == 0 ) {
+		if ( tcp->snd_sent )
+			tcp->stats.dup_acks++;
 		return 0;
+	}
 
 	/* Stop the retransmission timer */
 	stop_timer ( &tcp->timer );
@@ -871,6 +1010,7 @@ static int tcp_rx_data ( struct tcp_connection *tcp, uint32_t seq,
 	already_rcvd = ( tcp->rcv_ack - seq );
 	len = iob_len ( iobuf );
 	if ( already_rcvd >= len ) {
+		tcp->stats.rx_drops++;
 		free_iob ( iobuf );
 		return 0;
 	}
@@ -979,6 +1119,8 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	     ( tcp_cmp ( seq, tcp->rcv_ack + tcp->rcv_win ) >= 0 ) ||
 	     ( tcp_cmp ( seq + seq_len, tcp->rcv_ack ) < 0 ) ||
 	     ( seq_len == 0 ) ) {
+		if ( seq_len )
+			tcp->stats.rx_drops++;
 		free_iob ( iobuf );
 		return;
 	}
@@ -1066,6 +1208,7 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	unsigned int flags;
 	size_t len;
 	uint32_t seq_len;
+	size_t old_xfer_window;
 	int rc;
 
 	/* Sanity check packet */
@@ -1125,6 +1268,9 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		goto discard;
 	}
 
+	/* Record old data transfer window */
+	old_xfer_window = tcp_xfer_window ( tcp );
+
 	/* Update timestamp, if applicable */
 	if ( options.tsopt && tcp_in_window ( tcp->rcv_ack, seq, seq_len ) )
 		tcp->ts_recent = ntohl ( options.tsopt->tsval );
@@ -1137,10 +1283,16 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		}
 	}
 
+	/* Update statistics */
+	tcp->stats.rx_segments++;
+	tcp->stats.rx_bytes += len;
+
 	/* Force an ACK if this packet is out of order */
 	if ( ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) &&
 	     ( seq != tcp->rcv_ack ) ) {
 		tcp->flags |= TCP_ACK_PENDING;
+		if ( len )
+			tcp->stats.rx_ooo++;
 	}
 
 	/* Handle SYN, if present */
@@ -1167,6 +1319,10 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	/* Send out any pending data */
 	tcp_xmit ( tcp );
 
+	/* Notify application if window has changed */
+	if ( tcp_xfer_window ( tcp ) != old_xfer_window )
+		xfer_window_changed ( &tcp->xfer );
+
 	/* If this packet was the last we expect to receive, set up
 	 * timer to expire and cause the connection to be freed.
 	 */
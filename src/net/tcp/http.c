@@ -462,12 +462,26 @@ static void http_step ( struct process *process ) {
 					  host ) ) != 0 ) {
 			http_done ( http, rc );
 		}
+	} else {
+		/* Wait for socket to become ready */
+		process_sleep ( process );
 	}
 }
 
+/**
+ * Handle change of socket flow control window
+ *
+ * @v http		HTTP request
+ */
+static void http_socket_window_changed ( struct http_request *http ) {
+	process_wake ( &http->process );
+}
+
 /** HTTP socket interface operations */
 static struct interface_operation http_socket_operations[] = {
 	INTF_OP ( xfer_deliver, struct http_request *, http_socket_deliver ),
+	INTF_OP ( xfer_window_changed, struct http_request *,
+		  http_socket_window_changed ),
 	INTF_OP ( intf_close, struct http_request *, http_done ),
 };
 
@@ -1194,6 +1194,7 @@ static void iscsi_start_tx ( struct iscsi_session *iscsi ) {
 
 	/* Flag TX engine to start transmitting */
 	iscsi->tx_state = ISCSI_TX_BHS;
+	process_wake ( &iscsi->process );
 }
 
 /**
@@ -1306,7 +1307,8 @@ static void iscsi_tx_step ( struct process *process ) {
 	while ( 1 ) {
 		switch ( iscsi->tx_state ) {
 		case ISCSI_TX_IDLE:
-			/* Stop processing */
+			/* Stop processing until next PDU */
+			process_sleep ( process );
 			return;
 		case ISCSI_TX_BHS:
 			tx = iscsi_tx_bhs;
@@ -1335,7 +1337,10 @@ static void iscsi_tx_step ( struct process *process ) {
 
 		/* Check for window availability, if needed */
 		if ( tx_len && ( xfer_window ( &iscsi->socket ) == 0 ) ) {
-			/* Cannot transmit at this point; stop processing */
+			/* Cannot transmit at this point; stop processing
+			 * until the window changes.
+			 */
+			process_sleep ( process );
 			return;
 		}
 
@@ -1584,10 +1589,21 @@ static int iscsi_vredirect ( struct iscsi_session *iscsi, int type,
 }
 			     
 
+/**
+ * Handle change of socket flow control window
+ *
+ * @v iscsi		iSCSI session
+ */
+static void iscsi_socket_window_changed ( struct iscsi_session *iscsi ) {
+	process_wake ( &iscsi->process );
+}
+
 /** iSCSI socket interface operations */
 static struct interface_operation iscsi_socket_operations[] = {
 	INTF_OP ( xfer_deliver, struct iscsi_session *, iscsi_socket_deliver ),
 	INTF_OP ( xfer_vredirect, struct iscsi_session *, iscsi_vredirect ),
+	INTF_OP ( xfer_window_changed, struct iscsi_session *,
+		  iscsi_socket_window_changed ),
 	INTF_OP ( intf_close, struct iscsi_session *, iscsi_socket_close ),
 };
 
@@ -33,6 +33,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/hmac.h>
 #include <ipxe/md5.h>
 #include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/sha512.h>
 #include <ipxe/aes.h>
 #include <ipxe/rsa.h>
 #include <ipxe/iobuf.h>
@@ -41,6 +43,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/asn1.h>
 #include <ipxe/x509.h>
 #include <ipxe/tls.h>
+#include <ipxe/trace.h>
 
 static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 				const void *data, size_t len );
@@ -239,6 +242,16 @@ static void tls_prf ( struct tls_session *tls, void *secret, size_t secret_len,
 
 	va_start ( seeds, out_len );
 
+	/* TLSv1.2 uses a single hash function, specified by the
+	 * cipher suite.
+	 */
+	if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
+		tls_p_hash_va ( tls, tls->prf_digest, secret, secret_len,
+				out, out_len, seeds );
+		va_end ( seeds );
+		return;
+	}
+
 	/* Split secret into two, with an overlap of up to one byte */
 	subsecret_len = ( ( secret_len + 1 ) / 2 );
 	md5_secret = secret;
@@ -323,9 +336,11 @@ static void tls_generate_master_secret ( struct tls_session *tls ) {
 static int tls_generate_keys ( struct tls_session *tls ) {
 	struct tls_cipherspec *tx_cipherspec = &tls->tx_cipherspec_pending;
 	struct tls_cipherspec *rx_cipherspec = &tls->rx_cipherspec_pending;
+	struct cipher_algorithm *cipher = tx_cipherspec->cipher;
 	size_t hash_size = tx_cipherspec->digest->digestsize;
 	size_t key_size = tx_cipherspec->key_len;
-	size_t iv_size = tx_cipherspec->cipher->blocksize;
+	size_t iv_size = ( is_auth_cipher ( cipher ) ?
+			   TLS_AEAD_FIXED_IV_LEN : cipher->blocksize );
 	size_t total = ( 2 * ( hash_size + key_size + iv_size ) );
 	uint8_t key_block[total];
 	uint8_t *key;
@@ -376,14 +391,24 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 	DBGC_HD ( tls, key, key_size );
 	key += key_size;
 
-	/* TX initialisation vector */
-	cipher_setiv ( tx_cipherspec->cipher, tx_cipherspec->cipher_ctx, key );
+	/* TX initialisation vector (or fixed part of AEAD nonce) */
+	if ( is_auth_cipher ( cipher ) ) {
+		memcpy ( tx_cipherspec->fixed_iv, key, iv_size );
+	} else {
+		cipher_setiv ( tx_cipherspec->cipher,
+			       tx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p TX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
 
-	/* RX initialisation vector */
-	cipher_setiv ( rx_cipherspec->cipher, rx_cipherspec->cipher_ctx, key );
+	/* RX initialisation vector (or fixed part of AEAD nonce) */
+	if ( is_auth_cipher ( cipher ) ) {
+		memcpy ( rx_cipherspec->fixed_iv, key, iv_size );
+	} else {
+		cipher_setiv ( rx_cipherspec->cipher,
+			       rx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p RX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
@@ -408,7 +433,7 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 static void tls_clear_cipher ( struct tls_session *tls __unused,
 			       struct tls_cipherspec *cipherspec ) {
 	free ( cipherspec->dynamic );
-	memset ( cipherspec, 0, sizeof ( cipherspec ) );
+	memset ( cipherspec, 0, sizeof ( *cipherspec ) );
 	cipherspec->pubkey = &pubkey_null;
 	cipherspec->cipher = &cipher_null;
 	cipherspec->digest = &digest_null;
@@ -476,6 +501,7 @@ static int tls_select_cipher ( struct tls_session *tls,
 	struct pubkey_algorithm *pubkey = &pubkey_null;
 	struct cipher_algorithm *cipher = &cipher_null;
 	struct digest_algorithm *digest = &digest_null;
+	struct digest_algorithm *prf_digest = &sha256_algorithm;
 	unsigned int key_len = 0;
 	int rc;
 
@@ -490,12 +516,30 @@ static int tls_select_cipher ( struct tls_session *tls,
 		cipher = &aes_cbc_algorithm;
 		digest = &sha1_algorithm;
 		break;
+	case htons ( TLS_RSA_WITH_AES_128_GCM_SHA256 ):
+		key_len = ( 128 / 8 );
+		cipher = &aes_gcm_algorithm;
+		break;
+	case htons ( TLS_RSA_WITH_AES_256_GCM_SHA384 ):
+		key_len = ( 256 / 8 );
+		cipher = &aes_gcm_algorithm;
+		prf_digest = &sha384_algorithm;
+		break;
 	default:
 		DBGC ( tls, "TLS %p does not support cipher %04x\n",
 		       tls, ntohs ( cipher_suite ) );
 		return -ENOTSUP;
 	}
 
+	/* AEAD cipher suites exist only in TLSv1.2 */
+	if ( is_auth_cipher ( cipher ) &&
+	     ( tls->version < TLS_VERSION_TLS_1_2 ) ) {
+		DBGC ( tls, "TLS %p cannot use cipher %04x with version "
+		       "%04x\n", tls, ntohs ( cipher_suite ), tls->version );
+		return -ENOTSUP;
+	}
+	tls->prf_digest = prf_digest;
+
 	/* Set ciphers */
 	if ( ( rc = tls_set_cipher ( tls, &tls->tx_cipherspec_pending, pubkey,
 				     cipher, digest, key_len ) ) != 0 )
@@ -526,7 +570,8 @@ static int tls_change_cipher ( struct tls_session *tls,
 	if ( /* FIXME (when pubkey is not hard-coded to RSA):
 	      * ( pending->pubkey == &pubkey_null ) || */
 	     ( pending->cipher == &cipher_null ) ||
-	     ( pending->digest == &digest_null ) ) {
+	     ( ( pending->digest == &digest_null ) &&
+	       ( ! is_auth_cipher ( pending->cipher ) ) ) ) {
 		DBGC ( tls, "TLS %p refusing to use null cipher\n", tls );
 		return -ENOTSUP;
 	}
@@ -555,6 +600,10 @@ static void tls_add_handshake ( struct tls_session *tls,
 
 	digest_update ( &md5_algorithm, tls->handshake_md5_ctx, data, len );
 	digest_update ( &sha1_algorithm, tls->handshake_sha1_ctx, data, len );
+	digest_update ( &sha256_algorithm, tls->handshake_sha256_ctx,
+			data, len );
+	digest_update ( &sha384_algorithm, tls->handshake_sha384_ctx,
+			data, len );
 }
 
 /**
@@ -562,22 +611,37 @@ static void tls_add_handshake ( struct tls_session *tls,
  *
  * @v tls		TLS session
  * @v out		Output buffer
+ * @ret len		Length of verification hash
  *
- * Calculates the MD5+SHA1 digest over all handshake messages seen so
- * far.
+ * Calculates the MD5+SHA1 digest (or, for TLSv1.2, the PRF digest)
+ * over all handshake messages seen so far.  The output buffer must
+ * be large enough for any handshake digest.
  */
-static void tls_verify_handshake ( struct tls_session *tls, void *out ) {
+static size_t tls_verify_handshake ( struct tls_session *tls, void *out ) {
 	struct digest_algorithm *md5 = &md5_algorithm;
 	struct digest_algorithm *sha1 = &sha1_algorithm;
+	struct digest_algorithm *prf = tls->prf_digest;
 	uint8_t md5_ctx[md5->ctxsize];
 	uint8_t sha1_ctx[sha1->ctxsize];
+	uint8_t prf_ctx[prf->ctxsize];
 	void *md5_digest = out;
 	void *sha1_digest = ( out + md5->digestsize );
 
+	/* TLSv1.2 uses only the PRF digest */
+	if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
+		memcpy ( prf_ctx, ( ( prf == &sha384_algorithm ) ?
+				    tls->handshake_sha384_ctx :
+				    tls->handshake_sha256_ctx ),
+			 sizeof ( prf_ctx ) );
+		digest_final ( prf, prf_ctx, out );
+		return prf->digestsize;
+	}
+
 	memcpy ( md5_ctx, tls->handshake_md5_ctx, sizeof ( md5_ctx ) );
 	memcpy ( sha1_ctx, tls->handshake_sha1_ctx, sizeof ( sha1_ctx ) );
 	digest_final ( md5, md5_ctx, md5_digest );
 	digest_final ( sha1, sha1_ctx, sha1_digest );
+	return ( md5->digestsize + sha1->digestsize );
 }
 
 /******************************************************************************
@@ -618,7 +682,7 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 		uint8_t random[32];
 		uint8_t session_id_len;
 		uint16_t cipher_suite_len;
-		uint16_t cipher_suites[2];
+		uint16_t cipher_suites[4];
 		uint8_t compression_methods_len;
 		uint8_t compression_methods[1];
 	} __attribute__ (( packed )) hello;
@@ -627,11 +691,13 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 	hello.type_length = ( cpu_to_le32 ( TLS_CLIENT_HELLO ) |
 			      htonl ( sizeof ( hello ) -
 				      sizeof ( hello.type_length ) ) );
-	hello.version = htons ( TLS_VERSION_TLS_1_0 );
+	hello.version = htons ( TLS_VERSION_TLS_1_2 );
 	memcpy ( &hello.random, &tls->client_random, sizeof ( hello.random ) );
 	hello.cipher_suite_len = htons ( sizeof ( hello.cipher_suites ) );
-	hello.cipher_suites[0] = htons ( TLS_RSA_WITH_AES_128_CBC_SHA );
-	hello.cipher_suites[1] = htons ( TLS_RSA_WITH_AES_256_CBC_SHA );
+	hello.cipher_suites[0] = htons ( TLS_RSA_WITH_AES_128_GCM_SHA256 );
+	hello.cipher_suites[1] = htons ( TLS_RSA_WITH_AES_256_GCM_SHA384 );
+	hello.cipher_suites[2] = htons ( TLS_RSA_WITH_AES_128_CBC_SHA );
+	hello.cipher_suites[3] = htons ( TLS_RSA_WITH_AES_256_CBC_SHA );
 	hello.compression_methods_len = sizeof ( hello.compression_methods );
 
 	return tls_send_handshake ( tls, &hello, sizeof ( hello ) );
@@ -702,16 +768,17 @@ static int tls_send_finished ( struct tls_session *tls ) {
 		uint32_t type_length;
 		uint8_t verify_data[12];
 	} __attribute__ (( packed )) finished;
-	uint8_t digest[MD5_DIGEST_SIZE + SHA1_DIGEST_SIZE];
+	uint8_t digest[SHA512_DIGEST_SIZE];
+	size_t digest_len;
 
 	memset ( &finished, 0, sizeof ( finished ) );
 	finished.type_length = ( cpu_to_le32 ( TLS_FINISHED ) |
 				 htonl ( sizeof ( finished ) -
 					 sizeof ( finished.type_length ) ) );
-	tls_verify_handshake ( tls, digest );
+	digest_len = tls_verify_handshake ( tls, digest );
 	tls_prf_label ( tls, &tls->master_secret, sizeof ( tls->master_secret ),
 			finished.verify_data, sizeof ( finished.verify_data ),
-			"client finished", digest, sizeof ( digest ) );
+			"client finished", digest, digest_len );
 
 	return tls_send_handshake ( tls, &finished, sizeof ( finished ) );
 }
@@ -807,22 +874,27 @@ static int tls_new_server_hello ( struct tls_session *tls,
 		char next[0];
 	} __attribute__ (( packed )) *hello_b = ( void * ) &hello_a->next;
 	void *end = hello_b->next;
+	uint16_t version = ntohs ( hello_a->version );
 	int rc;
 
-	/* Sanity check */
-	if ( end != ( data + len ) ) {
-		DBGC ( tls, "TLS %p received overlength Server Hello\n", tls );
+	/* Sanity check (ignoring any extensions) */
+	if ( end > ( data + len ) ) {
+		DBGC ( tls, "TLS %p received underlength Server Hello\n",
+		       tls );
 		DBGC_HD ( tls, data, len );
 		return -EINVAL;
 	}
 
 	/* Check protocol version */
-	if ( ntohs ( hello_a->version ) < TLS_VERSION_TLS_1_0 ) {
+	if ( ( version < TLS_VERSION_TLS_1_0 ) ||
+	     ( version > TLS_VERSION_TLS_1_2 ) ) {
 		DBGC ( tls, "TLS %p does not support protocol version %d.%d\n",
-		       tls, ( ntohs ( hello_a->version ) >> 8 ),
-		       ( ntohs ( hello_a->version ) & 0xff ) );
+		       tls, ( version >> 8 ), ( version & 0xff ) );
 		return -ENOTSUP;
 	}
+	tls->version = version;
+	DBGC ( tls, "TLS %p using protocol version %d.%d\n",
+	       tls, ( version >> 8 ), ( version & 0xff ) );
 
 	/* Copy out server random bytes */
 	memcpy ( &tls->server_random, &hello_a->random,
@@ -930,6 +1002,7 @@ static int tls_new_server_hello_done ( struct tls_session *tls,
 
 	/* Start sending the Client Key Exchange */
 	tls->tx_state = TLS_TX_CLIENT_KEY_EXCHANGE;
+	process_wake ( &tls->process );
 
 	return 0;
 }
@@ -947,6 +1020,10 @@ static int tls_new_finished ( struct tls_session *tls,
 
 	/* FIXME: Handle this properly */
 	tls->tx_state = TLS_TX_DATA;
+	trace ( "tls-handshake", NULL, 0 );
+
+	/* Notify application that we are ready to accept data */
+	xfer_window_changed ( &tls->plainstream );
 	( void ) data;
 	( void ) len;
 	return 0;
@@ -1089,86 +1166,142 @@ static void tls_hmac ( struct tls_session *tls __unused,
 }
 
 /**
- * Allocate and assemble stream-ciphered record from data and MAC portions
+ * Allocate and assemble AEAD-ciphered record
  *
  * @v tls		TLS session
- * @ret data		Data
- * @ret len		Length of data
- * @ret digest		MAC digest
- * @ret plaintext_len	Length of plaintext record
- * @ret plaintext	Allocated plaintext record
+ * @v plaintext_tlshdr	Plaintext record header
+ * @v data		Data
+ * @v len		Length of data
+ * @ret ciphertext	Ciphertext record, or NULL on error
+ *
+ * The data are copied directly into the ciphertext I/O buffer and
+ * then encrypted and authenticated in place.  The sequence number is
+ * used as the explicit part of the nonce, which guarantees that no
+ * nonce is ever reused with the same key.
  */
-static void * __malloc tls_assemble_stream ( struct tls_session *tls,
-				    const void *data, size_t len,
-				    void *digest, size_t *plaintext_len ) {
-	size_t mac_len = tls->tx_cipherspec.digest->digestsize;
-	void *plaintext;
+static struct io_buffer * tls_assemble_aead ( struct tls_session *tls,
+					      struct tls_header *plaintext_tlshdr,
+					      const void *data, size_t len ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
+	struct tls_aead_nonce nonce;
+	struct tls_aead_data aad;
+	struct io_buffer *ciphertext;
+	struct tls_header *tlshdr;
+	size_t record_len;
 	void *content;
-	void *mac;
 
-	/* Calculate stream-ciphered struct length */
-	*plaintext_len = ( len + mac_len );
+	/* Construct nonce and additional data */
+	memcpy ( nonce.fixed, cipherspec->fixed_iv, sizeof ( nonce.fixed ) );
+	nonce.seq = cpu_to_be64 ( tls->tx_seq );
+	aad.seq = nonce.seq;
+	aad.tlshdr = *plaintext_tlshdr;
 
-	/* Allocate stream-ciphered struct */
-	plaintext = malloc ( *plaintext_len );
-	if ( ! plaintext )
+	/* Allocate ciphertext */
+	record_len = ( sizeof ( nonce.seq ) + len + cipher->authsize );
+	ciphertext = xfer_alloc_iob ( &tls->cipherstream,
+				      ( sizeof ( *tlshdr ) + record_len ) );
+	if ( ! ciphertext )
 		return NULL;
-	content = plaintext;
-	mac = ( content + len );
 
-	/* Fill in stream-ciphered struct */
+	/* Assemble record */
+	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
+	tlshdr->type = plaintext_tlshdr->type;
+	tlshdr->version = plaintext_tlshdr->version;
+	tlshdr->length = htons ( record_len );
+	memcpy ( iob_put ( ciphertext, sizeof ( nonce.seq ) ), &nonce.seq,
+		 sizeof ( nonce.seq ) );
+	content = iob_put ( ciphertext, len );
 	memcpy ( content, data, len );
-	memcpy ( mac, digest, mac_len );
 
-	return plaintext;
+	/* Encrypt and authenticate in place */
+	cipher_setiv ( cipher, cipherspec->cipher_ctx, &nonce );
+	cipher_encrypt ( cipher, cipherspec->cipher_ctx, &aad, NULL,
+			 sizeof ( aad ) );
+	cipher_encrypt ( cipher, cipherspec->cipher_ctx, content, content,
+			 len );
+	cipher_auth ( cipher, cipherspec->cipher_ctx,
+		      iob_put ( ciphertext, cipher->authsize ) );
+
+	return ciphertext;
 }
 
 /**
- * Allocate and assemble block-ciphered record from data and MAC portions
+ * Allocate and assemble stream- or block-ciphered record
  *
  * @v tls		TLS session
- * @ret data		Data
- * @ret len		Length of data
- * @ret digest		MAC digest
- * @ret plaintext_len	Length of plaintext record
- * @ret plaintext	Allocated plaintext record
+ * @v plaintext_tlshdr	Plaintext record header
+ * @v data		Data
+ * @v len		Length of data
+ * @ret ciphertext	Ciphertext record, or NULL on error
+ *
+ * The data, MAC and padding are assembled directly within the
+ * ciphertext I/O buffer and then encrypted in place, using the next
+ * cipher context so that the current context remains valid if the
+ * record cannot be allocated.
  */
-static void * tls_assemble_block ( struct tls_session *tls,
-				   const void *data, size_t len,
-				   void *digest, size_t *plaintext_len ) {
-	size_t blocksize = tls->tx_cipherspec.cipher->blocksize;
-	size_t iv_len = blocksize;
-	size_t mac_len = tls->tx_cipherspec.digest->digestsize;
-	size_t padding_len;
+static struct io_buffer * tls_assemble_mac ( struct tls_session *tls,
+					     struct tls_header *plaintext_tlshdr,
+					     const void *data, size_t len ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
+	size_t blocksize = cipher->blocksize;
+	size_t mac_len = cipherspec->digest->digestsize;
+	size_t iv_len = 0;
+	size_t padding_len = 0;
+	size_t plaintext_len;
+	struct io_buffer *ciphertext;
+	struct tls_header *tlshdr;
 	void *plaintext;
 	void *iv;
 	void *content;
 	void *mac;
 	void *padding;
 
-	/* FIXME: TLSv1.1 has an explicit IV */
-	iv_len = 0;
-
-	/* Calculate block-ciphered struct length */
-	padding_len = ( ( blocksize - 1 ) & -( iv_len + len + mac_len + 1 ) );
-	*plaintext_len = ( iv_len + len + mac_len + padding_len + 1 );
+	/* Calculate record length */
+	plaintext_len = ( len + mac_len );
+	if ( ! is_stream_cipher ( cipher ) ) {
+		/* TLSv1.1 and later use an explicit IV */
+		if ( tls->version >= TLS_VERSION_TLS_1_1 )
+			iv_len = blocksize;
+		padding_len = ( ( blocksize - 1 ) &
+				-( iv_len + len + mac_len + 1 ) );
+		plaintext_len += ( iv_len + padding_len + 1 );
+	}
 
-	/* Allocate block-ciphered struct */
-	plaintext = malloc ( *plaintext_len );
-	if ( ! plaintext )
+	/* Allocate ciphertext */
+	ciphertext = xfer_alloc_iob ( &tls->cipherstream,
+				      ( sizeof ( *tlshdr ) + plaintext_len ) );
+	if ( ! ciphertext )
 		return NULL;
+
+	/* Assemble record */
+	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
+	tlshdr->type = plaintext_tlshdr->type;
+	tlshdr->version = plaintext_tlshdr->version;
+	tlshdr->length = htons ( plaintext_len );
+	plaintext = iob_put ( ciphertext, plaintext_len );
 	iv = plaintext;
 	content = ( iv + iv_len );
 	mac = ( content + len );
 	padding = ( mac + mac_len );
-
-	/* Fill in block-ciphered struct */
-	memset ( iv, 0, iv_len );
+	tls_generate_random ( iv, iv_len );
 	memcpy ( content, data, len );
-	memcpy ( mac, digest, mac_len );
-	memset ( padding, padding_len, ( padding_len + 1 ) );
+	tls_hmac ( tls, cipherspec, tls->tx_seq, plaintext_tlshdr,
+		   data, len, mac );
+	if ( ! is_stream_cipher ( cipher ) )
+		memset ( padding, padding_len, ( padding_len + 1 ) );
+
+	DBGC2 ( tls, "Sending plaintext data:\n" );
+	DBGC2_HD ( tls, plaintext, plaintext_len );
+
+	/* Encrypt in place */
+	memcpy ( cipherspec->cipher_next_ctx, cipherspec->cipher_ctx,
+		 cipher->ctxsize );
+	cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+			 plaintext, plaintext, plaintext_len );
 
-	return plaintext;
+	return ciphertext;
 }
 
 /**
@@ -1183,86 +1316,49 @@ static void * tls_assemble_block ( struct tls_session *tls,
 static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 				const void *data, size_t len ) {
 	struct tls_header plaintext_tlshdr;
-	struct tls_header *tlshdr;
 	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec;
-	void *plaintext = NULL;
-	size_t plaintext_len;
-	struct io_buffer *ciphertext = NULL;
-	size_t ciphertext_len;
-	size_t mac_len = cipherspec->digest->digestsize;
-	uint8_t mac[mac_len];
+	int is_aead = is_auth_cipher ( cipherspec->cipher );
+	struct io_buffer *ciphertext;
 	int rc;
 
 	/* Construct header */
 	plaintext_tlshdr.type = type;
-	plaintext_tlshdr.version = htons ( TLS_VERSION_TLS_1_0 );
+	plaintext_tlshdr.version = htons ( tls->version );
 	plaintext_tlshdr.length = htons ( len );
 
-	/* Calculate MAC */
-	tls_hmac ( tls, cipherspec, tls->tx_seq, &plaintext_tlshdr,
-		   data, len, mac );
-
-	/* Allocate and assemble plaintext struct */
-	if ( is_stream_cipher ( cipherspec->cipher ) ) {
-		plaintext = tls_assemble_stream ( tls, data, len, mac,
-						  &plaintext_len );
+	/* Assemble and encrypt record */
+	if ( is_aead ) {
+		ciphertext = tls_assemble_aead ( tls, &plaintext_tlshdr,
+						 data, len );
 	} else {
-		plaintext = tls_assemble_block ( tls, data, len, mac,
-						 &plaintext_len );
-	}
-	if ( ! plaintext ) {
-		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
-		       "plaintext\n", tls, plaintext_len );
-		rc = -ENOMEM;
-		goto done;
+		ciphertext = tls_assemble_mac ( tls, &plaintext_tlshdr,
+						data, len );
 	}
-
-	DBGC2 ( tls, "Sending plaintext data:\n" );
-	DBGC2_HD ( tls, plaintext, plaintext_len );
-
-	/* Allocate ciphertext */
-	ciphertext_len = ( sizeof ( *tlshdr ) + plaintext_len );
-	ciphertext = xfer_alloc_iob ( &tls->cipherstream, ciphertext_len );
 	if ( ! ciphertext ) {
-		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
-		       "ciphertext\n", tls, ciphertext_len );
-		rc = -ENOMEM;
-		goto done;
+		DBGC ( tls, "TLS %p could not allocate ciphertext for %zd "
+		       "byte record\n", tls, len );
+		return -ENOMEM;
 	}
 
-	/* Assemble ciphertext */
-	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
-	tlshdr->type = type;
-	tlshdr->version = htons ( TLS_VERSION_TLS_1_0 );
-	tlshdr->length = htons ( plaintext_len );
-	memcpy ( cipherspec->cipher_next_ctx, cipherspec->cipher_ctx,
-		 cipherspec->cipher->ctxsize );
-	cipher_encrypt ( cipherspec->cipher, cipherspec->cipher_next_ctx,
-			 plaintext, iob_put ( ciphertext, plaintext_len ),
-			 plaintext_len );
-
-	/* Free plaintext as soon as possible to conserve memory */
-	free ( plaintext );
-	plaintext = NULL;
+	/* Update TX state machine to next record.  This must happen
+	 * as soon as the record has been sealed, even if it is never
+	 * delivered, so that an AEAD nonce can never be reused.
+	 */
+	tls->tx_seq += 1;
+	if ( ! is_aead ) {
+		memcpy ( cipherspec->cipher_ctx, cipherspec->cipher_next_ctx,
+			 cipherspec->cipher->ctxsize );
+	}
 
 	/* Send ciphertext */
 	if ( ( rc = xfer_deliver_iob ( &tls->cipherstream,
-				       iob_disown ( ciphertext ) ) ) != 0 ) {
+				       ciphertext ) ) != 0 ) {
 		DBGC ( tls, "TLS %p could not deliver ciphertext: %s\n",
 		       tls, strerror ( rc ) );
-		goto done;
+		return rc;
 	}
 
-	/* Update TX state machine to next record */
-	tls->tx_seq += 1;
-	memcpy ( tls->tx_cipherspec.cipher_ctx,
-		 tls->tx_cipherspec.cipher_next_ctx,
-		 tls->tx_cipherspec.cipher->ctxsize );
-
- done:
-	free ( plaintext );
-	free_iob ( ciphertext );
-	return rc;
+	return 0;
 }
 
 /**
@@ -1334,10 +1430,9 @@ static int tls_split_block ( struct tls_session *tls,
 		DBGC_HD ( tls, plaintext, plaintext_len );
 		return -EINVAL;
 	}
-	iv_len = tls->rx_cipherspec.cipher->blocksize;
-
-	/* FIXME: TLSv1.1 uses an explicit IV */
-	iv_len = 0;
+	/* TLSv1.1 and later use an explicit IV */
+	iv_len = ( ( tls->version >= TLS_VERSION_TLS_1_1 ) ?
+		   tls->rx_cipherspec.cipher->blocksize : 0 );
 
 	mac_len = tls->rx_cipherspec.digest->digestsize;
 	padding_len = *( ( uint8_t * ) ( plaintext + plaintext_len - 1 ) );
@@ -1370,73 +1465,157 @@ static int tls_split_block ( struct tls_session *tls,
 }
 
 /**
- * Receive new ciphertext record
+ * Verify and decrypt AEAD-ciphered record
  *
  * @v tls		TLS session
  * @v tlshdr		Record header
  * @v ciphertext	Ciphertext record
+ * @ret data		Data
+ * @ret len		Length of data
  * @ret rc		Return status code
+ *
+ * The record is decrypted in place.
  */
-static int tls_new_ciphertext ( struct tls_session *tls,
-				struct tls_header *tlshdr, void *ciphertext ) {
+static int tls_decrypt_aead ( struct tls_session *tls,
+			      struct tls_header *tlshdr, void *ciphertext,
+			      void **data, size_t *len ) {
+	struct tls_cipherspec *cipherspec = &tls->rx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
+	size_t record_len = ntohs ( tlshdr->length );
+	struct tls_aead_nonce nonce;
+	struct tls_aead_data aad;
+	uint8_t verify_auth[cipher->authsize];
+	void *content;
+	size_t content_len;
+	void *auth;
+
+	/* Decompose AEAD-ciphered data */
+	if ( record_len < ( sizeof ( nonce.seq ) + cipher->authsize ) ) {
+		DBGC ( tls, "TLS %p received underlength record\n", tls );
+		DBGC_HD ( tls, ciphertext, record_len );
+		return -EINVAL;
+	}
+	content_len = ( record_len - sizeof ( nonce.seq ) - cipher->authsize );
+	content = ( ciphertext + sizeof ( nonce.seq ) );
+	auth = ( content + content_len );
+
+	/* Construct nonce and additional data */
+	memcpy ( nonce.fixed, cipherspec->fixed_iv, sizeof ( nonce.fixed ) );
+	memcpy ( &nonce.seq, ciphertext, sizeof ( nonce.seq ) );
+	aad.seq = cpu_to_be64 ( tls->rx_seq );
+	aad.tlshdr.type = tlshdr->type;
+	aad.tlshdr.version = tlshdr->version;
+	aad.tlshdr.length = htons ( content_len );
+
+	/* Decrypt and verify in place */
+	cipher_setiv ( cipher, cipherspec->cipher_ctx, &nonce );
+	cipher_decrypt ( cipher, cipherspec->cipher_ctx, &aad, NULL,
+			 sizeof ( aad ) );
+	cipher_decrypt ( cipher, cipherspec->cipher_ctx, content, content,
+			 content_len );
+	cipher_auth ( cipher, cipherspec->cipher_ctx, verify_auth );
+	if ( memcmp ( auth, verify_auth, sizeof ( verify_auth ) ) != 0 ) {
+		DBGC ( tls, "TLS %p failed authentication\n", tls );
+		return -EINVAL;
+	}
+
+	*data = content;
+	*len = content_len;
+	return 0;
+}
+
+/**
+ * Decrypt and verify stream- or block-ciphered record
+ *
+ * @v tls		TLS session
+ * @v tlshdr		Record header
+ * @v ciphertext	Ciphertext record
+ * @ret data		Data
+ * @ret len		Length of data
+ * @ret rc		Return status code
+ *
+ * The record is decrypted in place.
+ */
+static int tls_decrypt_mac ( struct tls_session *tls,
+			     struct tls_header *tlshdr, void *ciphertext,
+			     void **data, size_t *len ) {
 	struct tls_header plaintext_tlshdr;
 	struct tls_cipherspec *cipherspec = &tls->rx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->cipher;
 	size_t record_len = ntohs ( tlshdr->length );
-	void *plaintext = NULL;
-	void *data;
-	size_t len;
 	void *mac;
 	size_t mac_len = cipherspec->digest->digestsize;
 	uint8_t verify_mac[mac_len];
 	int rc;
 
-	/* Allocate buffer for plaintext */
-	plaintext = malloc ( record_len );
-	if ( ! plaintext ) {
-		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
-		       "decryption buffer\n", tls, record_len );
-		rc = -ENOMEM;
-		goto done;
+	/* Sanity check */
+	if ( record_len & ( cipher->blocksize - 1 ) ) {
+		DBGC ( tls, "TLS %p received misaligned record\n", tls );
+		DBGC_HD ( tls, ciphertext, record_len );
+		return -EINVAL;
 	}
 
 	/* Decrypt the record */
-	cipher_decrypt ( cipherspec->cipher, cipherspec->cipher_ctx,
-			 ciphertext, plaintext, record_len );
+	cipher_decrypt ( cipher, cipherspec->cipher_ctx,
+			 ciphertext, ciphertext, record_len );
 
 	/* Split record into content and MAC */
-	if ( is_stream_cipher ( cipherspec->cipher ) ) {
-		if ( ( rc = tls_split_stream ( tls, plaintext, record_len,
-					       &data, &len, &mac ) ) != 0 )
-			goto done;
+	if ( is_stream_cipher ( cipher ) ) {
+		if ( ( rc = tls_split_stream ( tls, ciphertext, record_len,
+					       data, len, &mac ) ) != 0 )
+			return rc;
 	} else {
-		if ( ( rc = tls_split_block ( tls, plaintext, record_len,
-					      &data, &len, &mac ) ) != 0 )
-			goto done;
+		if ( ( rc = tls_split_block ( tls, ciphertext, record_len,
+					      data, len, &mac ) ) != 0 )
+			return rc;
 	}
 
 	/* Verify MAC */
 	plaintext_tlshdr.type = tlshdr->type;
 	plaintext_tlshdr.version = tlshdr->version;
-	plaintext_tlshdr.length = htons ( len );
+	plaintext_tlshdr.length = htons ( *len );
 	tls_hmac ( tls, cipherspec, tls->rx_seq, &plaintext_tlshdr,
-		   data, len, verify_mac);
+		   *data, *len, verify_mac );
 	if ( memcmp ( mac, verify_mac, mac_len ) != 0 ) {
 		DBGC ( tls, "TLS %p failed MAC verification\n", tls );
-		DBGC_HD ( tls, plaintext, record_len );
-		goto done;
+		DBGC_HD ( tls, ciphertext, record_len );
+		return -EINVAL;
 	}
 
+	return 0;
+}
+
+/**
+ * Receive new ciphertext record
+ *
+ * @v tls		TLS session
+ * @v tlshdr		Record header
+ * @v ciphertext	Ciphertext record
+ * @ret rc		Return status code
+ *
+ * The record is decrypted in place, so the ciphertext buffer is
+ * overwritten.
+ */
+static int tls_new_ciphertext ( struct tls_session *tls,
+				struct tls_header *tlshdr, void *ciphertext ) {
+	void *data;
+	size_t len;
+	int rc;
+
+	/* Decrypt and verify the record */
+	if ( is_auth_cipher ( tls->rx_cipherspec.cipher ) ) {
+		rc = tls_decrypt_aead ( tls, tlshdr, ciphertext, &data, &len );
+	} else {
+		rc = tls_decrypt_mac ( tls, tlshdr, ciphertext, &data, &len );
+	}
+	if ( rc != 0 )
+		return rc;
+
 	DBGC2 ( tls, "Received plaintext data:\n" );
 	DBGC2_HD ( tls, data, len );
 
 	/* Process plaintext record */
-	if ( ( rc = tls_new_record ( tls, tlshdr->type, data, len ) ) != 0 )
-		goto done;
-
-	rc = 0;
- done:
-	free ( plaintext );
-	return rc;
+	return tls_new_record ( tls, tlshdr->type, data, len );
 }
 
 /******************************************************************************
@@ -1619,10 +1798,27 @@ static int tls_cipherstream_deliver ( struct tls_session *tls,
 	return rc;
 }
 
+/**
+ * Handle change of ciphertext stream flow control window
+ *
+ * @v tls		TLS session
+ */
+static void tls_cipherstream_window_changed ( struct tls_session *tls ) {
+
+	/* Wake TX state machine */
+	process_wake ( &tls->process );
+
+	/* Pass notification on to application, if ready for data */
+	if ( tls->tx_state == TLS_TX_DATA )
+		xfer_window_changed ( &tls->plainstream );
+}
+
 /** TLS ciphertext stream interface operations */
 static struct interface_operation tls_cipherstream_ops[] = {
 	INTF_OP ( xfer_deliver, struct tls_session *,
 		  tls_cipherstream_deliver ),
+	INTF_OP ( xfer_window_changed, struct tls_session *,
+		  tls_cipherstream_window_changed ),
 	INTF_OP ( intf_close, struct tls_session *, tls_close ),
 };
 
@@ -1649,12 +1845,15 @@ static void tls_step ( struct process *process ) {
 	int rc;
 
 	/* Wait for cipherstream to become ready */
-	if ( ! xfer_window ( &tls->cipherstream ) )
+	if ( ! xfer_window ( &tls->cipherstream ) ) {
+		process_sleep ( process );
 		return;
+	}
 
 	switch ( tls->tx_state ) {
 	case TLS_TX_NONE:
 		/* Nothing to do */
+		process_sleep ( process );
 		break;
 	case TLS_TX_CLIENT_HELLO:
 		/* Send Client Hello */
@@ -1702,6 +1901,7 @@ static void tls_step ( struct process *process ) {
 		break;
 	case TLS_TX_DATA:
 		/* Nothing to do */
+		process_sleep ( process );
 		break;
 	default:
 		assert ( 0 );
@@ -1738,11 +1938,15 @@ int add_tls ( struct interface *xfer, struct interface **next ) {
 	tls->client_random.gmt_unix_time = 0;
 	tls_generate_random ( &tls->client_random.random,
 			      ( sizeof ( tls->client_random.random ) ) );
-	tls->pre_master_secret.version = htons ( TLS_VERSION_TLS_1_0 );
+	tls->version = TLS_VERSION_TLS_1_0;
+	tls->prf_digest = &sha256_algorithm;
+	tls->pre_master_secret.version = htons ( TLS_VERSION_TLS_1_2 );
 	tls_generate_random ( &tls->pre_master_secret.random,
 			      ( sizeof ( tls->pre_master_secret.random ) ) );
 	digest_init ( &md5_algorithm, tls->handshake_md5_ctx );
 	digest_init ( &sha1_algorithm, tls->handshake_sha1_ctx );
+	digest_init ( &sha256_algorithm, tls->handshake_sha256_ctx );
+	digest_init ( &sha384_algorithm, tls->handshake_sha384_ctx );
 	tls->tx_state = TLS_TX_CLIENT_HELLO;
 	process_init ( &tls->process, tls_step, &tls->refcnt );
 
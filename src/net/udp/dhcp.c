@@ -42,7 +42,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/dhcpopts.h>
 #include <ipxe/dhcppkt.h>
 #include <ipxe/dhcp_arch.h>
+#include <ipxe/nvo.h>
 #include <ipxe/features.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -116,6 +118,30 @@ struct setting use_cached_setting __setting = {
 	.type = &setting_type_uint8,
 };
 
+/** Persist DHCP leases setting */
+struct setting persist_lease_setting __setting = {
+	.name = "persist-lease",
+	.description = "Persist DHCP lease in non-volatile storage",
+	.tag = DHCP_EB_PERSIST_LEASE,
+	.type = &setting_type_uint8,
+};
+
+/** Persisted DHCP lease address setting */
+struct setting lease_address_setting __setting = {
+	.name = "lease-address",
+	.description = "Persisted DHCP lease address",
+	.tag = DHCP_EB_LEASE_ADDRESS,
+	.type = &setting_type_ipv4,
+};
+
+/** Persisted ProxyDHCP server setting */
+struct setting lease_proxy_setting __setting = {
+	.name = "lease-proxy",
+	.description = "Persisted ProxyDHCP server",
+	.tag = DHCP_EB_LEASE_PROXY,
+	.type = &setting_type_ipv4,
+};
+
 /**
  * Name a DHCP packet type
  *
@@ -199,6 +225,7 @@ struct dhcp_session_state {
 	uint8_t apply_min_timeout;
 };
 
+static struct dhcp_session_state dhcp_state_reboot;
 static struct dhcp_session_state dhcp_state_discover;
 static struct dhcp_session_state dhcp_state_request;
 static struct dhcp_session_state dhcp_state_proxy;
@@ -229,6 +256,9 @@ struct dhcp_offer {
 
 	/** Whether to ignore PXE DHCP extensions */
 	uint8_t no_pxedhcp;
+
+	/** Whether a boot filename is provided */
+	uint8_t bootfile;
 };
 
 /** Maximum number of DHCP offers to queue */
@@ -256,6 +286,13 @@ struct dhcp_session {
 	struct in_addr *pxe_attempt;
 	/** List of PXE Boot Servers to accept */
 	struct in_addr *pxe_accept;
+	/** PXE Boot Server currently being transmitted to */
+	struct in_addr *pxe_current;
+
+	/** Persisted lease address (for INIT-REBOOT) */
+	struct in_addr lease;
+	/** Persisted ProxyDHCP server (for INIT-REBOOT) */
+	struct in_addr lease_proxy;
 
 	/** Retransmission timer */
 	struct retry_timer timer;
@@ -295,6 +332,9 @@ static void dhcp_free ( struct refcnt *refcnt ) {
  */
 static void dhcp_finished ( struct dhcp_session *dhcp, int rc ) {
 
+	/* Record completion */
+	trace ( "dhcp-done", dhcp->netdev->name, rc );
+
 	/* Stop retry timer */
 	stop_timer ( &dhcp->timer );
 
@@ -313,6 +353,7 @@ static void dhcp_set_state ( struct dhcp_session *dhcp,
 			     struct dhcp_session_state *state ) {
 
 	DBGC ( dhcp, "DHCP %p entering %s state\n", dhcp, state->name );
+	trace ( "dhcp", state->name, 0 );
 	dhcp->state = state;
 	dhcp->start = currticks();
 	stop_timer ( &dhcp->timer );
@@ -351,12 +392,314 @@ static struct dhcp_offer * dhcp_next_offer ( struct dhcp_session *dhcp,
 	return best;
 }
 
+/**
+ * Check whether DHCP offer satisfies all requirements
+ *
+ * @v dhcp		DHCP session
+ * @v offer		DHCP offer valid for IP lease
+ * @ret complete	Offer satisfies all requirements
+ *
+ * An offer is complete if it tells us everything we need in order to
+ * boot, i.e. if there is no point in waiting for ProxyDHCPOFFERs.
+ * This is the case if the offer instructs us to ignore ProxyDHCP,
+ * provides a boot filename of its own, or if we already have an
+ * offer providing PXE options.
+ */
+static int dhcp_offer_complete ( struct dhcp_session *dhcp,
+				 struct dhcp_offer *offer ) {
+	return ( offer->no_pxedhcp || offer->bootfile ||
+		 ( dhcp_next_offer ( dhcp, DHCP_OFFER_PXE ) != NULL ) );
+}
+
+/**
+ * Record lease information in non-volatile storage
+ *
+ * @v dhcp		DHCP session
+ * @v setting		Persisted lease setting
+ * @v addr		Address to record, or 0.0.0.0 to clear
+ *
+ * Lease information is recorded only if the "persist-lease" setting
+ * is enabled and the network device has non-volatile stored options.
+ * The underlying storage is written only if the value has changed.
+ */
+static void dhcp_persist ( struct dhcp_session *dhcp, struct setting *setting,
+			   struct in_addr addr ) {
+	struct settings *nvo;
+	struct in_addr old = { 0 };
+	int rc;
+
+	/* Do nothing unless lease persistence is enabled */
+	if ( ! fetch_uintz_setting ( NULL, &persist_lease_setting ) )
+		return;
+
+	/* Locate non-volatile stored options */
+	nvo = find_child_settings ( netdev_settings ( dhcp->netdev ),
+				    NVO_SETTINGS_NAME );
+	if ( ! nvo )
+		return;
+
+	/* Avoid unnecessary writes to non-volatile storage */
+	fetch_ipv4_setting ( nvo, setting, &old );
+	if ( old.s_addr == addr.s_addr )
+		return;
+
+	/* Record or clear value */
+	if ( addr.s_addr ) {
+		rc = store_setting ( nvo, setting, &addr, sizeof ( addr ) );
+	} else {
+		rc = delete_setting ( nvo, setting );
+	}
+	if ( rc != 0 ) {
+		DBGC ( dhcp, "DHCP %p could not persist %s: %s\n",
+		       dhcp, setting->name, strerror ( rc ) );
+	}
+}
+
+/** A PXE settings block registered at the root of the settings tree */
+struct dhcp_pxe_block {
+	/** Settings block name */
+	const char *name;
+	/** Most recently registered settings block
+	 *
+	 * This is used only for comparison, and holds no reference.
+	 */
+	struct settings *settings;
+	/** Network device whose DHCP session registered the block
+	 *
+	 * This is used only for comparison, and holds no reference.
+	 */
+	struct net_device *netdev;
+};
+
+/** ProxyDHCP and PXEBS settings blocks
+ *
+ * These blocks are registered at the root of the settings tree, and
+ * so a block registered by one network device's DHCP session will
+ * replace any block registered by another's.  We record the owner of
+ * each block so that a caller configuring several network devices at
+ * once can tell which device a block belongs to.
+ */
+static struct dhcp_pxe_block dhcp_pxe_blocks[] = {
+	{ .name = PROXYDHCP_SETTINGS_NAME },
+	{ .name = PXEBS_SETTINGS_NAME },
+};
+
+/**
+ * Register PXE settings block
+ *
+ * @v dhcp		DHCP session
+ * @v settings		Settings block
+ * @v name		Settings block name
+ * @ret rc		Return status code
+ */
+static int dhcp_register_pxe ( struct dhcp_session *dhcp,
+			       struct settings *settings, const char *name ) {
+	struct dhcp_pxe_block *block;
+	unsigned int i;
+	int rc;
+
+	/* Register settings block */
+	settings->name = name;
+	if ( ( rc = register_settings ( settings, NULL ) ) != 0 )
+		return rc;
+
+	/* Record owner */
+	for ( i = 0 ; i < ( sizeof ( dhcp_pxe_blocks ) /
+			    sizeof ( dhcp_pxe_blocks[0] ) ) ; i++ ) {
+		block = &dhcp_pxe_blocks[i];
+		if ( strcmp ( block->name, name ) != 0 )
+			continue;
+		block->settings = settings;
+		block->netdev = dhcp->netdev;
+	}
+
+	return 0;
+}
+
+/**
+ * Find PXE settings block registered by a network device
+ *
+ * @v netdev		Network device
+ * @v name		Settings block name
+ * @ret settings	Settings block, or NULL
+ *
+ * Returns the named ProxyDHCP or PXEBS settings block only if it is
+ * still registered and was registered by a DHCP session on @c netdev.
+ */
+struct settings * dhcp_pxe_settings ( struct net_device *netdev,
+				      const char *name ) {
+	struct dhcp_pxe_block *block;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( dhcp_pxe_blocks ) /
+			    sizeof ( dhcp_pxe_blocks[0] ) ) ; i++ ) {
+		block = &dhcp_pxe_blocks[i];
+		if ( strcmp ( block->name, name ) != 0 )
+			continue;
+		/* Forget blocks that have since been unregistered */
+		if ( block->settings != find_settings ( name ) ) {
+			block->settings = NULL;
+			block->netdev = NULL;
+		}
+		if ( block->settings && ( block->netdev == netdev ) )
+			return block->settings;
+	}
+	return NULL;
+}
+
+/**
+ * Unregister PXE settings blocks registered by a network device
+ *
+ * @v netdev		Network device
+ */
+void dhcp_pxe_unregister ( struct net_device *netdev ) {
+	struct dhcp_pxe_block *block;
+	struct settings *settings;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( dhcp_pxe_blocks ) /
+			    sizeof ( dhcp_pxe_blocks[0] ) ) ; i++ ) {
+		block = &dhcp_pxe_blocks[i];
+		settings = dhcp_pxe_settings ( netdev, block->name );
+		if ( settings )
+			unregister_settings ( settings );
+		if ( block->netdev == netdev ) {
+			block->settings = NULL;
+			block->netdev = NULL;
+		}
+	}
+}
+
 /****************************************************************************
  *
  * DHCP state machine
  *
  */
 
+/**
+ * Construct transmitted packet for DHCP INIT-REBOOT request
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		Destination address
+ */
+static int dhcp_reboot_tx ( struct dhcp_session *dhcp,
+			    struct dhcp_packet *dhcppkt,
+			    struct sockaddr_in *peer ) {
+	int rc;
+
+	DBGC ( dhcp, "DHCP %p DHCPREQUEST (INIT-REBOOT) for %s\n",
+	       dhcp, inet_ntoa ( dhcp->lease ) );
+
+	/* Set requested IP address.  RFC 2131 section 4.3.2 requires
+	 * that INIT-REBOOT requests carry no server identifier.
+	 */
+	if ( ( rc = dhcppkt_store ( dhcppkt, DHCP_REQUESTED_ADDRESS,
+				    &dhcp->lease,
+				    sizeof ( dhcp->lease ) ) ) != 0 )
+		return rc;
+
+	/* Set server address */
+	peer->sin_addr.s_addr = INADDR_BROADCAST;
+	peer->sin_port = htons ( BOOTPS_PORT );
+
+	return 0;
+}
+
+/**
+ * Handle received packet during DHCP INIT-REBOOT request
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		DHCP server address
+ * @v msgtype		DHCP message type
+ * @v server_id		DHCP server ID
+ */
+static void dhcp_reboot_rx ( struct dhcp_session *dhcp,
+			     struct dhcp_packet *dhcppkt,
+			     struct sockaddr_in *peer, uint8_t msgtype,
+			     struct in_addr server_id ) {
+	struct dhcp_offer *offer;
+	struct settings *parent;
+	int rc;
+
+	DBGC ( dhcp, "DHCP %p %s from %s:%d", dhcp,
+	       dhcp_msgtype_name ( msgtype ), inet_ntoa ( peer->sin_addr ),
+	       ntohs ( peer->sin_port ) );
+	if ( server_id.s_addr != peer->sin_addr.s_addr )
+		DBGC ( dhcp, " (%s)", inet_ntoa ( server_id ) );
+	DBGC ( dhcp, "\n" );
+
+	/* Filter out unacceptable responses */
+	if ( peer->sin_port != htons ( BOOTPS_PORT ) )
+		return;
+
+	/* Fall back to full discovery if the server refuses the lease */
+	if ( msgtype == DHCPNAK ) {
+		DBGC ( dhcp, "DHCP %p persisted lease refused\n", dhcp );
+		dhcp_set_state ( dhcp, &dhcp_state_discover );
+		return;
+	}
+	if ( msgtype != DHCPACK )
+		return;
+	if ( dhcppkt->dhcphdr->yiaddr.s_addr != dhcp->lease.s_addr )
+		return;
+
+	/* Record assigned address */
+	dhcp->local.sin_addr = dhcp->lease;
+
+	/* Register settings */
+	parent = netdev_settings ( dhcp->netdev );
+	if ( ( rc = register_settings ( &dhcppkt->settings, parent ) ) != 0 ){
+		DBGC ( dhcp, "DHCP %p could not register settings: %s\n",
+		       dhcp, strerror ( rc ) );
+		dhcp_finished ( dhcp, rc );
+		return;
+	}
+
+	/* Terminate DHCP unless we previously needed ProxyDHCP */
+	if ( ! dhcp->lease_proxy.s_addr ) {
+		dhcp_finished ( dhcp, 0 );
+		return;
+	}
+
+	/* Go straight to the persisted ProxyDHCP server */
+	offer = &dhcp->offers[0];
+	offer->server = dhcp->lease_proxy;
+	offer->valid = DHCP_OFFER_PXE;
+	dhcp_set_state ( dhcp, &dhcp_state_proxy );
+}
+
+/**
+ * Handle timer expiry during DHCP INIT-REBOOT request
+ *
+ * @v dhcp		DHCP session
+ */
+static void dhcp_reboot_expired ( struct dhcp_session *dhcp ) {
+	unsigned long elapsed = ( currticks() - dhcp->start );
+
+	/* Fall back to full discovery if no server responds */
+	if ( elapsed >= DHCP_REBOOT_MAX_TIMEOUT ) {
+		DBGC ( dhcp, "DHCP %p persisted lease not confirmed\n",
+		       dhcp );
+		dhcp_set_state ( dhcp, &dhcp_state_discover );
+		return;
+	}
+
+	/* Retransmit current packet */
+	dhcp_tx ( dhcp );
+}
+
+/** DHCP INIT-REBOOT state operations */
+static struct dhcp_session_state dhcp_state_reboot = {
+	.name			= "INIT-REBOOT",
+	.tx			= dhcp_reboot_tx,
+	.rx			= dhcp_reboot_rx,
+	.expired		= dhcp_reboot_expired,
+	.tx_msgtype		= DHCPREQUEST,
+	.apply_min_timeout	= 0,
+};
+
 /**
  * Construct transmitted packet for DHCP discovery
  *
@@ -481,6 +824,12 @@ static void dhcp_rx_offer ( struct dhcp_session *dhcp,
 			sizeof ( offer->no_pxedhcp ) );
 	if ( offer->no_pxedhcp )
 		DBGC ( dhcp, " nopxe" );
+
+	/* Identify boot filename */
+	offer->bootfile = ( dhcppkt_fetch ( dhcppkt, DHCP_BOOTFILE_NAME,
+					    NULL, 0 ) > 0 );
+	if ( offer->bootfile )
+		DBGC ( dhcp, " file" );
 	DBGC ( dhcp, "\n" );
 
 	/* Determine roles this offer can fill */
@@ -514,9 +863,11 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 	/* We can exit the discovery state when we have a valid
 	 * DHCPOFFER, and either:
 	 *
-	 *  o  The DHCPOFFER instructs us to ignore ProxyDHCPOFFERs, or
-	 *  o  We have a valid ProxyDHCPOFFER, or
+	 *  o  The DHCPOFFER is complete (see dhcp_offer_complete()), or
 	 *  o  We have allowed sufficient time for ProxyDHCPOFFERs.
+	 *
+	 * Any ProxyDHCPOFFERs arriving while the DHCPREQUEST is in
+	 * progress will still be used.
 	 */
 
 	/* If we don't yet have a DHCPOFFER, do nothing */
@@ -524,12 +875,19 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 	if ( ! ip_offer )
 		return;
 
-	/* If we can't yet transition to DHCPREQUEST, do nothing */
+	/* If we can't yet transition to DHCPREQUEST, arrange to be
+	 * woken up as soon as we can.  The retransmission timer
+	 * would otherwise overshoot the ProxyDHCP deadline by up to
+	 * DHCP_MIN_TIMEOUT.
+	 */
 	elapsed = ( currticks() - dhcp->start );
-	if ( ! ( ip_offer->no_pxedhcp ||
-		 dhcp_next_offer ( dhcp, DHCP_OFFER_PXE ) ||
-		 ( elapsed > PROXYDHCP_MAX_TIMEOUT ) ) )
+	if ( ! ( dhcp_offer_complete ( dhcp, ip_offer ) ||
+		 ( elapsed >= PROXYDHCP_MAX_TIMEOUT ) ) ) {
+		stop_timer ( &dhcp->timer );
+		start_timer_fixed ( &dhcp->timer,
+				    ( PROXYDHCP_MAX_TIMEOUT - elapsed ) );
 		return;
+	}
 
 	/* Transition to DHCPREQUEST */
 	dhcp_set_state ( dhcp, &dhcp_state_request );
@@ -545,7 +903,7 @@ static void dhcp_discovery_expired ( struct dhcp_session *dhcp ) {
 
 	/* Give up waiting for ProxyDHCP before we reach the failure point */
 	if ( dhcp_next_offer ( dhcp, DHCP_OFFER_IP ) &&
-	     ( elapsed > PROXYDHCP_MAX_TIMEOUT ) ) {
+	     ( elapsed >= PROXYDHCP_MAX_TIMEOUT ) ) {
 		dhcp_set_state ( dhcp, &dhcp_state_request );
 		return;
 	}
@@ -615,6 +973,7 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 			      struct sockaddr_in *peer, uint8_t msgtype,
 			      struct in_addr server_id ) {
 	struct in_addr ip;
+	struct in_addr no_proxy = { 0 };
 	struct settings *parent;
 	int rc;
 	struct dhcp_offer *pxe_offer;
@@ -662,6 +1021,9 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 		return;
 	}
 
+	/* Record lease for use by a subsequent INIT-REBOOT */
+	dhcp_persist ( dhcp, &lease_address_setting, ip );
+
 	/* Locate best source of PXE settings */
 	pxe_offer = dhcp_next_offer ( dhcp, DHCP_OFFER_PXE );
 
@@ -672,19 +1034,22 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 	     ( ( dhcp->current_offer == pxe_offer ) && ( pxe_offer->pxe ) ) ) {
 
 		/* Terminate DHCP */
+		dhcp_persist ( dhcp, &lease_proxy_setting, no_proxy );
 		dhcp_finished ( dhcp, 0 );
 
 	} else if ( pxe_offer->pxe ) {
 		/* Register PXE settings and terminate DHCP */
-		pxe_offer->pxe->settings.name = PROXYDHCP_SETTINGS_NAME;
-		if ( ( rc = register_settings ( &pxe_offer->pxe->settings,
-						NULL ) ) != 0 ) {
+		dhcp_persist ( dhcp, &lease_proxy_setting, pxe_offer->server );
+		rc = dhcp_register_pxe ( dhcp, &pxe_offer->pxe->settings,
+					 PROXYDHCP_SETTINGS_NAME );
+		if ( rc != 0 ) {
 			DBGC ( dhcp, "DHCP %p could not register settings: "
 			       "%s\n", dhcp, strerror ( rc ) );
 		}
 		dhcp_finished ( dhcp, rc );
 	} else {
 		/* Start ProxyDHCP */
+		dhcp_persist ( dhcp, &lease_proxy_setting, pxe_offer->server );
 		dhcp_set_state ( dhcp, &dhcp_state_proxy );
 	}
 }
@@ -780,8 +1145,8 @@ static void dhcp_proxy_rx ( struct dhcp_session *dhcp,
 		return;
 
 	/* Register settings */
-	dhcppkt->settings.name = PROXYDHCP_SETTINGS_NAME;
-	if ( ( rc = register_settings ( &dhcppkt->settings, NULL ) ) != 0 ) {
+	if ( ( rc = dhcp_register_pxe ( dhcp, &dhcppkt->settings,
+					PROXYDHCP_SETTINGS_NAME ) ) != 0 ) {
 		DBGC ( dhcp, "DHCP %p could not register settings: %s\n",
 		       dhcp, strerror ( rc ) );
 		dhcp_finished ( dhcp, rc );
@@ -856,7 +1221,7 @@ static int dhcp_pxebs_tx ( struct dhcp_session *dhcp,
 	int rc;
 
 	/* Set server address */
-	peer->sin_addr = *(dhcp->pxe_attempt);
+	peer->sin_addr = *(dhcp->pxe_current);
 	peer->sin_port = ( ( peer->sin_addr.s_addr == INADDR_BROADCAST ) ?
 			   htons ( BOOTPS_PORT ) : htons ( PXE_PORT ) );
 
@@ -941,8 +1306,8 @@ static void dhcp_pxebs_rx ( struct dhcp_session *dhcp,
 		return;
 
 	/* Register settings */
-	dhcppkt->settings.name = PXEBS_SETTINGS_NAME;
-	if ( ( rc = register_settings ( &dhcppkt->settings, NULL ) ) != 0 ) {
+	if ( ( rc = dhcp_register_pxe ( dhcp, &dhcppkt->settings,
+					PXEBS_SETTINGS_NAME ) ) != 0 ) {
 		DBGC ( dhcp, "DHCP %p could not register settings: %s\n",
 		       dhcp, strerror ( rc ) );
 		dhcp_finished ( dhcp, rc );
@@ -961,22 +1326,20 @@ static void dhcp_pxebs_rx ( struct dhcp_session *dhcp,
 static void dhcp_pxebs_expired ( struct dhcp_session *dhcp ) {
 	unsigned long elapsed = ( currticks() - dhcp->start );
 
-	/* Give up waiting before we reach the failure point, and fail
-	 * over to the next server in the attempt list
-	 */
+	/* Give up waiting before we reach the failure point */
 	if ( elapsed > PXEBS_MAX_TIMEOUT ) {
-		dhcp->pxe_attempt++;
-		if ( dhcp->pxe_attempt->s_addr ) {
-			dhcp_set_state ( dhcp, &dhcp_state_pxebs );
-			return;
-		} else {
-			dhcp_finished ( dhcp, -ETIMEDOUT );
-			return;
-		}
+		dhcp_finished ( dhcp, -ETIMEDOUT );
+		return;
 	}
 
-	/* Retransmit current packet */
-	dhcp_tx ( dhcp );
+	/* Transmit to every server in the attempt list at once,
+	 * rather than waiting for each in turn to time out.  The
+	 * first acceptable response wins.
+	 */
+	for ( dhcp->pxe_current = dhcp->pxe_attempt ;
+	      dhcp->pxe_current->s_addr ; dhcp->pxe_current++ ) {
+		dhcp_tx ( dhcp );
+	}
 }
 
 /** PXE Boot Server Discovery state operations */
@@ -1435,8 +1798,17 @@ int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 				  ( struct sockaddr * ) &dhcp->local ) ) != 0 )
 		goto err;
 
-	/* Enter DHCPDISCOVER state */
-	dhcp_set_state ( dhcp, &dhcp_state_discover );
+	/* Attempt to reuse a persisted lease, if permitted */
+	if ( fetch_uintz_setting ( NULL, &persist_lease_setting ) ) {
+		fetch_ipv4_setting ( netdev_settings ( netdev ),
+				     &lease_address_setting, &dhcp->lease );
+		fetch_ipv4_setting ( netdev_settings ( netdev ),
+				     &lease_proxy_setting, &dhcp->lease_proxy );
+	}
+
+	/* Enter INIT-REBOOT state if we have a lease, else DHCPDISCOVER */
+	dhcp_set_state ( dhcp, ( dhcp->lease.s_addr ? &dhcp_state_reboot :
+				 &dhcp_state_discover ) );
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dhcp->job, job );
@@ -33,10 +33,12 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/open.h>
 #include <ipxe/resolv.h>
 #include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/settings.h>
 #include <ipxe/features.h>
 #include <ipxe/dns.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -46,11 +48,20 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 FEATURE ( FEATURE_PROTOCOL, "DNS", DHCP_EB_FEATURE_DNS, 1 );
 
-/** The DNS server */
-static struct sockaddr_tcpip nameserver = {
-	.st_port = htons ( DNS_PORT ),
+/** A DNS server */
+struct dns_server {
+	/** Socket address */
+	struct sockaddr_tcpip st;
+	/** Smoothed response time (in ticks), or zero if unknown */
+	unsigned long rtt;
 };
 
+/** The DNS servers */
+static struct dns_server nameservers[DNS_MAX_SERVERS];
+
+/** Number of DNS servers */
+static unsigned int num_nameservers;
+
 /** The local domain */
 static char *localdomain;
 
@@ -77,6 +88,19 @@ struct dns_request {
 	struct dns_query_info *qinfo;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Time at which current query was sent */
+	unsigned long sent;
+	/** Time to live of answer (in seconds)
+	 *
+	 * This is the minimum TTL of all records (e.g. CNAME and A
+	 * records) contributing to the answer.
+	 */
+	unsigned long ttl;
+	/** Name to resolve, as originally requested
+	 *
+	 * Must be at end of structure
+	 */
+	char name[0];
 };
 
 /**
@@ -87,6 +111,9 @@ struct dns_request {
  */
 static void dns_done ( struct dns_request *dns, int rc ) {
 
+	/* Record completion */
+	trace ( "dns-done", dns->name, rc );
+
 	/* Stop the retry timer */
 	stop_timer ( &dns->timer );
 
@@ -183,6 +210,52 @@ static union dns_rr_info * dns_find_rr ( struct dns_request *dns,
 	return NULL;
 }
 
+/**
+ * Determine time for which a nonexistent name may be cached
+ *
+ * @v reply		DNS reply
+ * @ret ttl		Time to live (in seconds), or zero
+ *
+ * As per RFC 2308, this is taken from the SOA record in the
+ * authority section, as the lesser of the record's TTL and its
+ * minimum field.  If there is no SOA record, the answer must not be
+ * cached.
+ */
+static unsigned long dns_negative_ttl ( const struct dns_header *reply ) {
+	const char *p = ( ( char * ) reply ) + sizeof ( struct dns_header );
+	const union dns_rr_info *rr_info;
+	const struct dns_rr_info_soa_tail *soa;
+	unsigned long ttl;
+	unsigned long minimum;
+	int i;
+
+	/* Skip over the questions section */
+	for ( i = ntohs ( reply->qdcount ) ; i > 0 ; i-- ) {
+		p = dns_skip_name ( p ) + sizeof ( struct dns_query_info );
+	}
+
+	/* Skip over the answers section and search the authority
+	 * section for an SOA record
+	 */
+	for ( i = ( ntohs ( reply->ancount ) + ntohs ( reply->nscount ) ) ;
+	      i > 0 ; i-- ) {
+		p = dns_skip_name ( p );
+		rr_info = ( ( const union dns_rr_info * ) p );
+		p += ( sizeof ( rr_info->common ) +
+		       ntohs ( rr_info->common.rdlength ) );
+		if ( ( i > ntohs ( reply->nscount ) ) ||
+		     ( rr_info->common.type != htons ( DNS_TYPE_SOA ) ) ||
+		     ( ntohs ( rr_info->common.rdlength ) < sizeof ( *soa ) ) )
+			continue;
+		soa = ( ( const void * ) p ) - sizeof ( *soa );
+		ttl = ntohl ( rr_info->common.ttl );
+		minimum = ntohl ( soa->minimum );
+		return ( ( ttl < minimum ) ? ttl : minimum );
+	}
+
+	return 0;
+}
+
 /**
  * Append DHCP domain name if available and name is not fully qualified
  *
@@ -277,14 +350,41 @@ static char * dns_decompress_name ( const struct dns_header *reply,
 	return buf;
 }
 
+/**
+ * Compare DNS servers by response time
+ *
+ * @v first		First DNS server
+ * @v second		Second DNS server
+ * @ret faster		First server is known to be faster
+ *
+ * Servers with an unknown response time (including servers which
+ * have never responded) are considered slower than any other.
+ */
+static int dns_server_faster ( struct dns_server *first,
+			       struct dns_server *second ) {
+	return ( first->rtt && ( ( ! second->rtt ) ||
+				 ( first->rtt < second->rtt ) ) );
+}
+
 /**
  * Send next packet in DNS request
  *
  * @v dns		DNS request
+ *
+ * The query is sent to every DNS server at once, fastest first, and
+ * the first useful answer is taken.  A dead or slow server therefore
+ * costs nothing as long as any other server is responding.
  */
 static int dns_send_packet ( struct dns_request *dns ) {
 	static unsigned int qid = 0;
+	struct dns_server *order[DNS_MAX_SERVERS];
+	struct dns_server *tmp;
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
 	size_t qlen;
+	unsigned int i;
+	unsigned int j;
+	int rc = 0;
 
 	/* Increment query ID */
 	dns->query.dns.id = htons ( ++qid );
@@ -293,11 +393,61 @@ static int dns_send_packet ( struct dns_request *dns ) {
 
 	/* Start retransmission timer */
 	start_timer ( &dns->timer );
+	dns->sent = currticks();
+
+	/* Sort servers by response time */
+	for ( i = 0 ; i < num_nameservers ; i++ ) {
+		order[i] = &nameservers[i];
+		for ( j = i ; j && dns_server_faster ( order[j], order[j-1] ) ;
+		      j-- ) {
+			tmp = order[j];
+			order[j] = order[j-1];
+			order[j-1] = tmp;
+		}
+	}
 
-	/* Send the data */
+	/* Send the data to each server */
 	qlen = ( ( ( void * ) dns->qinfo ) - ( ( void * ) &dns->query )
 		 + sizeof ( dns->qinfo ) );
-	return xfer_deliver_raw ( &dns->socket, &dns->query, qlen );
+	for ( i = 0 ; i < num_nameservers ; i++ ) {
+		iobuf = xfer_alloc_iob ( &dns->socket, qlen );
+		if ( ! iobuf )
+			return -ENOMEM;
+		memcpy ( iob_put ( iobuf, qlen ), &dns->query, qlen );
+		memset ( &meta, 0, sizeof ( meta ) );
+		meta.dest = ( struct sockaddr * ) &order[i]->st;
+		if ( ( rc = xfer_deliver ( &dns->socket, iobuf,
+					   &meta ) ) != 0 ) {
+			DBGC ( dns, "DNS %p could not send to %s: %s\n", dns,
+			       inet_ntoa ( ( ( struct sockaddr_in * )
+					     &order[i]->st )->sin_addr ),
+			       strerror ( rc ) );
+			/* Continue with remaining servers */
+		}
+	}
+
+	return rc;
+}
+
+/**
+ * Identify DNS server
+ *
+ * @v st		Socket address
+ * @ret server		DNS server, or NULL
+ */
+static struct dns_server * dns_find_server ( struct sockaddr_tcpip *st ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) st );
+	struct sockaddr_in *server_sin;
+	unsigned int i;
+
+	for ( i = 0 ; i < num_nameservers ; i++ ) {
+		server_sin = ( ( struct sockaddr_in * ) &nameservers[i].st );
+		if ( ( sin->sin_family == server_sin->sin_family ) &&
+		     ( sin->sin_port == server_sin->sin_port ) &&
+		     ( sin->sin_addr.s_addr == server_sin->sin_addr.s_addr ) )
+			return &nameservers[i];
+	}
+	return NULL;
 }
 
 /**
@@ -317,6 +467,20 @@ static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
 	}
 }
 
+/**
+ * Update time to live of answer
+ *
+ * @v dns		DNS request
+ * @v rr_info		Resource record contributing to answer
+ */
+static void dns_update_ttl ( struct dns_request *dns,
+			     const union dns_rr_info *rr_info ) {
+	unsigned long ttl = ntohl ( rr_info->common.ttl );
+
+	if ( ttl < dns->ttl )
+		dns->ttl = ttl;
+}
+
 /**
  * Receive new data
  *
@@ -327,11 +491,14 @@ static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
  */
 static int dns_xfer_deliver ( struct dns_request *dns,
 			      struct io_buffer *iobuf,
-			      struct xfer_metadata *meta __unused ) {
+			      struct xfer_metadata *meta ) {
 	const struct dns_header *reply = iobuf->data;
 	union dns_rr_info *rr_info;
 	struct sockaddr_in *sin;
+	struct dns_server *server;
 	unsigned int qtype = dns->qinfo->qtype;
+	unsigned long rtt;
+	unsigned int rcode;
 	int rc;
 
 	/* Sanity check */
@@ -351,7 +518,38 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		goto done;
 	}
 
-	DBGC ( dns, "DNS %p received reply ID %d\n", dns, ntohs ( reply->id ));
+	/* Identify server */
+	server = ( meta->src ?
+		   dns_find_server ( ( struct sockaddr_tcpip * ) meta->src ) :
+		   NULL );
+	if ( ! server ) {
+		DBGC ( dns, "DNS %p received reply from unknown server\n",
+		       dns );
+		rc = -EINVAL;
+		goto done;
+	}
+
+	sin = ( ( struct sockaddr_in * ) &server->st );
+	DBGC ( dns, "DNS %p received reply ID %d from %s\n", dns,
+	       ntohs ( reply->id ), inet_ntoa ( sin->sin_addr ) );
+
+	/* Record server response time */
+	rtt = ( currticks() - dns->sent );
+	if ( ! rtt )
+		rtt = 1;
+	server->rtt = ( server->rtt ? ( ( ( 3 * server->rtt ) + rtt ) / 4 ) :
+			rtt );
+
+	/* Ignore server failures, since another server may yet
+	 * provide a useful answer.
+	 */
+	rcode = DNS_FLAG_RCODE ( ntohs ( reply->flags ) );
+	if ( ( rcode != DNS_FLAG_RCODE_OK ) && ( rcode != DNS_FLAG_RCODE_NX ) ){
+		DBGC ( dns, "DNS %p ignoring reply with RCODE %d\n",
+		       dns, rcode );
+		rc = 0;
+		goto done;
+	}
 
 	/* Stop the retry timer.  After this point, each code path
 	 * must either restart the timer by calling dns_send_packet(),
@@ -360,6 +558,18 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	 */
 	stop_timer ( &dns->timer );
 
+	/* Fail immediately (and remember the failure) if the name
+	 * does not exist.
+	 */
+	if ( rcode == DNS_FLAG_RCODE_NX ) {
+		DBGC ( dns, "DNS %p name does not exist\n", dns );
+		resolv_cache_add_negative ( dns->name, AF_INET,
+					    dns_negative_ttl ( reply ) );
+		dns_done ( dns, -ENXIO );
+		rc = 0;
+		goto done;
+	}
+
 	/* Search through response for useful answers.  Do this
 	 * multiple times, to take advantage of useful nameservers
 	 * which send us e.g. the CNAME *and* the A record for the
@@ -377,6 +587,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			sin->sin_family = AF_INET;
 			sin->sin_addr = rr_info->a.in_addr;
 
+			/* Cache resolved address */
+			dns_update_ttl ( dns, rr_info );
+			resolv_cache_add ( dns->name, &dns->sa, dns->ttl );
+
 			/* Return resolved address */
 			resolv_done ( &dns->resolv, &dns->sa );
 
@@ -389,6 +603,7 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 
 			/* Found a CNAME record; update query and recurse */
 			DBGC ( dns, "DNS %p found CNAME\n", dns );
+			dns_update_ttl ( dns, rr_info );
 			dns->qinfo = ( void * ) dns_decompress_name ( reply,
 							 rr_info->cname.cname,
 							 dns->query.payload );
@@ -504,7 +719,7 @@ static int dns_resolv ( struct interface *resolv,
 	int rc;
 
 	/* Fail immediately if no DNS servers */
-	if ( ! nameserver.st_family ) {
+	if ( ! num_nameservers ) {
 		DBG ( "DNS not attempting to resolve \"%s\": "
 		      "no DNS servers\n", name );
 		rc = -ENXIO;
@@ -519,7 +734,7 @@ static int dns_resolv ( struct interface *resolv,
 	}
 
 	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) );
+	dns = zalloc ( sizeof ( *dns ) + strlen ( name ) + 1 );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
@@ -529,6 +744,8 @@ static int dns_resolv ( struct interface *resolv,
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
 	timer_init ( &dns->timer, dns_timer_expired );
 	memcpy ( &dns->sa, sa, sizeof ( dns->sa ) );
+	dns->ttl = ~0UL;
+	strcpy ( dns->name, name );
 
 	/* Create query */
 	dns->query.dns.flags = htons ( DNS_FLAG_QUERY | DNS_FLAG_OPCODE_QUERY |
@@ -540,7 +757,7 @@ static int dns_resolv ( struct interface *resolv,
 
 	/* Open UDP connection */
 	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
-				       ( struct sockaddr * ) &nameserver,
+				       ( struct sockaddr * ) &nameservers[0].st,
 				       NULL ) ) != 0 ) {
 		DBGC ( dns, "DNS %p could not open socket: %s\n",
 		       dns, strerror ( rc ) );
@@ -548,6 +765,7 @@ static int dns_resolv ( struct interface *resolv,
 	}
 
 	/* Send first DNS packet */
+	trace ( "dns", name, 0 );
 	dns_send_packet ( dns );
 
 	/* Attach parent interface, mortalise self, and return */
@@ -600,22 +818,41 @@ struct setting domain_setting __setting = {
  * @ret rc		Return status code
  */
 static int apply_dns_settings ( void ) {
-	struct sockaddr_in *sin_nameserver =
-		( struct sockaddr_in * ) &nameserver;
+	struct in_addr addrs[DNS_MAX_SERVERS];
+	struct sockaddr_in *sin;
+	unsigned int count = 0;
+	unsigned int i;
 	int len;
 
-	if ( ( len = fetch_ipv4_setting ( NULL, &dns_setting,
-					  &sin_nameserver->sin_addr ) ) >= 0 ){
-		sin_nameserver->sin_family = AF_INET;
-		DBG ( "DNS using nameserver %s\n",
-		      inet_ntoa ( sin_nameserver->sin_addr ) );
+	/* Get DNS servers.  DHCP may provide several. */
+	if ( ( len = fetch_setting ( NULL, &dns_setting, addrs,
+				     sizeof ( addrs ) ) ) >= 0 ) {
+		count = ( len / sizeof ( addrs[0] ) );
+		if ( count > DNS_MAX_SERVERS )
+			count = DNS_MAX_SERVERS;
 	}
+	for ( i = 0 ; i < count ; i++ ) {
+		sin = ( ( struct sockaddr_in * ) &nameservers[i].st );
+		/* Retain response time if server is unchanged */
+		if ( ( i < num_nameservers ) &&
+		     ( sin->sin_addr.s_addr == addrs[i].s_addr ) )
+			continue;
+		memset ( &nameservers[i], 0, sizeof ( nameservers[i] ) );
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons ( DNS_PORT );
+		sin->sin_addr = addrs[i];
+		DBG ( "DNS using nameserver %s\n", inet_ntoa ( addrs[i] ) );
+	}
+	num_nameservers = count;
 
 	/* Get local domain DHCP option */
 	if ( ( len = fetch_string_setting_copy ( NULL, &domain_setting,
 						 &localdomain ) ) >= 0 )
 		DBG ( "DNS local domain %s\n", localdomain );
 
+	/* Discard any answers obtained using the old settings */
+	resolv_cache_flush();
+
 	return 0;
 }
 
@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/uri.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/features.h>
 #include <ipxe/bitmap.h>
 #include <ipxe/settings.h>
@@ -70,6 +71,9 @@ FEATURE ( FEATURE_PROTOCOL, "TFTP", DHCP_EB_FEATURE_TFTP, 1 );
 #define EINVAL_MC_INVALID_PORT __einfo_error ( EINFO_EINVAL_MC_INVALID_PORT )
 #define EINFO_EINVAL_MC_INVALID_PORT __einfo_uniqify \
 	( EINFO_EINVAL, 0x07, "Invalid multicast port" )
+#define EINVAL_WINDOWSIZE __einfo_error ( EINFO_EINVAL_WINDOWSIZE )
+#define EINFO_EINVAL_WINDOWSIZE __einfo_uniqify \
+	( EINFO_EINVAL, 0x08, "Invalid windowsize" )
 
 /**
  * A TFTP request
@@ -96,6 +100,25 @@ struct tftp_request {
 	 * this will default to 512).
 	 */
 	unsigned int blksize;
+	/** Window size
+	 *
+	 * This is the "windowsize" option (RFC 7440) negotiated with
+	 * the TFTP server: the number of blocks that the server will
+	 * send before waiting for an ACK.  (If the TFTP server does
+	 * not support the option, this will default to 1).
+	 */
+	unsigned int windowsize;
+	/** Requested window size
+	 *
+	 * This is the "windowsize" option value sent in the RRQ, and
+	 * may be overridden by a "windowsize=<n>" URI query parameter.
+	 */
+	unsigned int request_windowsize;
+	/** Start of current window
+	 *
+	 * This is the block number most recently sent in an ACK.
+	 */
+	unsigned int window_start;
 	/** File size
 	 *
 	 * This is the value returned in the "tsize" option from the
@@ -119,6 +142,22 @@ struct tftp_request {
 	unsigned int flags;
 	/** MTFTP timeout count */
 	unsigned int mtftp_timeouts;
+	/** MTFTP reopen count
+	 *
+	 * This is the number of times that we have attempted to take
+	 * over as the master client, and is used to back off
+	 * successive takeover attempts.
+	 */
+	unsigned int mtftp_reopens;
+	/** Retransmission timeout saved during a takeover delay */
+	unsigned long mtftp_timeout;
+	/** Most recently received block number
+	 *
+	 * This is the absolute (i.e. not truncated to 16 bits) block
+	 * number of the most recently received DATA packet, used as
+	 * the reference point for resolving block number wraparound.
+	 */
+	unsigned int last_block;
 
 	/** Block bitmap */
 	struct bitmap bitmap;
@@ -150,11 +189,21 @@ enum {
 	TFTP_FL_MTFTP_RECOVERY = 0x0008,
 	/** Only get filesize and then abort the transfer */
 	TFTP_FL_SIZEONLY = 0x0010,
+	/** An ACK has been sent to rewind the current window */
+	TFTP_FL_REWIND = 0x0020,
+	/** A master client takeover attempt is pending */
+	TFTP_FL_MTFTP_TAKEOVER = 0x0040,
 };
 
 /** Maximum number of MTFTP open requests before falling back to TFTP */
 #define MTFTP_MAX_TIMEOUTS 3
 
+/** Initial maximum random delay before an MTFTP master client takeover */
+#define MTFTP_TAKEOVER_DELAY ( TICKS_PER_SEC / 4 )
+
+/** Maximum number of times to double the MTFTP takeover delay */
+#define MTFTP_TAKEOVER_MAX_BACKOFF 4
+
 /**
  * Free TFTP request
  *
@@ -333,6 +382,18 @@ void tftp_set_mtftp_port ( unsigned int port ) {
 	tftp_mtftp_socket.sin_port = htons ( port );
 }
 
+/**
+ * Check whether or not RRQ includes the "windowsize" option
+ *
+ * @v tftp		TFTP connection
+ * @ret windowsize	RRQ requests a window size
+ */
+static int tftp_rrq_windowsize ( struct tftp_request *tftp ) {
+	return ( ( tftp->flags & TFTP_FL_RRQ_SIZES ) &&
+		 ( ! ( tftp->flags & TFTP_FL_RRQ_MULTICAST ) ) &&
+		 ( tftp->request_windowsize > TFTP_DEFAULT_WINDOWSIZE ) );
+}
+
 /**
  * Transmit RRQ
  *
@@ -364,6 +425,7 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 		+ 5 + 1 /* "octet" + NUL */
 		+ 7 + 1 + 5 + 1 /* "blksize" + NUL + ddddd + NUL */
 		+ 5 + 1 + 1 + 1 /* "tsize" + NUL + "0" + NUL */ 
+		+ 10 + 1 + 5 + 1 /* "windowsize" + NUL + ddddd + NUL */
 		+ 9 + 1 + 1 /* "multicast" + NUL + NUL */ );
 	iobuf = xfer_alloc_iob ( &tftp->socket, len );
 	if ( ! iobuf )
@@ -380,6 +442,12 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 					    "blksize%c%d%ctsize%c0", 0,
 					    tftp_request_blksize, 0, 0 ) + 1 );
 	}
+	if ( tftp_rrq_windowsize ( tftp ) ) {
+		iob_put ( iobuf, snprintf ( iobuf->tail,
+					    iob_tailroom ( iobuf ),
+					    "windowsize%c%d", 0,
+					    tftp->request_windowsize ) + 1 );
+	}
 	if ( tftp->flags & TFTP_FL_RRQ_MULTICAST ) {
 		iob_put ( iobuf, snprintf ( iobuf->tail,
 					    iob_tailroom ( iobuf ),
@@ -409,6 +477,7 @@ static int tftp_send_ack ( struct tftp_request *tftp ) {
 	/* Determine next required block number */
 	block = bitmap_first_gap ( &tftp->bitmap );
 	DBGC2 ( tftp, "TFTP %p sending ACK for block %d\n", tftp, block );
+	tftp->window_start = block;
 
 	/* Allocate buffer */
 	iobuf = xfer_alloc_iob ( &tftp->socket, sizeof ( *ack ) );
@@ -491,6 +560,56 @@ static int tftp_send_packet ( struct tftp_request *tftp ) {
 	}
 }
 
+/**
+ * Choose delay before attempting an MTFTP master client takeover
+ *
+ * @v tftp		TFTP connection
+ * @ret delay		Delay (in ticks)
+ *
+ * When the master client stalls, every other client listening to
+ * the multicast stream will time out at much the same moment.  To
+ * avoid flooding the server with simultaneous RRQs, each client
+ * waits for a random delay, which doubles with each successive
+ * takeover attempt.
+ */
+static unsigned long tftp_mtftp_takeover_delay ( struct tftp_request *tftp ) {
+	unsigned int backoff = tftp->mtftp_reopens;
+
+	if ( backoff > MTFTP_TAKEOVER_MAX_BACKOFF )
+		backoff = MTFTP_TAKEOVER_MAX_BACKOFF;
+	return ( ( random() % ( MTFTP_TAKEOVER_DELAY << backoff ) ) + 1 );
+}
+
+/**
+ * Begin MTFTP master client takeover delay
+ *
+ * @v tftp		TFTP connection
+ *
+ * The retransmission timer is reused for the takeover delay, so the
+ * current retransmission timeout is saved and later restored by
+ * tftp_mtftp_end_takeover().
+ */
+static void tftp_mtftp_start_takeover ( struct tftp_request *tftp ) {
+	tftp->flags |= TFTP_FL_MTFTP_TAKEOVER;
+	tftp->mtftp_timeout = tftp->timer.timeout;
+	start_timer_fixed ( &tftp->timer, tftp_mtftp_takeover_delay ( tftp ) );
+}
+
+/**
+ * End MTFTP master client takeover delay
+ *
+ * @v tftp		TFTP connection
+ *
+ * Restores the retransmission timeout saved when the takeover delay
+ * began, whether the takeover was cancelled or is being attempted.
+ */
+static void tftp_mtftp_end_takeover ( struct tftp_request *tftp ) {
+	if ( tftp->flags & TFTP_FL_MTFTP_TAKEOVER ) {
+		tftp->flags &= ~TFTP_FL_MTFTP_TAKEOVER;
+		tftp->timer.timeout = tftp->mtftp_timeout;
+	}
+}
+
 /**
  * Handle TFTP retransmission timer expiry
  *
@@ -505,6 +624,18 @@ static void tftp_timer_expired ( struct retry_timer *timer, int fail ) {
 	/* If we are doing MTFTP, attempt the various recovery strategies */
 	if ( tftp->flags & TFTP_FL_MTFTP_RECOVERY ) {
 		if ( tftp->peer.st_family ) {
+			/* If we are not the master client, wait for a
+			 * random delay before taking over.  Any DATA
+			 * received in the meantime cancels the takeover.
+			 */
+			if ( ! ( tftp->flags & ( TFTP_FL_SEND_ACK |
+						 TFTP_FL_MTFTP_TAKEOVER ) ) ) {
+				tftp_mtftp_start_takeover ( tftp );
+				return;
+			}
+			tftp_mtftp_end_takeover ( tftp );
+			tftp->mtftp_reopens++;
+
 			/* If we have received any response from the server,
 			 * try resending the RRQ to restart the download.
 			 */
@@ -534,6 +665,7 @@ static void tftp_timer_expired ( struct retry_timer *timer, int fail ) {
 				bitmap_free ( &tftp->bitmap );
 				memset ( &tftp->bitmap, 0,
 					 sizeof ( tftp->bitmap ) );
+				tftp->last_block = 0;
 
 				/* Reopen on standard TFTP port */
 				tftp->port = TFTP_PORT;
@@ -549,6 +681,11 @@ static void tftp_timer_expired ( struct retry_timer *timer, int fail ) {
 			rc = -ETIMEDOUT;
 			goto err;
 		}
+
+		/* The ACK sent on timeout restarts the window, so any
+		 * rewind in progress is complete.
+		 */
+		tftp->flags &= ~TFTP_FL_REWIND;
 	}
 	tftp_send_packet ( tftp );
 	return;
@@ -601,6 +738,41 @@ static int tftp_process_tsize ( struct tftp_request *tftp,
 	return 0;
 }
 
+/**
+ * Process TFTP "windowsize" option
+ *
+ * @v tftp		TFTP connection
+ * @v value		Option value
+ * @ret rc		Return status code
+ */
+static int tftp_process_windowsize ( struct tftp_request *tftp,
+				     const char *value ) {
+	unsigned long windowsize;
+	char *end;
+
+	/* Ignore an option that we did not request */
+	if ( ! tftp_rrq_windowsize ( tftp ) ) {
+		DBGC ( tftp, "TFTP %p ignoring unrequested windowsize\n",
+		       tftp );
+		return 0;
+	}
+
+	/* The server must not exceed the requested window size (RFC
+	 * 7440 section 4).
+	 */
+	windowsize = strtoul ( value, &end, 10 );
+	if ( *end || ( windowsize == 0 ) ||
+	     ( windowsize > tftp->request_windowsize ) ) {
+		DBGC ( tftp, "TFTP %p got invalid windowsize \"%s\"\n",
+		       tftp, value );
+		return -EINVAL_WINDOWSIZE;
+	}
+	tftp->windowsize = windowsize;
+	DBGC ( tftp, "TFTP %p windowsize=%d\n", tftp, tftp->windowsize );
+
+	return 0;
+}
+
 /**
  * Process TFTP "multicast" option
  *
@@ -688,6 +860,7 @@ struct tftp_option {
 static struct tftp_option tftp_options[] = {
 	{ "blksize", tftp_process_blksize },
 	{ "tsize", tftp_process_tsize },
+	{ "windowsize", tftp_process_windowsize },
 	{ "multicast", tftp_process_multicast },
 	{ NULL, NULL }
 };
@@ -799,6 +972,77 @@ static int tftp_rx_oack ( struct tftp_request *tftp, void *buf, size_t len ) {
 	return rc;
 }
 
+/**
+ * Check whether or not a received DATA block should be acknowledged
+ *
+ * @v tftp		TFTP connection
+ * @v block		Block number just received
+ * @ret ack		Block should be acknowledged
+ *
+ * With a window size of one, this is every block.  Otherwise, we
+ * acknowledge once per complete window, and rely on the block bitmap
+ * to spot lost blocks.
+ */
+static int tftp_ack_due ( struct tftp_request *tftp, unsigned int block ) {
+	unsigned int next = bitmap_first_gap ( &tftp->bitmap );
+
+	/* Without a negotiated window, acknowledge every block */
+	if ( tftp->windowsize <= TFTP_DEFAULT_WINDOWSIZE )
+		return 1;
+
+	/* Acknowledge each complete window, and the final block */
+	if ( ( ( next - tftp->window_start ) >= tftp->windowsize ) ||
+	     bitmap_full ( &tftp->bitmap ) ) {
+		tftp->flags &= ~TFTP_FL_REWIND;
+		return 1;
+	}
+
+	/* A block beyond the first gap indicates that an earlier
+	 * block was lost, and a block before the start of the window
+	 * indicates that our last ACK was lost.  In either case, send
+	 * a single ACK for the last contiguous block, which will
+	 * cause the server to restart the window from there.
+	 */
+	if ( ( ( block > next ) || ( block < tftp->window_start ) ) &&
+	     ! ( tftp->flags & TFTP_FL_REWIND ) ) {
+		DBGC ( tftp, "TFTP %p received block %d, expected %d; "
+		       "rewinding\n", tftp, block, next );
+		tftp->flags |= TFTP_FL_REWIND;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Calculate absolute block number
+ *
+ * @v tftp		TFTP connection
+ * @v wire_block	Block number from DATA packet
+ * @ret block		Absolute block number, or negative error
+ *
+ * Block numbers on the wire are one-based and only 16 bits wide.  We
+ * choose the absolute block number nearest to the most recently
+ * received block.  Unlike working from the first gap in the block
+ * bitmap, this remains correct when joining a multicast transfer
+ * part-way through, where blocks may arrive far ahead of the first
+ * gap.
+ */
+static int tftp_block ( struct tftp_request *tftp,
+			unsigned int wire_block ) {
+	unsigned int ref = tftp->last_block;
+	int delta;
+
+	delta = ( ( int16_t ) ( ( wire_block - 1 ) - ref ) );
+	if ( ( delta < 0 ) && ( ( unsigned int ) ( -delta ) > ref ) ) {
+		/* Block 0 is valid only after the block number wraps */
+		if ( wire_block == 0 )
+			return -EINVAL;
+		delta += 0x10000;
+	}
+	return ( ref + delta );
+}
+
 /**
  * Receive DATA
  *
@@ -812,7 +1056,7 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 			  struct io_buffer *iobuf ) {
 	struct tftp_data *data = iobuf->data;
 	struct xfer_metadata meta;
-	unsigned int block;
+	int block;
 	off_t offset;
 	size_t data_len;
 	int rc;
@@ -833,16 +1077,15 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 	}
 
 	/* Calculate block number */
-	block = ( ( bitmap_first_gap ( &tftp->bitmap ) + 1 ) & ~0xffff );
-	if ( data->block == 0 && block == 0 ) {
+	block = tftp_block ( tftp, ntohs ( data->block ) );
+	if ( block < 0 ) {
 		DBGC ( tftp, "TFTP %p received data block 0\n", tftp );
-		rc = -EINVAL;
+		rc = block;
 		goto done;
 	}
-	block += ( ntohs ( data->block ) - 1 );
 
 	/* Extract data */
-	offset = ( block * tftp->blksize );
+	offset = ( ( ( off_t ) block ) * tftp->blksize );
 	iob_pull ( iobuf, sizeof ( *data ) );
 	data_len = iob_len ( iobuf );
 	if ( data_len > tftp->blksize ) {
@@ -867,11 +1110,22 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 	if ( ( rc = tftp_presize ( tftp, ( offset + data_len ) ) ) != 0 )
 		goto done;
 
-	/* Mark block as received */
+	/* Mark block as received, and cancel any pending takeover */
 	bitmap_set ( &tftp->bitmap, block );
+	tftp->last_block = block;
+	tftp_mtftp_end_takeover ( tftp );
 
-	/* Acknowledge block */
-	tftp_send_packet ( tftp );
+	/* Acknowledge block, if applicable.  If we are waiting for
+	 * the remainder of a window, just restart the retransmission
+	 * timer; if it expires then we will acknowledge the last
+	 * contiguous block as per RFC 7440.
+	 */
+	if ( tftp_ack_due ( tftp, block ) ) {
+		tftp_send_packet ( tftp );
+	} else {
+		stop_timer ( &tftp->timer );
+		start_timer ( &tftp->timer );
+	}
 
 	/* If all blocks have been received, finish. */
 	if ( bitmap_full ( &tftp->bitmap ) )
@@ -1069,6 +1323,38 @@ static struct interface_operation tftp_xfer_operations[] = {
 static struct interface_descriptor tftp_xfer_desc =
 	INTF_DESC ( struct tftp_request, xfer, tftp_xfer_operations );
 
+/**
+ * Determine requested window size for a URI
+ *
+ * @v uri		Uniform Resource Identifier
+ * @ret windowsize	Requested window size
+ *
+ * A "windowsize=<n>" query parameter overrides the default requested
+ * window size for this request only.
+ */
+static unsigned int tftp_uri_windowsize ( struct uri *uri ) {
+	static const char key[] = "windowsize=";
+	const char *param = uri->query;
+	unsigned long windowsize;
+	char *end;
+
+	while ( param ) {
+		if ( strncmp ( param, key, ( sizeof ( key ) - 1 ) ) == 0 ) {
+			windowsize = strtoul ( ( param + sizeof ( key ) - 1 ),
+					       &end, 10 );
+			if ( ( ( *end == '\0' ) || ( *end == '&' ) ) &&
+			     ( windowsize >= TFTP_DEFAULT_WINDOWSIZE ) &&
+			     ( windowsize <= 0xffff ) )
+				return windowsize;
+			break;
+		}
+		param = strchr ( param, '&' );
+		if ( param )
+			param++;
+	}
+	return TFTP_REQUEST_WINDOWSIZE;
+}
+
 /**
  * Initiate TFTP/TFTM/MTFTP download
  *
@@ -1100,6 +1386,8 @@ static int tftp_core_open ( struct interface *xfer, struct uri *uri,
 	timer_init ( &tftp->timer, tftp_timer_expired );
 	tftp->uri = uri_get ( uri );
 	tftp->blksize = TFTP_DEFAULT_BLKSIZE;
+	tftp->windowsize = TFTP_DEFAULT_WINDOWSIZE;
+	tftp->request_windowsize = tftp_uri_windowsize ( uri );
 	tftp->flags = flags;
 
 	/* Open socket */
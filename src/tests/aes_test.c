@@ -0,0 +1,166 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+
+/*
+ * This file exists for testing the AES engines.  Every engine
+ * supported by the running CPU is checked against the FIPS-197 and
+ * SP800-38A test vectors.  The engines are timed by bench_test().
+ *
+ */
+
+struct aes_test {
+	const char *name;
+	const uint8_t *key;
+	size_t keylen;
+	const uint8_t *plaintext;
+	const uint8_t *ciphertext;
+	size_t len;
+	/** Initialisation vector (NULL for ECB) */
+	const uint8_t *iv;
+};
+
+/* FIPS-197 Appendix C */
+static const uint8_t fips_plaintext[] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+	0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff,
+};
+static const uint8_t fips_key[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+	0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+};
+static const uint8_t fips_ciphertext_128[] = {
+	0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+	0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a,
+};
+static const uint8_t fips_ciphertext_192[] = {
+	0xdd, 0xa9, 0x7c, 0xa4, 0x86, 0x4c, 0xdf, 0xe0,
+	0x6e, 0xaf, 0x70, 0xa0, 0xec, 0x0d, 0x71, 0x91,
+};
+static const uint8_t fips_ciphertext_256[] = {
+	0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf,
+	0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89,
+};
+
+/* SP800-38A F.2.1 and F.2.5 */
+static const uint8_t sp800_plaintext[] = {
+	0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96,
+	0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+	0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c,
+	0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+	0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11,
+	0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+	0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17,
+	0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10,
+};
+static const uint8_t sp800_iv[] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+	0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+};
+static const uint8_t sp800_key_128[] = {
+	0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+	0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+static const uint8_t sp800_ciphertext_128[] = {
+	0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46,
+	0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d,
+	0x50, 0x86, 0xcb, 0x9b, 0x50, 0x72, 0x11, 0xa5,
+	0x64, 0x63, 0x20, 0x7b, 0x16, 0x01, 0x38, 0x11,
+	0x73, 0xbe, 0xd7, 0x27, 0x11, 0x0d, 0x2f, 0x0b,
+	0x25, 0x4e, 0xb4, 0x81, 0x15, 0x9d, 0x5d, 0x2d,
+	0x10, 0xa7, 0x14, 0x89, 0x76, 0x80, 0xdd, 0xd5,
+	0x59, 0x5b, 0xbb, 0x4c, 0x44, 0xbc, 0xc0, 0xcd,
+};
+static const uint8_t sp800_key_256[] = {
+	0x60, 0x3d, 0xeb, 0x10, 0x15, 0xca, 0x71, 0xbe,
+	0x2b, 0x73, 0xae, 0xf0, 0x85, 0x7d, 0x77, 0x81,
+	0x1f, 0x35, 0x2c, 0x07, 0x3b, 0x61, 0x08, 0xd7,
+	0x2d, 0x98, 0x10, 0xa3, 0x09, 0x14, 0xdf, 0xf4,
+};
+static const uint8_t sp800_ciphertext_256[] = {
+	0xf5, 0x8c, 0x4c, 0x04, 0xd6, 0xe5, 0xf1, 0xba,
+	0x77, 0x9e, 0xab, 0xfb, 0x5f, 0x7b, 0xfb, 0xd6,
+	0x9c, 0xfc, 0x4e, 0x96, 0x7e, 0xdb, 0x80, 0x8d,
+	0x67, 0x9f, 0x8a, 0x53, 0xc1, 0x0e, 0x32, 0xf6,
+	0x9c, 0x36, 0x64, 0xf2, 0x14, 0xa1, 0x4a, 0x2f,
+	0xb1, 0xcb, 0x39, 0xaa, 0x06, 0xa7, 0x8f, 0x76,
+	0x0e, 0x65, 0x2c, 0xa6, 0xb4, 0x71, 0x64, 0x3e,
+	0x34, 0x1b, 0x1a, 0xb0, 0x19, 0x93, 0x26, 0x45,
+};
+
+static struct aes_test aes_tests[] = {
+	{ "ECB-128", fips_key, 16, fips_plaintext, fips_ciphertext_128,
+	  sizeof ( fips_plaintext ), NULL },
+	{ "ECB-192", fips_key, 24, fips_plaintext, fips_ciphertext_192,
+	  sizeof ( fips_plaintext ), NULL },
+	{ "ECB-256", fips_key, 32, fips_plaintext, fips_ciphertext_256,
+	  sizeof ( fips_plaintext ), NULL },
+	{ "CBC-128", sp800_key_128, 16, sp800_plaintext,
+	  sp800_ciphertext_128, sizeof ( sp800_plaintext ), sp800_iv },
+	{ "CBC-256", sp800_key_256, 32, sp800_plaintext,
+	  sp800_ciphertext_256, sizeof ( sp800_plaintext ), sp800_iv },
+};
+
+static int aes_test_engine ( struct aes_engine *engine,
+			     struct aes_test *test ) {
+	struct aes_context aes;
+	uint8_t iv[AES_BLOCKSIZE];
+	uint8_t buf[test->len];
+	int ok = 1;
+
+	aes_engine_setkey ( &aes, engine, test->key, test->keylen );
+
+	/* Encrypt out of place */
+	if ( test->iv ) {
+		memcpy ( iv, test->iv, sizeof ( iv ) );
+		engine->cbc_encrypt ( &aes, iv, test->plaintext, buf,
+				      test->len );
+	} else {
+		engine->encrypt ( &aes, test->plaintext, buf, test->len );
+	}
+	if ( memcmp ( buf, test->ciphertext, test->len ) != 0 ) {
+		printf ( "%s %s encryption failed\n",
+			 engine->name, test->name );
+		ok = 0;
+	}
+
+	/* Decrypt in place */
+	memcpy ( buf, test->ciphertext, test->len );
+	if ( test->iv ) {
+		memcpy ( iv, test->iv, sizeof ( iv ) );
+		engine->cbc_decrypt ( &aes, iv, buf, buf, test->len );
+	} else {
+		engine->decrypt ( &aes, buf, buf, test->len );
+	}
+	if ( memcmp ( buf, test->plaintext, test->len ) != 0 ) {
+		printf ( "%s %s decryption failed\n",
+			 engine->name, test->name );
+		ok = 0;
+	}
+
+	return ok;
+}
+
+void aes_test ( void ) {
+	struct aes_engine *engine;
+	unsigned int i;
+	int ok;
+
+	for_each_table_entry ( engine, AES_ENGINES ) {
+		if ( engine->supported && ( ! engine->supported() ) ) {
+			printf ( "%s engine not supported\n", engine->name );
+			continue;
+		}
+		ok = 1;
+		for ( i = 0 ; i < ( sizeof ( aes_tests ) /
+				    sizeof ( aes_tests[0] ) ) ; i++ ) {
+			ok &= aes_test_engine ( engine, &aes_tests[i] );
+		}
+		printf ( "%s engine self-test %s\n", engine->name,
+			 ( ok ? "passed" : "FAILED" ) );
+	}
+}
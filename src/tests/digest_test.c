@@ -0,0 +1,196 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ipxe/crypto.h>
+#include <ipxe/md5.h>
+#include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+
+/*
+ * This file exists for testing the digest algorithms.  MD5 and every
+ * SHA-1 and SHA-256 engine supported by the running CPU are checked
+ * against the FIPS 180-2 test vectors.  The algorithms are timed by
+ * bench_test().
+ *
+ */
+
+struct digest_test {
+	const char *name;
+	/** Digest algorithm */
+	struct digest_algorithm *digest;
+	/** Data to be digested */
+	const void *data;
+	/** Length of data */
+	size_t len;
+	/** Number of times to repeat data */
+	unsigned int count;
+	/** Expected digest */
+	const uint8_t *expected;
+};
+
+/* FIPS 180-2 messages */
+static const char abc[] = "abc";
+static const char msg_448[] =
+	"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+static char million_a[1000];
+
+/* Expected digests */
+static const uint8_t md5_abc[] = {
+	0x90, 0x01, 0x50, 0x98, 0x3c, 0xd2, 0x4f, 0xb0,
+	0xd6, 0x96, 0x3f, 0x7d, 0x28, 0xe1, 0x7f, 0x72,
+};
+static const uint8_t md5_448[] = {
+	0x82, 0x15, 0xef, 0x07, 0x96, 0xa2, 0x0b, 0xca,
+	0xaa, 0xe1, 0x16, 0xd3, 0x87, 0x6c, 0x66, 0x4a,
+};
+static const uint8_t md5_million[] = {
+	0x77, 0x07, 0xd6, 0xae, 0x4e, 0x02, 0x7c, 0x70,
+	0xee, 0xa2, 0xa9, 0x35, 0xc2, 0x29, 0x6f, 0x21,
+};
+static const uint8_t sha1_abc[] = {
+	0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a,
+	0xba, 0x3e, 0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c,
+	0x9c, 0xd0, 0xd8, 0x9d,
+};
+static const uint8_t sha1_448[] = {
+	0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e,
+	0xba, 0xae, 0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5,
+	0xe5, 0x46, 0x70, 0xf1,
+};
+static const uint8_t sha1_million[] = {
+	0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4,
+	0xf6, 0x1e, 0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31,
+	0x65, 0x34, 0x01, 0x6f,
+};
+static const uint8_t sha256_abc[] = {
+	0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+	0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+	0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+	0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+};
+static const uint8_t sha256_448[] = {
+	0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+	0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+	0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+	0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+};
+static const uint8_t sha256_million[] = {
+	0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+	0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+	0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+	0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0,
+};
+
+#define DIGEST_TESTS( _name, _digest )					\
+	{ #_name " abc", _digest, abc, ( sizeof ( abc ) - 1 ), 1,	\
+	  _name ## _abc },						\
+	{ #_name " 448-bit", _digest, msg_448,				\
+	  ( sizeof ( msg_448 ) - 1 ), 1, _name ## _448 },		\
+	{ #_name " million", _digest, million_a,			\
+	  sizeof ( million_a ), 1000, _name ## _million }
+
+static struct digest_test digest_tests[] = {
+	DIGEST_TESTS ( md5, &md5_algorithm ),
+	DIGEST_TESTS ( sha1, &sha1_algorithm ),
+	DIGEST_TESTS ( sha256, &sha256_algorithm ),
+};
+
+/**
+ * Check digest against test vector
+ *
+ * @v test		Digest test
+ * @v ctx		Digest context (already initialised)
+ * @ret ok		Digest is correct
+ */
+static int digest_check ( struct digest_test *test, void *ctx ) {
+	struct digest_algorithm *digest = test->digest;
+	uint8_t out[digest->digestsize];
+	unsigned int i;
+
+	for ( i = 0 ; i < test->count ; i++ )
+		digest_update ( digest, ctx, test->data, test->len );
+	digest_final ( digest, ctx, out );
+	if ( memcmp ( out, test->expected, sizeof ( out ) ) != 0 ) {
+		printf ( "%s failed\n", test->name );
+		return 0;
+	}
+	return 1;
+}
+
+/**
+ * Report engine self-test result
+ *
+ * @v digest		Digest algorithm
+ * @v engine		Engine name
+ * @v ok		Self-test passed
+ */
+static void digest_report ( struct digest_algorithm *digest,
+			    const char *engine, int ok ) {
+	printf ( "%s %s engine self-test %s\n", digest->name, engine,
+		 ( ok ? "passed" : "FAILED" ) );
+}
+
+void digest_test ( void ) {
+	struct sha1_engine *sha1_engine;
+	struct sha256_engine *sha256_engine;
+	struct sha1_context sha1;
+	struct sha256_context sha256;
+	uint8_t ctx[MD5_CTX_SIZE];
+	struct digest_test *test;
+	unsigned int i;
+	int ok;
+
+	memset ( million_a, 'a', sizeof ( million_a ) );
+
+	/* MD5 has no engines */
+	ok = 1;
+	for ( i = 0 ; i < ( sizeof ( digest_tests ) /
+			    sizeof ( digest_tests[0] ) ) ; i++ ) {
+		test = &digest_tests[i];
+		if ( test->digest != &md5_algorithm )
+			continue;
+		digest_init ( &md5_algorithm, ctx );
+		ok &= digest_check ( test, ctx );
+	}
+	printf ( "md5 self-test %s\n", ( ok ? "passed" : "FAILED" ) );
+
+	/* SHA-1 engines */
+	for_each_table_entry ( sha1_engine, SHA1_ENGINES ) {
+		if ( sha1_engine->supported &&
+		     ( ! sha1_engine->supported() ) ) {
+			printf ( "sha1 %s engine not supported\n",
+				 sha1_engine->name );
+			continue;
+		}
+		ok = 1;
+		for ( i = 0 ; i < ( sizeof ( digest_tests ) /
+				    sizeof ( digest_tests[0] ) ) ; i++ ) {
+			test = &digest_tests[i];
+			if ( test->digest != &sha1_algorithm )
+				continue;
+			sha1_engine_init ( &sha1, sha1_engine );
+			ok &= digest_check ( test, &sha1 );
+		}
+		digest_report ( &sha1_algorithm, sha1_engine->name, ok );
+	}
+
+	/* SHA-256 engines */
+	for_each_table_entry ( sha256_engine, SHA256_ENGINES ) {
+		if ( sha256_engine->supported &&
+		     ( ! sha256_engine->supported() ) ) {
+			printf ( "sha256 %s engine not supported\n",
+				 sha256_engine->name );
+			continue;
+		}
+		ok = 1;
+		for ( i = 0 ; i < ( sizeof ( digest_tests ) /
+				    sizeof ( digest_tests[0] ) ) ; i++ ) {
+			test = &digest_tests[i];
+			if ( test->digest != &sha256_algorithm )
+				continue;
+			sha256_engine_init ( &sha256, sha256_engine );
+			ok &= digest_check ( test, &sha256 );
+		}
+		digest_report ( &sha256_algorithm, sha256_engine->name, ok );
+	}
+}
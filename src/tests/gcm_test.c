@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+#include <ipxe/gcm.h>
+
+/*
+ * This file exists for testing AES-GCM.  Every GHASH engine
+ * supported by the running CPU is checked against test cases from
+ * the GCM specification.  The engines are timed by bench_test().
+ *
+ */
+
+struct gcm_test {
+	const char *name;
+	const uint8_t *key;
+	size_t keylen;
+	const uint8_t *plaintext;
+	const uint8_t *ciphertext;
+	size_t len;
+	const uint8_t *aad;
+	size_t aad_len;
+	const uint8_t *tag;
+};
+
+/* GCM specification test cases 4 and 16 */
+static const uint8_t gcm_key[] = {
+	0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+	0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+	0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c,
+	0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08,
+};
+static const uint8_t gcm_iv[GCM_IV_LEN] = {
+	0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad,
+	0xde, 0xca, 0xf8, 0x88,
+};
+static const uint8_t gcm_aad[] = {
+	0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+	0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+	0xab, 0xad, 0xda, 0xd2,
+};
+static const uint8_t gcm_plaintext[] = {
+	0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5,
+	0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+	0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda,
+	0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+	0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53,
+	0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+	0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+	0xba, 0x63, 0x7b, 0x39,
+};
+static const uint8_t gcm_ciphertext_128[] = {
+	0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24,
+	0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+	0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0,
+	0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+	0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c,
+	0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+	0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+	0x3d, 0x58, 0xe0, 0x91,
+};
+static const uint8_t gcm_tag_128[GCM_AUTH_LEN] = {
+	0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb,
+	0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47,
+};
+static const uint8_t gcm_ciphertext_256[] = {
+	0x52, 0x2d, 0xc1, 0xf0, 0x99, 0x56, 0x7d, 0x07,
+	0xf4, 0x7f, 0x37, 0xa3, 0x2a, 0x84, 0x42, 0x7d,
+	0x64, 0x3a, 0x8c, 0xdc, 0xbf, 0xe5, 0xc0, 0xc9,
+	0x75, 0x98, 0xa2, 0xbd, 0x25, 0x55, 0xd1, 0xaa,
+	0x8c, 0xb0, 0x8e, 0x48, 0x59, 0x0d, 0xbb, 0x3d,
+	0xa7, 0xb0, 0x8b, 0x10, 0x56, 0x82, 0x88, 0x38,
+	0xc5, 0xf6, 0x1e, 0x63, 0x93, 0xba, 0x7a, 0x0a,
+	0xbc, 0xc9, 0xf6, 0x62,
+};
+static const uint8_t gcm_tag_256[GCM_AUTH_LEN] = {
+	0x76, 0xfc, 0x6e, 0xce, 0x0f, 0x4e, 0x17, 0x68,
+	0xcd, 0xdf, 0x88, 0x53, 0xbb, 0x2d, 0x55, 0x1b,
+};
+
+static struct gcm_test gcm_tests[] = {
+	{ "GCM-128", gcm_key, 16, gcm_plaintext, gcm_ciphertext_128,
+	  sizeof ( gcm_plaintext ), gcm_aad, sizeof ( gcm_aad ),
+	  gcm_tag_128 },
+	{ "GCM-256", gcm_key, 32, gcm_plaintext, gcm_ciphertext_256,
+	  sizeof ( gcm_plaintext ), gcm_aad, sizeof ( gcm_aad ),
+	  gcm_tag_256 },
+};
+
+static int gcm_test_engine ( struct ghash_engine *engine,
+			     struct gcm_test *test ) {
+	struct aes_context aes;
+	struct gcm_context gcm;
+	uint8_t tag[GCM_AUTH_LEN];
+	uint8_t buf[test->len];
+	int ok = 1;
+
+	gcm_engine_setkey ( &gcm, engine, test->key, test->keylen,
+			    &aes_algorithm, &aes );
+
+	/* Encrypt out of place */
+	gcm_setiv ( &gcm, gcm_iv );
+	gcm_encrypt ( &gcm, test->aad, NULL, test->aad_len,
+		      &aes_algorithm, &aes );
+	gcm_encrypt ( &gcm, test->plaintext, buf, test->len,
+		      &aes_algorithm, &aes );
+	gcm_auth ( &gcm, tag, &aes_algorithm, &aes );
+	if ( ( memcmp ( buf, test->ciphertext, test->len ) != 0 ) ||
+	     ( memcmp ( tag, test->tag, sizeof ( tag ) ) != 0 ) ) {
+		printf ( "%s %s encryption failed\n",
+			 engine->name, test->name );
+		ok = 0;
+	}
+
+	/* Decrypt in place */
+	memcpy ( buf, test->ciphertext, test->len );
+	gcm_setiv ( &gcm, gcm_iv );
+	gcm_decrypt ( &gcm, test->aad, NULL, test->aad_len,
+		      &aes_algorithm, &aes );
+	gcm_decrypt ( &gcm, buf, buf, test->len, &aes_algorithm, &aes );
+	gcm_auth ( &gcm, tag, &aes_algorithm, &aes );
+	if ( ( memcmp ( buf, test->plaintext, test->len ) != 0 ) ||
+	     ( memcmp ( tag, test->tag, sizeof ( tag ) ) != 0 ) ) {
+		printf ( "%s %s decryption failed\n",
+			 engine->name, test->name );
+		ok = 0;
+	}
+
+	return ok;
+}
+
+void gcm_test ( void ) {
+	struct ghash_engine *engine;
+	unsigned int i;
+	int ok;
+
+	for_each_table_entry ( engine, GHASH_ENGINES ) {
+		if ( engine->supported && ( ! engine->supported() ) ) {
+			printf ( "%s engine not supported\n", engine->name );
+			continue;
+		}
+		ok = 1;
+		for ( i = 0 ; i < ( sizeof ( gcm_tests ) /
+				    sizeof ( gcm_tests[0] ) ) ; i++ ) {
+			ok &= gcm_test_engine ( engine, &gcm_tests[i] );
+		}
+		printf ( "%s GHASH engine self-test %s\n", engine->name,
+			 ( ok ? "passed" : "FAILED" ) );
+	}
+}
@@ -0,0 +1,133 @@
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <ipxe/modexp.h>
+#include "crypto/axtls/crypto.h"
+
+/*
+ * This file exists for testing modular exponentiation.  The
+ * Montgomery code is checked against the axTLS bigint library for
+ * RSA-sized moduli, using both a public (65537) and a full-length
+ * (private-sized) exponent.  The code is timed by bench_test().
+ *
+ */
+
+/** Largest modulus tested (in bytes) */
+#define MODEXP_TEST_MAX_LEN ( 4096 / 8 )
+
+/** Public exponent */
+static const uint8_t modexp_e[] = { 0x01, 0x00, 0x01 };
+
+static uint8_t modexp_mod[MODEXP_TEST_MAX_LEN];
+static uint8_t modexp_base[MODEXP_TEST_MAX_LEN];
+static uint8_t modexp_exp[MODEXP_TEST_MAX_LEN];
+static uint8_t modexp_result[MODEXP_TEST_MAX_LEN];
+static uint8_t modexp_expected[MODEXP_TEST_MAX_LEN];
+
+/**
+ * Fill buffer with repeatable pseudo-random data
+ *
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @v seed		Seed
+ */
+static void modexp_fill ( uint8_t *buf, size_t len, uint32_t seed ) {
+	while ( len-- ) {
+		seed = ( ( seed * 1103515245 ) + 12345 );
+		*(buf++) = ( seed >> 16 );
+	}
+}
+
+/**
+ * Calculate expected result using axTLS bigint library
+ *
+ * @v len		Modulus length
+ * @v exp		Exponent
+ * @v exp_len		Exponent length
+ * @v result		Result buffer
+ */
+static void modexp_classical ( size_t len, const uint8_t *exp,
+			       size_t exp_len, uint8_t *result ) {
+	BI_CTX *ctx = bi_initialize();
+	bigint *bim;
+	bigint *bibase;
+	bigint *biexp;
+
+	bim = bi_import ( ctx, modexp_mod, len );
+	bi_set_mod ( ctx, bim, BIGINT_M_OFFSET );
+	bibase = bi_import ( ctx, modexp_base, len );
+	biexp = bi_import ( ctx, exp, exp_len );
+	ctx->mod_offset = BIGINT_M_OFFSET;
+	bi_export ( ctx, bi_mod_power ( ctx, bibase, biexp ), result, len );
+	bi_free_mod ( ctx, BIGINT_M_OFFSET );
+	bi_terminate ( ctx );
+}
+
+/**
+ * Check modular exponentiation for one modulus size
+ *
+ * @v bits		Modulus size
+ * @ret ok		Results were correct
+ */
+static int modexp_test_size ( unsigned int bits ) {
+	size_t len = ( bits / 8 );
+	int ok = 1;
+
+	/* Construct an odd modulus with the top bit set, a base less
+	 * than the modulus, and a full-length exponent.
+	 */
+	modexp_fill ( modexp_mod, len, bits );
+	modexp_mod[0] |= 0x80;
+	modexp_mod[ len - 1 ] |= 0x01;
+	modexp_fill ( modexp_base, len, ( bits + 1 ) );
+	modexp_base[0] &= 0x7f;
+	modexp_fill ( modexp_exp, len, ( bits + 2 ) );
+
+	/* Public exponent */
+	modexp ( modexp_mod, len, modexp_base, len, modexp_e,
+		 sizeof ( modexp_e ), modexp_result );
+	modexp_classical ( len, modexp_e, sizeof ( modexp_e ),
+			   modexp_expected );
+	if ( memcmp ( modexp_result, modexp_expected, len ) != 0 ) {
+		printf ( "modexp %d-bit public exponent failed\n", bits );
+		ok = 0;
+	}
+
+	/* Private-sized exponent (too slow to check classically for
+	 * larger moduli)
+	 */
+	if ( bits <= 1024 ) {
+		modexp ( modexp_mod, len, modexp_base, len, modexp_exp, len,
+			 modexp_result );
+		modexp_classical ( len, modexp_exp, len, modexp_expected );
+		if ( memcmp ( modexp_result, modexp_expected, len ) != 0 ) {
+			printf ( "modexp %d-bit private exponent failed\n",
+				 bits );
+			ok = 0;
+		}
+	}
+
+	return ok;
+}
+
+void modexp_test ( void ) {
+	static const uint8_t mod[] = { 0x01, 0xf1 };	/* 497 */
+	static const uint8_t base[] = { 0x04 };
+	static const uint8_t exp[] = { 0x0d };
+	static const uint8_t expected[] = { 0x01, 0xbd };	/* 445 */
+	uint8_t result[ sizeof ( mod ) ];
+	int ok = 1;
+
+	if ( ( modexp ( mod, sizeof ( mod ), base, sizeof ( base ),
+			exp, sizeof ( exp ), result ) != 0 ) ||
+	     ( memcmp ( result, expected, sizeof ( result ) ) != 0 ) ) {
+		printf ( "modexp small test failed\n" );
+		ok = 0;
+	}
+
+	ok &= modexp_test_size ( 1024 );
+	ok &= modexp_test_size ( 2048 );
+	ok &= modexp_test_size ( 4096 );
+	printf ( "modexp (%d-bit limbs) self-test %s\n", MODEXP_LIMB_BITS,
+		 ( ok ? "passed" : "FAILED" ) );
+}
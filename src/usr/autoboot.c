@@ -19,14 +19,20 @@
 FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <config/general.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
 #include <ipxe/image.h>
 #include <ipxe/sanboot.h>
 #include <ipxe/uri.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+#include <ipxe/keys.h>
+#include <console.h>
 #include <usr/ifmgmt.h>
 #include <usr/route.h>
 #include <usr/dhcpmgmt.h>
@@ -130,12 +136,12 @@ int boot_root_path ( const char *root_path ) {
 }
 
 /**
- * Boot from a network device
+ * Boot from a configured network device
  *
  * @v netdev		Network device
  * @ret rc		Return status code
  */
-static int netboot ( struct net_device *netdev ) {
+static int netboot_configured ( struct net_device *netdev ) {
 	struct setting vendor_class_id_setting
 		= { .tag = DHCP_VENDOR_CLASS_ID };
 	struct setting pxe_discovery_control_setting
@@ -147,16 +153,6 @@ static int netboot ( struct net_device *netdev ) {
 	unsigned int pxe_discovery_control;
 	int rc;
 
-	/* Open device and display device status */
-	if ( ( rc = ifopen ( netdev ) ) != 0 )
-		return rc;
-	ifstat ( netdev );
-
-	/* Configure device via DHCP */
-	if ( ( rc = dhcp ( netdev ) ) != 0 )
-		return rc;
-	route();
-
 	/* Try PXE menu boot, if applicable */
 	fetch_string_setting ( NULL, &vendor_class_id_setting,
 			       buf, sizeof ( buf ) );
@@ -200,6 +196,208 @@ static int netboot ( struct net_device *netdev ) {
 	return -ENOENT;
 }
 
+/**
+ * Boot from a network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int netboot ( struct net_device *netdev ) {
+	int rc;
+
+	/* Open device and display device status */
+	if ( ( rc = ifopen ( netdev ) ) != 0 )
+		return rc;
+	ifstat ( netdev );
+
+	/* Configure device via DHCP */
+	if ( ( rc = dhcp ( netdev ) ) != 0 )
+		return rc;
+	route();
+
+	return netboot_configured ( netdev );
+}
+
+/** A concurrent network device configuration attempt */
+struct netboot_attempt {
+	/** Job control interface */
+	struct interface job;
+	/** Network device */
+	struct net_device *netdev;
+	/** Status code, or -EINPROGRESS while DHCP is running */
+	int rc;
+};
+
+/**
+ * Handle completion of concurrent configuration attempt
+ *
+ * @v attempt		Configuration attempt
+ * @v rc		Reason for completion
+ */
+static void netboot_attempt_close ( struct netboot_attempt *attempt,
+				    int rc ) {
+	attempt->rc = rc;
+	intf_restart ( &attempt->job, rc );
+}
+
+/** Concurrent configuration attempt job control interface operations */
+static struct interface_operation netboot_attempt_job_op[] = {
+	INTF_OP ( intf_close, struct netboot_attempt *,
+		  netboot_attempt_close ),
+};
+
+/** Concurrent configuration attempt job control interface descriptor */
+static struct interface_descriptor netboot_attempt_job_desc =
+	INTF_DESC ( struct netboot_attempt, job, netboot_attempt_job_op );
+
+/**
+ * Check whether configured network device has something to boot
+ *
+ * @v netdev		Network device
+ * @ret usable		Network device has a boot filename, root path
+ *			or PXE boot menu
+ *
+ * Only settings obtained by this device's own DHCP session are
+ * considered; a ProxyDHCP block registered by another device does not
+ * count.
+ */
+static int netboot_usable ( struct net_device *netdev ) {
+	struct setting pxe_boot_menu_setting
+		= { .tag = DHCP_PXE_BOOT_MENU };
+	struct settings *settings[2];
+	unsigned int i;
+
+	settings[0] = netdev_settings ( netdev );
+	settings[1] = dhcp_pxe_settings ( netdev, PROXYDHCP_SETTINGS_NAME );
+	for ( i = 0 ; i < ( sizeof ( settings ) /
+			    sizeof ( settings[0] ) ) ; i++ ) {
+		if ( ! settings[i] )
+			continue;
+		if ( setting_exists ( settings[i], &filename_setting ) ||
+		     setting_exists ( settings[i], &root_path_setting ) ||
+		     setting_exists ( settings[i], &pxe_boot_menu_setting ) )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Abandon a concurrently configured network device
+ *
+ * @v netdev		Network device
+ *
+ * Every settings block registered by the device's DHCP session
+ * (including any ProxyDHCP or PXEBS block at the root of the settings
+ * tree) is unregistered, and the device is closed.
+ */
+static void netboot_abandon ( struct net_device *netdev ) {
+	struct settings *settings;
+
+	settings = find_child_settings ( netdev_settings ( netdev ),
+					 DHCP_SETTINGS_NAME );
+	if ( settings )
+		unregister_settings ( settings );
+	dhcp_pxe_unregister ( netdev );
+	ifclose ( netdev );
+}
+
+/**
+ * Configure all network devices concurrently
+ *
+ * @ret netdev		Configured network device, or NULL
+ *
+ * DHCP is started on every network device at once.  The first device
+ * to obtain a usable boot configuration wins, and all other devices
+ * are closed.  If no device obtains a usable boot configuration, the
+ * first device to complete DHCP successfully (if any) is used.
+ */
+static struct net_device * netboot_configure_all ( void ) {
+	struct netboot_attempt *attempts;
+	struct netboot_attempt *attempt;
+	struct netboot_attempt *winner = NULL;
+	struct netboot_attempt *fallback;
+	struct net_device *netdev;
+	unsigned int count = 0;
+	unsigned int running;
+	unsigned int i;
+	int rc;
+
+	/* Allocate attempts */
+	for_each_netdev ( netdev )
+		count++;
+	attempts = zalloc ( count * sizeof ( attempts[0] ) );
+	if ( ! attempts )
+		return NULL;
+
+	/* Start DHCP on each device */
+	printf ( "DHCP (" );
+	attempt = attempts;
+	for_each_netdev ( netdev ) {
+		intf_init ( &attempt->job, &netboot_attempt_job_desc, NULL );
+		attempt->netdev = netdev;
+		printf ( "%s%s", ( ( attempt == attempts ) ? "" : " " ),
+			 netdev->name );
+		if ( ( rc = ifopen ( netdev ) ) != 0 ) {
+			attempt->rc = rc;
+		} else if ( ( rc = start_dhcp ( &attempt->job,
+						netdev ) ) == 0 ) {
+			attempt->rc = -EINPROGRESS;
+		} else {
+			/* Positive value indicates cached settings */
+			attempt->rc = ( ( rc > 0 ) ? 0 : rc );
+		}
+		attempt++;
+	}
+	printf ( ")." );
+
+	/* Wait for a winner, or for all attempts to complete */
+	while ( 1 ) {
+		running = 0;
+		fallback = NULL;
+		for ( i = 0 ; i < count ; i++ ) {
+			attempt = &attempts[i];
+			if ( attempt->rc == -EINPROGRESS ) {
+				running++;
+			} else if ( attempt->rc == 0 ) {
+				if ( netboot_usable ( attempt->netdev ) ) {
+					winner = attempt;
+					break;
+				}
+				if ( ! fallback )
+					fallback = attempt;
+			}
+		}
+		if ( winner )
+			break;
+		if ( ! running ) {
+			winner = fallback;
+			break;
+		}
+		step();
+		if ( iskey() && ( getchar() == CTRL_C ) )
+			break;
+	}
+
+	/* Abandon all other devices */
+	for ( i = 0 ; i < count ; i++ ) {
+		attempt = &attempts[i];
+		intf_shutdown ( &attempt->job, -ECANCELED );
+		if ( attempt != winner )
+			netboot_abandon ( attempt->netdev );
+	}
+
+	/* Report result */
+	netdev = ( winner ? winner->netdev : NULL );
+	if ( netdev ) {
+		printf ( " ok (%s)\n", netdev->name );
+	} else {
+		printf ( " %s\n", strerror ( -ENETUNREACH ) );
+	}
+
+	free ( attempts );
+	return netdev;
+}
+
 /**
  * Close all open net devices
  *
@@ -223,6 +421,18 @@ void autoboot ( void ) {
 	struct net_device *boot_netdev;
 	struct net_device *netdev;
 
+	/* Configure all devices at once, if so configured */
+	if ( AUTOBOOT_PARALLEL ) {
+		close_all_netdevs();
+		if ( ( netdev = netboot_configure_all() ) ) {
+			ifstat ( netdev );
+			route();
+			netboot_configured ( netdev );
+		}
+		printf ( "No more network devices\n" );
+		return;
+	}
+
 	/* If we have an identifable boot device, try that first */
 	close_all_netdevs();
 	if ( ( boot_netdev = find_boot_netdev() ) )
@@ -27,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/device.h>
 #include <ipxe/process.h>
 #include <ipxe/keys.h>
+#include <ipxe/trace.h>
 #include <usr/ifmgmt.h>
 
 /** @file
@@ -81,6 +82,31 @@ static void ifstat_errors ( struct net_device_stats *stats,
 	}
 }
 
+/**
+ * Print performance counters of network device
+ *
+ * @v netdev		Network device
+ */
+static void ifstat_perf ( struct net_device *netdev ) {
+	struct net_device_perf *perf = &netdev->perf;
+
+	printf ( "  [TXB:%ld RXB:%ld TXQ:%d/%d RXQ:%d/%d]\n",
+		 perf->tx_bytes, perf->rx_bytes, perf->tx_queue_len,
+		 perf->tx_queue_max, perf->rx_queue_len, perf->rx_queue_max );
+	printf ( "  [TX:%ld pkt/s %ld B/s, RX:%ld pkt/s %ld B/s]\n",
+		 perf->tx_pps, perf->tx_bps, perf->rx_pps, perf->rx_bps );
+	if ( perf->tx_ring_full || perf->rx_alloc_fail ) {
+		printf ( "  [Drops: TX ring full:%d RX no buffer:%d]\n",
+			 perf->tx_ring_full, perf->rx_alloc_fail );
+	}
+	if ( perf->polls ) {
+		printf ( "  [Poll:%ld avg:%ld max:%ld cycles]\n", perf->polls,
+			 ( ( unsigned long ) ( perf->poll_cost /
+					       perf->polls ) ),
+			 perf->poll_max );
+	}
+}
+
 /**
  * Print status of network device
  *
@@ -100,6 +126,7 @@ void ifstat ( struct net_device *netdev ) {
 	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
+	ifstat_perf ( netdev );
 }
 
 /**
@@ -112,8 +139,10 @@ int iflinkwait ( struct net_device *netdev, unsigned int max_wait_ms ) {
 	int key;
 	int rc;
 
-	if ( netdev_link_ok ( netdev ) )
+	if ( netdev_link_ok ( netdev ) ) {
+		trace ( "link-up", netdev->name, 0 );
 		return 0;
+	}
 
 	printf ( "Waiting for link-up on %s...", netdev->name );
 
@@ -142,6 +171,7 @@ int iflinkwait ( struct net_device *netdev, unsigned int max_wait_ms ) {
 	} else {
 		printf ( " failed: %s\n", strerror ( rc ) );
 	}
+	trace ( ( rc ? "link-fail" : "link-up" ), netdev->name, rc );
 
 	return rc;
 }
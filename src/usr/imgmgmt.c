@@ -21,12 +21,21 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
+#include <console.h>
+#include <ipxe/keys.h>
+#include <ipxe/list.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/process.h>
+#include <ipxe/timer.h>
+#include <ipxe/job.h>
 #include <ipxe/image.h>
 #include <ipxe/downloader.h>
 #include <ipxe/monojob.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
+#include <ipxe/cpio.h>
 #include <usr/imgmgmt.h>
 
 /** @file
@@ -35,6 +44,31 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/**
+ * Prepare to fetch an image
+ *
+ * @v image		Image
+ * @v uri_string	URI as a string (e.g. "http://www.nowhere.com/vmlinuz")
+ * @ret uri		URI, or NULL on error
+ */
+static struct uri * imgfetch_prepare ( struct image *image,
+				       const char *uri_string ) {
+	struct uri *uri;
+
+	if ( ! ( uri = parse_uri ( uri_string ) ) )
+		return NULL;
+
+	image_set_uri ( image, uri );
+
+	/* Reserve space for a cpio header, so that the image may be
+	 * used as a named initrd without being copied.
+	 */
+	if ( ! image->data )
+		image->headroom = cpio_header_len ( image->cmdline );
+
+	return uri;
+}
+
 /**
  * Fetch an image
  *
@@ -51,11 +85,9 @@ int imgfetch ( struct image *image, const char *uri_string,
 	const char *password;
 	int rc;
 
-	if ( ! ( uri = parse_uri ( uri_string ) ) )
+	if ( ! ( uri = imgfetch_prepare ( image, uri_string ) ) )
 		return -ENOMEM;
 
-	image_set_uri ( image, uri );
-
 	/* Redact password portion of URI, if necessary */
 	password = uri->password;
 	if ( password )
@@ -72,6 +104,210 @@ int imgfetch ( struct image *image, const char *uri_string,
 	return rc;
 }
 
+/** A background image fetch */
+struct imgfetch_job {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** List of background image fetches */
+	struct list_head list;
+	/** Job control interface */
+	struct interface job;
+	/** Image being fetched */
+	struct image *image;
+	/** Image registration routine */
+	int ( * image_register ) ( struct image *image );
+	/** Final status code, or -EINPROGRESS */
+	int rc;
+};
+
+/** List of background image fetches, in order of issue */
+static LIST_HEAD ( imgfetch_jobs );
+
+/**
+ * Free background image fetch
+ *
+ * @v refcnt		Reference count
+ */
+static void imgfetch_job_free ( struct refcnt *refcnt ) {
+	struct imgfetch_job *fetch =
+		container_of ( refcnt, struct imgfetch_job, refcnt );
+
+	image_put ( fetch->image );
+	free ( fetch );
+}
+
+/**
+ * Handle completion of background image fetch
+ *
+ * @v fetch		Background image fetch
+ * @v rc		Reason for completion
+ */
+static void imgfetch_job_done ( struct imgfetch_job *fetch, int rc ) {
+	fetch->rc = rc;
+	intf_restart ( &fetch->job, rc );
+}
+
+/** Background image fetch job control interface operations */
+static struct interface_operation imgfetch_job_op[] = {
+	INTF_OP ( intf_close, struct imgfetch_job *, imgfetch_job_done ),
+};
+
+/** Background image fetch job control interface descriptor */
+static struct interface_descriptor imgfetch_job_desc =
+	INTF_DESC ( struct imgfetch_job, job, imgfetch_job_op );
+
+/**
+ * Defer registration of a background image fetch
+ *
+ * @v image		Image
+ * @ret rc		Return status code
+ *
+ * Background fetches may complete in any order.  Registration is
+ * deferred until imgwait(), so that images are registered (and
+ * hence e.g. initrds are concatenated) in the order of issue.
+ */
+static int imgfetch_defer_register ( struct image *image __unused ) {
+	return 0;
+}
+
+/**
+ * Fetch an image in the background
+ *
+ * @v image		Image
+ * @v uri_string	URI as a string (e.g. "http://www.nowhere.com/vmlinuz")
+ * @v register_image	Image registration routine
+ * @ret rc		Return status code
+ *
+ * The fetch proceeds while other commands execute.  The image will
+ * not be registered until imgwait() is called.
+ */
+int imgfetch_background ( struct image *image, const char *uri_string,
+			  int ( * image_register ) ( struct image *image ) ) {
+	struct imgfetch_job *fetch;
+	struct uri *uri;
+	int rc;
+
+	/* Allocate and initialise structure */
+	fetch = zalloc ( sizeof ( *fetch ) );
+	if ( ! fetch ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &fetch->refcnt, imgfetch_job_free );
+	intf_init ( &fetch->job, &imgfetch_job_desc, &fetch->refcnt );
+	fetch->image = image_get ( image );
+	fetch->image_register = image_register;
+	fetch->rc = -EINPROGRESS;
+
+	/* Start download */
+	if ( ! ( uri = imgfetch_prepare ( image, uri_string ) ) ) {
+		rc = -ENOMEM;
+		goto err_uri;
+	}
+	if ( ( rc = create_downloader ( &fetch->job, image,
+					imgfetch_defer_register,
+					LOCATION_URI, uri ) ) != 0 )
+		goto err_downloader;
+	uri_put ( uri );
+
+	/* Add to list of background fetches (which holds our reference) */
+	list_add_tail ( &fetch->list, &imgfetch_jobs );
+	return 0;
+
+ err_downloader:
+	uri_put ( uri );
+ err_uri:
+	ref_put ( &fetch->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Wait for all background image fetches to complete
+ *
+ * @ret rc		Return status code
+ *
+ * Images are registered in the order in which the fetches were
+ * issued.  The status code is that of the first fetch to fail.
+ */
+int imgwait ( void ) {
+	struct imgfetch_job *fetch;
+	struct job_progress progress;
+	unsigned long completed;
+	unsigned long total;
+	unsigned long last_update;
+	unsigned int count;
+	unsigned int pending;
+	int displayed = 0;
+	int rc = 0;
+
+	/* Wait for all fetches to complete */
+	last_update = currticks();
+	while ( 1 ) {
+
+		/* Tally progress of all outstanding fetches */
+		count = pending = 0;
+		completed = total = 0;
+		list_for_each_entry ( fetch, &imgfetch_jobs, list ) {
+			count++;
+			if ( fetch->rc != -EINPROGRESS )
+				continue;
+			pending++;
+			memset ( &progress, 0, sizeof ( progress ) );
+			job_progress ( &fetch->job, &progress );
+			completed += progress.completed;
+			total += progress.total;
+		}
+		if ( ! pending )
+			break;
+
+		/* Update progress display */
+		if ( ( currticks() - last_update ) >= TICKS_PER_SEC ) {
+			printf ( "\rWaiting for %u of %u images", pending,
+				 count );
+			if ( total >= 100 ) {
+				printf ( " (%lu%%)",
+					 ( completed / ( total / 100 ) ) );
+			}
+			printf ( "..." );
+			displayed = 1;
+			last_update = currticks();
+		}
+
+		/* Abort all fetches on Ctrl-C */
+		if ( iskey() && ( getchar() == CTRL_C ) ) {
+			list_for_each_entry ( fetch, &imgfetch_jobs, list ) {
+				if ( fetch->rc == -EINPROGRESS )
+					imgfetch_job_done ( fetch, -ECANCELED );
+			}
+		}
+
+		step();
+	}
+	if ( displayed )
+		printf ( "\n" );
+
+	/* Register images in order of issue.  Each fetch is removed
+	 * from the list before registration, since registering an
+	 * image may execute it.
+	 */
+	while ( ! list_empty ( &imgfetch_jobs ) ) {
+		fetch = list_entry ( imgfetch_jobs.next, struct imgfetch_job,
+				     list );
+		list_del ( &fetch->list );
+		printf ( "%s:", fetch->image->name );
+		if ( fetch->rc == 0 )
+			fetch->rc = fetch->image_register ( fetch->image );
+		printf ( " %s\n",
+			 ( fetch->rc ? strerror ( fetch->rc ) : "ok" ) );
+		if ( fetch->rc && ( rc == 0 ) )
+			rc = fetch->rc;
+		ref_put ( &fetch->refcnt );
+	}
+
+	return rc;
+}
+
 /**
  * Load an image
  *